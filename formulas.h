@@ -24,6 +24,16 @@
 #ifndef FORMULAS_H
 #define FORMULAS_H
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "src/compiled-expression.h"
 #include "src/compiled-model.h"
 #include "src/compiled-property.h"
@@ -38,30 +48,288 @@ struct ModelCheckingStats {
       : time(populate_distribution),
         sample_size(populate_distribution),
         sample_cache_size(populate_distribution),
+        sample_cache_hits(populate_distribution),
+        sample_cache_misses(populate_distribution),
         path_length(populate_distribution),
         path_length_accept(populate_distribution),
         path_length_reject(populate_distribution),
-        path_length_terminate(populate_distribution) {}
+        path_length_terminate(populate_distribution),
+        wasted_paths(populate_distribution),
+        estimate(populate_distribution) {}
+
+  // Merges all statistics from the given statistics of other trials.
+  void MergeFrom(const ModelCheckingStats& other) {
+    time.MergeFrom(other.time);
+    sample_size.MergeFrom(other.sample_size);
+    sample_cache_size.MergeFrom(other.sample_cache_size);
+    sample_cache_hits.MergeFrom(other.sample_cache_hits);
+    sample_cache_misses.MergeFrom(other.sample_cache_misses);
+    path_length.MergeFrom(other.path_length);
+    path_length_accept.MergeFrom(other.path_length_accept);
+    path_length_reject.MergeFrom(other.path_length_reject);
+    path_length_terminate.MergeFrom(other.path_length_terminate);
+    wasted_paths.MergeFrom(other.wasted_paths);
+    estimate.MergeFrom(other.estimate);
+  }
 
   Sample<double> time;
   Sample<int> sample_size;
   Sample<int> sample_cache_size;
+  Sample<int> sample_cache_hits;
+  Sample<int> sample_cache_misses;
   Sample<int> path_length;
   Sample<int> path_length_accept;
   Sample<int> path_length_reject;
   Sample<int> path_length_terminate;
+  // Paths sampled by worker threads but not used by the test, per test.
+  Sample<int> wasted_paths;
+  // Estimates of a probability estimation property, per trial.
+  Sample<double> estimate;
+};
+
+// A persistent pool of worker threads for concurrent sampling, together with
+// the per-thread state that the workers use.  The pool is created once and
+// reused for all properties and trials.  Thread i uses evaluator(i),
+// sampler(i), and simulator(i).  No threads are started for a pool of size 1;
+// all sampling then happens on the calling thread using index 0.
+class SamplingThreadPool {
+ public:
+  // Constructs a pool with one thread per evaluator.  The evaluators and
+  // samplers must outlive the pool.  The model may be null if SetModel is
+  // called before the first job.
+  SamplingThreadPool(
+      const CompiledModel* model,
+      std::vector<CompiledExpressionEvaluator>* evaluators,
+      std::vector<CompiledDistributionSampler<std::mt19937_64>>* samplers);
+
+  ~SamplingThreadPool();
+
+  int size() const { return evaluators_->size(); }
+
+  CompiledExpressionEvaluator* evaluator(int i) { return &(*evaluators_)[i]; }
+
+  CompiledDistributionSampler<std::mt19937_64>* sampler(int i) {
+    return &(*samplers_)[i];
+  }
+
+  NextStateSampler<std::mt19937_64>* simulator(int i) {
+    return &simulators_[i];
+  }
+
+  // Makes the simulators sample paths of the given model, so that the pool
+  // can be reused for another model.  Must not be called while a job is
+  // running.
+  void SetModel(const CompiledModel* model);
+
+  // Runs job(i) on each thread i of the pool.  Returns without waiting for the
+  // job to finish.  Must not be called while another job is running.
+  void Start(std::function<void(int)> job);
+
+  // Waits for all threads to finish the current job.
+  void Wait();
+
+ private:
+  void Run(int thread_index);
+
+  std::vector<CompiledExpressionEvaluator>* const evaluators_;
+  std::vector<CompiledDistributionSampler<std::mt19937_64>>* const samplers_;
+  std::vector<NextStateSampler<std::mt19937_64>> simulators_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  std::function<void(int)> job_;
+  uint64_t generation_;
+  int running_count_;
+  bool shutdown_;
+};
+
+// The state of Verify between two top-level sample paths, for resuming a
+// preempted run.
+struct VerifierState {
+  // Samples of the top-level probabilistic tests in the order that they were
+  // started, as single lines written by Sample<T>::Save.  Only the last test
+  // may be unfinished.
+  std::vector<std::string> test_samples;
+  // Entries of the memoization cache, as single lines.
+  std::vector<std::string> sample_cache;
+};
+
+// Receives periodic checkpoints from Verify.
+class VerifyCheckpointer {
+ public:
+  virtual ~VerifyCheckpointer() = default;
+
+  // Returns true if a checkpoint is due.  Called between top-level paths.
+  virtual bool Due() = 0;
+
+  // Saves a checkpoint with the given state of Verify.  Calling Verify with
+  // the same arguments and resume_state set to state, after restoring the
+  // sampler states of the pool, continues the run where the checkpoint was
+  // made.
+  virtual void Save(const VerifierState& state) = 0;
+};
+
+// A snapshot of a top-level probabilistic test in progress.
+struct VerifyProgress {
+  // Number of observations so far.
+  int observation_count;
+  // Current estimate of the probability, and a confidence interval for it
+  // with coverage 1 - alpha that holds at any sample size.
+  double estimate;
+  double lower_bound;
+  double upper_bound;
+  // The statistic of the test, as returned by
+  // SequentialTester<T>::LogLikelihoodRatio.
+  double log_likelihood_ratio;
+  // Seconds since the test started.
+  double elapsed_seconds;
+  // Fraction of elapsed_seconds that each worker thread spent sampling paths
+  // for the test.  Empty if the test samples paths on the calling thread.
+  std::vector<double> thread_utilization;
+  // True for the final snapshot of the test.
+  bool done;
+};
+
+// Receives periodic snapshots of top-level probabilistic tests from Verify.
+class VerifyProgressListener {
+ public:
+  virtual ~VerifyProgressListener() = default;
+
+  // Returns true if a snapshot is due.  Called between top-level paths.
+  virtual bool Due() = 0;
+
+  // Receives a snapshot.  Called when Due returns true, and once more when
+  // each test is done.
+  virtual void Report(const VerifyProgress& progress) = 0;
 };
 
+// Verifies property in the given state.  Resumes from resume_state unless it
+// is nullptr, offers checkpoints to checkpointer unless it is nullptr, and
+// reports progress to progress unless it is nullptr.
 bool Verify(const CompiledProperty& property, const CompiledModel& model,
             const DecisionDiagramModel* dd_model,
             const ModelCheckingParams& params, const State& state,
-            std::vector<CompiledExpressionEvaluator>* evaluators,
-            std::vector<CompiledDistributionSampler<std::mt19937_64>>* samplers,
-            ModelCheckingStats* stats);
+            SamplingThreadPool* thread_pool, ModelCheckingStats* stats,
+            const VerifierState* resume_state, VerifyCheckpointer* checkpointer,
+            VerifyProgressListener* progress);
+
+// The result of a single trial of VerifyTrials.
+struct TrialResult {
+  explicit TrialResult(bool populate_distribution)
+      : stats(populate_distribution) {}
+
+  bool accept;
+  ModelCheckingStats stats;
+  // The output that Verify would have written to std::cout for the trial.
+  std::string output;
+};
+
+// Verifies property in the given state trial_count times, distributing whole
+// trials over the threads of thread_pool, with each trial sampled on a single
+// thread.  Trial i uses an engine seeded from seed and i, so the results do
+// not depend on the number of threads.  Calls done with the result of each
+// trial, in trial order, on the calling thread.
+void VerifyTrials(const CompiledProperty& property, const CompiledModel& model,
+                  const ModelCheckingParams& params, const State& state,
+                  SamplingThreadPool* thread_pool, size_t seed,
+                  int trial_count, bool populate_distribution,
+                  const std::function<void(const TrialResult&)>& done);
+
+// The empirical distribution of the time at which sample paths first satisfy
+// the until property of a probability estimation property.
+struct FirstPassageDistribution {
+  // Returns the fraction of the sampled paths that satisfied the path property
+  // by time t, for t no greater than the time bound of the path property.
+  double Cdf(double t) const {
+    return static_cast<double>(
+               std::upper_bound(times.begin(), times.end(), t) -
+               times.begin()) /
+           sample_size;
+  }
+
+  const CompiledUntilProperty* path_property;
+  int sample_size;
+  // Half-width of a confidence band with coverage 1 - alpha that holds for
+  // Cdf at all time bounds simultaneously.
+  double band_width;
+  // Times at which the paths that satisfied the path property did so, in
+  // increasing order.
+  std::vector<double> times;
+};
+
+// Returns true if EstimateFirstPassageTimes supports the given property: a
+// probability estimation property over a time-bounded until property with
+// lower time bound 0 and no probabilistic operands.
+bool SupportsFirstPassageTimes(const CompiledProperty& property);
+
+// Samples paths for the until property of the given property, which must be
+// supported by SupportsFirstPassageTimes, recording when each path first
+// satisfies it.  A single set of paths then answers the property for every
+// time bound up to the bound of the property.  The number of paths is chosen
+// so that the confidence band has half-width params.delta and coverage
+// 1 - params.alpha.  Paths are divided evenly among the threads of the pool.
+FirstPassageDistribution EstimateFirstPassageTimes(
+    const CompiledProperty& property, const CompiledModel& model,
+    const ModelCheckingParams& params, const State& state,
+    SamplingThreadPool* thread_pool, ModelCheckingStats* stats);
+
+// A prediction of the cost of a probabilistic test with the sampling engine.
+struct SamplingPlan {
+  const CompiledPathProperty* path_property;
+  // Expected number of observations, from the average sample number of the
+  // test for observations distributed as in the pilot runs.
+  double expected_sample_size;
+  // Mean length of the pilot paths.
+  double mean_path_length;
+  // Mean time to sample a path state in the pilot runs, including the time
+  // to verify nested properties in that state.
+  double seconds_per_state;
+};
+
+// Predicts the cost of verifying the outermost probabilistic properties of the
+// given property with the sampling engine, with pilot_path_count pilot paths
+// for each.  All operands of conjunctions and disjunctions are planned.
+std::vector<SamplingPlan> PlanVerification(
+    const CompiledProperty& property, const CompiledModel& model,
+    const ModelCheckingParams& params, const State& state,
+    int pilot_path_count, SamplingThreadPool* thread_pool);
+
+// The result of verifying a single property on shared sample paths.
+struct SharedPathResult {
+  const CompiledPathProperty* path_property;
+  // Whether the property holds in the initial state.
+  bool accept;
+  // Mean of the observations used for the test; the probability estimate for
+  // estimation properties.
+  double mean;
+  int sample_size;
+};
+
+// Returns true if the given property can be verified on sample paths shared
+// with other properties.
+bool SupportsSharedPaths(const CompiledProperty& property);
+
+// Verifies properties on shared sample paths with the sampling engine.  Each
+// path is simulated once and advances a monitor for every property whose test
+// is still running; each property is retired independently once its test is
+// done.  All properties must be supported by SupportsSharedPaths.  Paths are
+// sampled in rounds by all threads of the pool, and the results only depend on
+// the number of threads.  Statistics for properties[i] are added to
+// (*stats)[i].
+std::vector<SharedPathResult> VerifyOnSharedPaths(
+    const std::vector<const CompiledProperty*>& properties,
+    const CompiledModel& model, const ModelCheckingParams& params,
+    const State& state, SamplingThreadPool* thread_pool,
+    std::vector<ModelCheckingStats>* stats);
 
+// Verifies property symbolically with the hybrid engine, using thread_count
+// threads for the matrix-vector multiplications of transient analysis.  The
+// rate matrix is converted to an explicit sparse matrix for transient analysis
+// if that needs at most sparse_memory_limit bytes.
 BDD Verify(const CompiledProperty& property,
            const DecisionDiagramModel& dd_model, bool top_level_property,
-           double epsilon);
+           double epsilon, int thread_count, double sparse_memory_limit);
 
 BDD VerifyExistsUntil(const DecisionDiagramModel& dd_model, const BDD& pre,
                       const BDD& post);
@@ -46,8 +46,6 @@ static void fill_sparse_bit_rec(HDDNode *hdd, int level, int num_levels,
                                 long row, long col, std::vector<double> *values,
                                 std::vector<size_t> *columns,
                                 std::vector<size_t> *row_starts, int code);
-static void hdd_negative_row_sums_rec(HDDNode *hdd, int level, int num_levels,
-                                      long row, double *res);
 
 //------------------------------------------------------------------------------
 // hybrid utility functions
@@ -284,7 +282,8 @@ void add_sparse_bits(HDDMatrix *hddm) {
     level_memory = 0;
     ptr = hddm->row_tables[i];
     while (ptr != NULL) {
-      level_memory += ((ptr->off2) * 12.0 + ((size_t)ptr->sb) * 4.0 + 5 * 4.0);
+      level_memory +=
+          SparseMatrix::MemoryEstimate((size_t)ptr->sb, ptr->off2) + 5 * 4.0;
       if (level_memory / 1024.0 > sb_max_mem) {
         sb_mem_out = true;
         break;
@@ -418,8 +417,7 @@ SparseMatrix *build_sparse_bit(HDDNode *hdd, int level, int num_levels) {
   }
   row_starts[0] = 0;
 
-  return new SparseMatrix(std::move(values), std::move(columns),
-                          std::move(row_starts));
+  return new SparseMatrix(values, columns, row_starts);
 }
 
 //------------------------------------------------------------------------------
@@ -466,68 +464,6 @@ void fill_sparse_bit_rec(HDDNode *hdd, int level, int num_levels, long row,
   }
 }
 
-//------------------------------------------------------------------------------
-// compute the negative row sums from the hdd of the rate matrix
-
-double *hdd_negative_row_sums(HDDMatrix *hddm, int n) {
-  HDDNode *hdd;
-  double *diags;
-  int i;
-
-  // get top hdd
-  hdd = hddm->top;
-
-  // allocate/initialise array
-  diags = new double[n];
-  for (i = 0; i < n; i++) {
-    diags[i] = 0.0;
-  }
-
-  // do row summing recursively
-  hdd_negative_row_sums_rec(hdd, 0, hddm->num_levels, 0, diags);
-
-  return diags;
-}
-
-//------------------------------------------------------------------------------
-
-void hdd_negative_row_sums_rec(HDDNode *hdd, int level, int num_levels,
-                               long row, double *diags) {
-  HDDNode *e, *t;
-
-  // if it's the zero node
-  if (hdd == zero) {
-    return;
-  }
-  // if there's a sparse bit
-  if (hdd->sb) {
-    for (auto element : *hdd->sb) {
-      diags[row + element.row()] -= element.value();
-    }
-    return;
-  }
-  // or if we've reached the bottom
-  if (level == num_levels) {
-    diags[row] -= hdd->type.val;
-    return;
-  }
-  // otherwise recurse
-  e = hdd->type.kids.e;
-  if (e != zero) {
-    hdd_negative_row_sums_rec(e->type.kids.e, level + 1, num_levels, row,
-                              diags);
-    hdd_negative_row_sums_rec(e->type.kids.t, level + 1, num_levels, row,
-                              diags);
-  }
-  t = hdd->type.kids.t;
-  if (t != zero) {
-    hdd_negative_row_sums_rec(t->type.kids.e, level + 1, num_levels,
-                              row + hdd->off, diags);
-    hdd_negative_row_sums_rec(t->type.kids.t, level + 1, num_levels,
-                              row + hdd->off, diags);
-  }
-}
-
 //------------------------------------------------------------------------------
 
 // free memory
@@ -75,7 +75,6 @@ struct HDDMatrix {
 // function prototypes
 
 HDDMatrix *build_hdd_matrix(const DecisionDiagramManager &ddman, const ADD &matrix, const OddNode *odd);
-double *hdd_negative_row_sums(HDDMatrix *hddm, int n);
 void free_hdd_matrix(HDDMatrix *hddm);
 
 //------------------------------------------------------------------------------
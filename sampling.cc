@@ -23,14 +23,25 @@
 
 #include "formulas.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <limits>
+#include <list>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
-#include <queue>
 #include <set>
+#include <sstream>
+#include <string>
 #include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
@@ -39,6 +50,7 @@
 #include "src/simulator.h"
 #include "src/statistics.h"
 #include "src/strutil.h"
+#include "src/timeutil.h"
 
 #include "glog/logging.h"
 #include "gsl/gsl_cdf.h"
@@ -59,14 +71,58 @@ struct ResultType<EstimationAlgorithm> {
   using type = double;
 };
 
-void PrintProgress(int n) {
+void PrintProgress(int n, std::ostream* out) {
   if (n % 1000 == 0) {
-    std::cout << ':';
+    *out << ':';
   } else if (n % 100 == 0) {
-    std::cout << '.';
+    *out << '.';
   }
 }
 
+// Spins, then yields, then sleeps while waiting for another thread to make
+// progress.
+class Backoff {
+ public:
+  Backoff() : count_(0) {}
+
+  // Starts over with spinning, after the awaited progress was made.
+  void Reset() { count_ = 0; }
+
+  void Wait() {
+    if (count_ < kSpinCount) {
+      ++count_;
+    } else if (count_ < kSpinCount + kYieldCount) {
+      ++count_;
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+ private:
+  static constexpr int kSpinCount = 64;
+  static constexpr int kYieldCount = 256;
+
+  int count_;
+};
+
+// A flag that a coordinator sets to tell worker threads that the paths they
+// are sampling are no longer needed.
+class CancellationToken {
+ public:
+  CancellationToken() : cancelled_(false) {}
+
+  bool cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+  void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+ private:
+  std::atomic<bool> cancelled_;
+};
+
+// Number of path steps between checks for cancellation.
+constexpr int kCancellationCheckInterval = 1024;
+
 struct DdCache {
   struct Entry {
     BDD dd1;
@@ -78,61 +134,708 @@ struct DdCache {
   std::mutex mutex;
 };
 
+// Memory limit for the sample cache used with memoization.
+constexpr size_t kSampleCacheMemoryLimit = size_t{256} << 20;
+
+// Minimum number of paths per worker thread that may be sampled ahead of the
+// sequential test, regardless of how few more observations the test is
+// expected to need.
+constexpr int kMinTargetDepthPerThread = 2;
+
+// Number of paths that each thread samples per round when verifying properties
+// on shared paths with multiple threads.
+constexpr int kSharedPathsPerThread = 32;
+
+// A sharded, memory-bounded cache of samples for nested probabilistic
+// properties, keyed by path property index and state, that is shared by all
+// threads.  Each shard evicts least recently used entries once its share of
+// the memory limit is exceeded.
+class SampleCache {
+ public:
+  explicit SampleCache(size_t memory_limit);
+
+  // Returns the cached sample for the given path property and state, if any.
+  std::optional<Sample<double>> Find(int index, const std::vector<int>& values);
+
+  // Stores a sample for the given path property and state.
+  void Insert(int index, const std::vector<int>& values,
+              const Sample<double>& sample);
+
+  int size() const;
+  int hit_count() const;
+  int miss_count() const;
+
+  // Appends the cached entries to entries as single lines that Load reads
+  // back, least recently used first within each shard.
+  void Save(std::vector<std::string>* entries) const;
+  // Inserts entries written by Save.  Returns false if an entry is malformed.
+  bool Load(const std::vector<std::string>& entries);
+
+ private:
+  static constexpr int kShardCount = 16;
+
+  struct Key {
+    int index;
+    std::vector<int> values;
+
+    bool operator==(const Key& other) const {
+      return index == other.index && values == other.values;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  struct Entry {
+    Sample<double> sample;
+    std::list<const Key*>::iterator lru_position;
+  };
+
+  struct Shard {
+    std::unordered_map<Key, Entry, KeyHash> entries;
+    // Most recently used first.
+    std::list<const Key*> lru;
+    size_t memory_usage = 0;
+    int hit_count = 0;
+    int miss_count = 0;
+    mutable std::mutex mutex;
+  };
+
+  static size_t EntryMemoryUsage(const Key& key);
+
+  Shard& GetShard(size_t hash) { return shards_[hash % kShardCount]; }
+
+  const size_t shard_memory_limit_;
+  Shard shards_[kShardCount];
+};
+
+SampleCache::SampleCache(size_t memory_limit)
+    : shard_memory_limit_(memory_limit / kShardCount) {}
+
+size_t SampleCache::KeyHash::operator()(const Key& key) const {
+  // FNV-1a over the property index and the state variable values.
+  uint64_t hash = 14695981039346656037ULL;
+  hash = (hash ^ static_cast<uint32_t>(key.index)) * 1099511628211ULL;
+  for (int value : key.values) {
+    hash = (hash ^ static_cast<uint32_t>(value)) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+size_t SampleCache::EntryMemoryUsage(const Key& key) {
+  // Includes an estimate of the hash map and list node overhead.
+  return sizeof(Key) + sizeof(Entry) + key.values.size() * sizeof(int) +
+         6 * sizeof(void*);
+}
+
+std::optional<Sample<double>> SampleCache::Find(
+    int index, const std::vector<int>& values) {
+  Key key = {index, values};
+  const size_t hash = KeyHash()(key);
+  Shard& shard = GetShard(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto ei = shard.entries.find(key);
+  if (ei == shard.entries.end()) {
+    ++shard.miss_count;
+    return std::nullopt;
+  }
+  ++shard.hit_count;
+  shard.lru.splice(shard.lru.begin(), shard.lru, ei->second.lru_position);
+  return ei->second.sample;
+}
+
+void SampleCache::Insert(int index, const std::vector<int>& values,
+                         const Sample<double>& sample) {
+  Key key = {index, values};
+  const size_t hash = KeyHash()(key);
+  Shard& shard = GetShard(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto ei = shard.entries.find(key);
+  if (ei != shard.entries.end()) {
+    ei->second.sample = sample;
+    shard.lru.splice(shard.lru.begin(), shard.lru, ei->second.lru_position);
+    return;
+  }
+  const size_t memory_usage = EntryMemoryUsage(key);
+  while (!shard.lru.empty() &&
+         shard.memory_usage + memory_usage > shard_memory_limit_) {
+    const Key* evicted_key = shard.lru.back();
+    shard.memory_usage -= EntryMemoryUsage(*evicted_key);
+    shard.lru.pop_back();
+    shard.entries.erase(*evicted_key);
+  }
+  ei = shard.entries.emplace(std::move(key), Entry{sample, {}}).first;
+  shard.lru.push_front(&ei->first);
+  ei->second.lru_position = shard.lru.begin();
+  shard.memory_usage += memory_usage;
+}
+
+int SampleCache::size() const {
+  int size = 0;
+  for (const Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    size += shard.entries.size();
+  }
+  return size;
+}
+
+int SampleCache::hit_count() const {
+  int hit_count = 0;
+  for (const Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    hit_count += shard.hit_count;
+  }
+  return hit_count;
+}
+
+int SampleCache::miss_count() const {
+  int miss_count = 0;
+  for (const Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    miss_count += shard.miss_count;
+  }
+  return miss_count;
+}
+
+void SampleCache::Save(std::vector<std::string>* entries) const {
+  for (const Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto ki = shard.lru.rbegin(); ki != shard.lru.rend(); ++ki) {
+      const Key& key = **ki;
+      std::ostringstream out;
+      out << key.index << ' ' << key.values.size();
+      for (int value : key.values) {
+        out << ' ' << value;
+      }
+      out << ' ';
+      shard.entries.find(key)->second.sample.Save(&out);
+      std::string entry = out.str();
+      entry.pop_back();
+      entries->push_back(std::move(entry));
+    }
+  }
+}
+
+bool SampleCache::Load(const std::vector<std::string>& entries) {
+  for (const std::string& entry : entries) {
+    std::istringstream in(entry);
+    int index;
+    size_t value_count;
+    if (!(in >> index >> value_count) || value_count > entry.size()) {
+      return false;
+    }
+    std::vector<int> values(value_count);
+    for (int& value : values) {
+      if (!(in >> value)) {
+        return false;
+      }
+    }
+    Sample<double> sample;
+    if (!sample.Load(&in)) {
+      return false;
+    }
+    Insert(index, values, sample);
+  }
+  return true;
+}
+
+// Matches properties that can be verified on shared sample paths: optionally
+// negated probability threshold or estimation properties over an until
+// property with non-probabilistic operands.
+class SharedPathPropertyMatcher final : public CompiledPropertyVisitor,
+                                        public CompiledPathPropertyVisitor {
+ public:
+  explicit SharedPathPropertyMatcher(const CompiledProperty& property);
+
+  bool matches() const { return path_property_ != nullptr; }
+  bool negated() const { return negated_; }
+  bool is_estimation() const { return is_estimation_; }
+  double threshold() const { return threshold_; }
+  const CompiledUntilProperty* path_property() const { return path_property_; }
+
+ private:
+  void DoVisitCompiledNaryProperty(
+      const CompiledNaryProperty& property) override {}
+  void DoVisitCompiledNotProperty(const CompiledNotProperty& property) override;
+  void DoVisitCompiledProbabilityThresholdProperty(
+      const CompiledProbabilityThresholdProperty& property) override;
+  void DoVisitCompiledProbabilityEstimationProperty(
+      const CompiledProbabilityEstimationProperty& property) override;
+  void DoVisitCompiledExpressionProperty(
+      const CompiledExpressionProperty& property) override {}
+  void DoVisitCompiledUntilProperty(
+      const CompiledUntilProperty& path_property) override;
+
+  bool negated_;
+  bool is_estimation_;
+  double threshold_;
+  const CompiledUntilProperty* path_property_;
+};
+
+SharedPathPropertyMatcher::SharedPathPropertyMatcher(
+    const CompiledProperty& property)
+    : negated_(false),
+      is_estimation_(false),
+      threshold_(0.5),
+      path_property_(nullptr) {
+  property.Accept(this);
+}
+
+void SharedPathPropertyMatcher::DoVisitCompiledNotProperty(
+    const CompiledNotProperty& property) {
+  negated_ = !negated_;
+  property.operand().Accept(this);
+}
+
+void SharedPathPropertyMatcher::DoVisitCompiledProbabilityThresholdProperty(
+    const CompiledProbabilityThresholdProperty& property) {
+  threshold_ = property.threshold();
+  property.path_property().Accept(this);
+}
+
+void SharedPathPropertyMatcher::DoVisitCompiledProbabilityEstimationProperty(
+    const CompiledProbabilityEstimationProperty& property) {
+  is_estimation_ = true;
+  property.path_property().Accept(this);
+}
+
+void SharedPathPropertyMatcher::DoVisitCompiledUntilProperty(
+    const CompiledUntilProperty& path_property) {
+  if (!path_property.pre_property().is_probabilistic() &&
+      !path_property.post_property().is_probabilistic()) {
+    path_property_ = &path_property;
+  }
+}
+
+// Estimates the relative cost of verifying a property, in expected number of
+// sampled paths, for use when allocating error bounds among operands.  The
+// cost of a probabilistic property is the expected sample size of the SPRT for
+// its indifference region, times one plus the cost of the nested properties
+// verified in each path state.
+class OperandCostEstimator final : public CompiledPropertyVisitor,
+                                   public CompiledPathPropertyVisitor {
+ public:
+  explicit OperandCostEstimator(const ModelCheckingParams& params);
+
+  // Returns the estimated cost of verifying the given property.
+  double Estimate(const CompiledProperty& property);
+
+ private:
+  void DoVisitCompiledNaryProperty(
+      const CompiledNaryProperty& property) override;
+  void DoVisitCompiledNotProperty(const CompiledNotProperty& property) override;
+  void DoVisitCompiledProbabilityThresholdProperty(
+      const CompiledProbabilityThresholdProperty& property) override;
+  void DoVisitCompiledProbabilityEstimationProperty(
+      const CompiledProbabilityEstimationProperty& property) override;
+  void DoVisitCompiledExpressionProperty(
+      const CompiledExpressionProperty& property) override;
+  void DoVisitCompiledUntilProperty(
+      const CompiledUntilProperty& path_property) override;
+
+  void VisitProbabilisticProperty(double theta,
+                                  const CompiledPathProperty& path_property);
+
+  const ModelCheckingParams& params_;
+  double cost_;
+};
+
+OperandCostEstimator::OperandCostEstimator(const ModelCheckingParams& params)
+    : params_(params), cost_(0.0) {}
+
+double OperandCostEstimator::Estimate(const CompiledProperty& property) {
+  cost_ = 0.0;
+  property.Accept(this);
+  return cost_;
+}
+
+void OperandCostEstimator::DoVisitCompiledNaryProperty(
+    const CompiledNaryProperty& property) {
+  double cost = 0.0;
+  for (const CompiledProperty& operand : property.other_operands()) {
+    cost += Estimate(operand);
+  }
+  cost_ = cost;
+}
+
+void OperandCostEstimator::DoVisitCompiledNotProperty(
+    const CompiledNotProperty& property) {
+  property.operand().Accept(this);
+}
+
+void OperandCostEstimator::DoVisitCompiledProbabilityThresholdProperty(
+    const CompiledProbabilityThresholdProperty& property) {
+  VisitProbabilisticProperty(property.threshold(), property.path_property());
+}
+
+void OperandCostEstimator::DoVisitCompiledProbabilityEstimationProperty(
+    const CompiledProbabilityEstimationProperty& property) {
+  VisitProbabilisticProperty(0.5, property.path_property());
+}
+
+void OperandCostEstimator::DoVisitCompiledExpressionProperty(
+    const CompiledExpressionProperty& property) {
+  cost_ = 0.0;
+}
+
+void OperandCostEstimator::DoVisitCompiledUntilProperty(
+    const CompiledUntilProperty& path_property) {
+  cost_ = Estimate(path_property.pre_property()) +
+          Estimate(path_property.post_property());
+}
+
+void OperandCostEstimator::VisitProbabilisticProperty(
+    double theta, const CompiledPathProperty& path_property) {
+  const auto region = NestedIndifferenceRegion(theta, params_.delta, 0.0);
+  path_property.Accept(this);
+  cost_ = SprtExpectedSampleSize(region.first, region.second, params_.alpha,
+                                 params_.beta) *
+          (1 + cost_);
+}
+
+// Returns the expected sample size of the test for the given threshold
+// algorithm, with observations distributed as in the given pilot sample.
+// Bayesian tests are approximated by the SPRT and the Chow-Robbins test, and
+// single sampling plans by their maximum sample size.
+double ExpectedSampleSize(ThresholdAlgorithm algorithm, double theta0,
+                          double theta1, const ModelCheckingParams& params,
+                          const Sample<double>& pilot) {
+  const double p = std::min(1.0, pilot.mean());
+  switch (algorithm) {
+    case ThresholdAlgorithm::FIXED:
+      return params.fixed_sample_size;
+    case ThresholdAlgorithm::SSP:
+      return SingleSamplingPlan::Create(theta0, theta1, params.alpha,
+                                        params.beta)
+          .n();
+    case ThresholdAlgorithm::SPRT:
+    case ThresholdAlgorithm::BAYES_FACTOR:
+      return SprtExpectedSampleSize(theta0, theta1, params.alpha, params.beta,
+                                    p);
+    case ThresholdAlgorithm::CHOW_ROBBINS:
+    case ThresholdAlgorithm::BAYESIAN_INTERVAL:
+      return ChowRobbinsExpectedSampleSize(theta0, theta1, params.alpha,
+                                           pilot.variance());
+  }
+  LOG(FATAL) << "bad threshold algorithm";
+}
+
+// Returns the expected sample size of the test for the given estimation
+// algorithm, with observations distributed as in the given pilot sample.
+double ExpectedSampleSize(EstimationAlgorithm algorithm, double theta0,
+                          double theta1, const ModelCheckingParams& params,
+                          const Sample<double>& pilot) {
+  switch (algorithm) {
+    case EstimationAlgorithm::FIXED:
+      return params.fixed_sample_size;
+    case EstimationAlgorithm::CHOW_ROBBINS:
+    case EstimationAlgorithm::BAYESIAN_INTERVAL:
+      return ChowRobbinsExpectedSampleSize(theta0, theta1, params.alpha,
+                                           pilot.variance());
+  }
+  LOG(FATAL) << "bad estimation algorithm";
+}
+
+class StateLess {
+ public:
+  bool operator()(const State& lhs, const State& rhs) const {
+    return lhs.values() < rhs.values();
+  }
+};
+
 class SamplingVerifier final : public CompiledPropertyVisitor,
                                public CompiledPathPropertyVisitor {
  private:
+  // The outcome of a single sample path, for path statistics.
+  struct PathOutcome {
+    int path_length;
+    bool early_termination;
+    bool value;
+  };
+
   struct Result {
+    // Returns the number of observations that this result represents.
+    int observation_count() const {
+      return group.has_value() ? group->count() : 1;
+    }
+
     int path_length;
     bool early_termination;
     bool value;
+    // Time at which the path satisfied an until property, or infinity if it
+    // did not.  Only meaningful for until properties without probabilistic
+    // operands.
+    double first_passage_time;
+    // The observations of a group of paths in group-sequential mode, in which
+    // case the other fields describe the last path of the group.  Unset
+    // unless paths are sampled in groups of more than one.
+    std::optional<Sample<double>> group;
+  };
+
+  // Path statistics recorded by a worker thread.  The outcome of each path is
+  // tagged with the sequence number of its result and held back until the
+  // coordinator has consumed that result, so that the shard only covers paths
+  // that the test used.  The mutex is only contended when the coordinator
+  // moves the statistics out of the shard.
+  class PathStatsShard {
+   public:
+    explicit PathStatsShard(bool populate_distribution)
+        : stats_(populate_distribution) {}
+
+    // Holds back the outcome of a path for the result with the given sequence
+    // number.
+    void Add(int64_t sequence, const PathOutcome& outcome);
+
+    // Records the held-back outcomes of results with sequence numbers below
+    // consumed_count.
+    void Commit(int64_t consumed_count);
+
+    // Commits outcomes as for Commit, and then moves all recorded statistics
+    // from this shard to stats.
+    void MoveCommittedTo(int64_t consumed_count, ModelCheckingStats* stats);
+
+   private:
+    void CommitLocked(int64_t consumed_count);
+
+    std::mutex mutex_;
+    ModelCheckingStats stats_;
+    std::deque<std::pair<int64_t, PathOutcome>> pending_;
   };
 
+  // A bounded single-producer/single-consumer lock-free ring buffer that
+  // carries results, tagged with their sequence numbers, from a worker thread
+  // to the coordinator.  The producer publishes results in batches of up to
+  // kPublishBatchSize, and sooner when the coordinator is about to need them
+  // or is waiting.  Both sides cache the other side's index so that the
+  // shared indices are only read when the cached view is exhausted.
   class ResultQueue {
    public:
-    ResultQueue();
+    struct Entry {
+      int64_t sequence;
+      Result result;
+    };
 
-    int pop_count() const { return pop_count_; }
+    ResultQueue();
 
     int push_count() const { return push_count_; }
 
-    bool Enabled() const;
+    // Returns true if the producer can push another result without waiting.
+    bool HasSpace();
 
-    void Push(const Result& result);
+    // Pushes the given entry, which requires HasSpace() to be true.  Pending
+    // entries are published if there are enough of them, if the consumer is
+    // waiting, or if the oldest of them has a sequence number below
+    // publish_before.
+    void Push(Entry&& entry, int64_t publish_before);
 
-    Result Pop();
+    // Makes all pushed entries visible to the consumer.
+    void Publish();
 
-    void Disable();
+    // Returns the next published entry, or nullptr if there is none.  The
+    // entry stays valid until the next call to Pop.
+    Entry* Front();
+
+    // Removes the entry returned by Front.
+    void Pop() {
+      head_.store(head_.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+    }
+
+    // Tells the producer whether the consumer is waiting for a result.
+    void SetConsumerWaiting(bool waiting) {
+      consumer_waiting_.store(waiting, std::memory_order_relaxed);
+    }
 
    private:
-    std::queue<Result> results_;
-    mutable std::mutex mutex_;
-    std::condition_variable cv_;
+    static constexpr uint64_t kCapacity = 1024;
+    static constexpr uint64_t kPublishBatchSize = 16;
+
+    // Written by the producer.
+    alignas(64) std::atomic<uint64_t> tail_;
+    uint64_t pending_tail_;
+    uint64_t cached_head_;
     int push_count_;
-    int pop_count_;
-    bool enabled_;
+    // Written by the consumer.
+    alignas(64) std::atomic<uint64_t> head_;
+    uint64_t cached_tail_;
+    alignas(64) std::atomic<bool> consumer_waiting_;
+    std::unique_ptr<Entry[]> entries_;
+  };
+
+  // A bounded reorder buffer for results from worker threads.  Workers claim
+  // global sequence numbers before sampling a path and push their results to
+  // a ResultQueue of their own.  The coordinator drains the queues into a
+  // reorder window and consumes results in sequence order.  The observations
+  // used by a test therefore do not depend on path durations, while any idle
+  // thread can take the next path.  Workers cannot claim while they are more
+  // than kCapacity paths ahead of the coordinator, when they have reached the
+  // target depth, or when their queue is full.
+  class ResultReorderBuffer {
+   public:
+    explicit ResultReorderBuffer(int thread_count);
+
+    int pop_count(int thread_index) const { return pop_counts_[thread_index]; }
+
+    int push_count(int thread_index) const {
+      return queues_[thread_index]->push_count();
+    }
+
+    bool Enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Returns the number of results taken so far.
+    int64_t consumed_count() const {
+      return head_.load(std::memory_order_acquire);
+    }
+
+    // Returns the number of results that were stored but never taken.
+    int wasted_count() const;
+
+    // Limits claims to the given number of sequence numbers past the next
+    // result to take.  Must be called from the thread that takes results.
+    void SetTargetDepth(int64_t depth);
+
+    // Returns the next sequence number for the given thread to sample, or -1
+    // if the buffer is full, the target depth has been reached, or the
+    // thread's queue is full.  Never blocks, so that a waiting worker can help
+    // with nested tasks instead.
+    int64_t TryClaim(int thread_index);
+
+    // Stores the result for the given sequence number, sampled by the given
+    // thread.
+    void Put(int64_t sequence, int thread_index, Result&& result);
+
+    // Publishes any results that the given thread has stored but not yet
+    // published.  Called by a worker before it backs off.
+    void Flush(int thread_index) { queues_[thread_index]->Publish(); }
+
+    // Returns the result with the next sequence number, waiting for it to be
+    // stored if necessary.
+    Result Take();
+
+    void Disable() { enabled_.store(false, std::memory_order_relaxed); }
+
+   private:
+    static constexpr int64_t kCapacity = 4096;
+
+    bool Full(int64_t sequence) const {
+      return sequence - head_.load(std::memory_order_acquire) >= kCapacity ||
+             sequence >= limit_.load(std::memory_order_acquire);
+    }
+
+    // Moves all published results from the worker queues to the window.
+    void Drain();
+
+    struct Slot {
+      // Sequence number of the result in this slot, or -1 if empty.
+      int64_t sequence;
+      int thread_index;
+      Result result;
+    };
+
+    alignas(64) std::atomic<int64_t> next_sequence_;
+    alignas(64) std::atomic<int64_t> head_;
+    std::atomic<int64_t> limit_;
+    std::atomic<bool> enabled_;
+    std::vector<std::unique_ptr<ResultQueue>> queues_;
+    // Only accessed by the coordinator.
+    std::unique_ptr<Slot[]> window_;
+    std::vector<int> pop_counts_;
+  };
+
+  // A nested probabilistic test, started on a worker thread, that idle
+  // workers can help with by sampling paths for it.  Paths are claimed in
+  // sequence, and the owner consumes results in claim order regardless of
+  // which thread produced them, so helping does not bias the test towards
+  // short paths.
+  struct NestedTask {
+    NestedTask(const CompiledPathProperty* path_property, const State* state,
+               const ModelCheckingParams& params, int probabilistic_level,
+               const CancellationToken* cancellation);
+
+    // Returns the next sequence number to sample, or -1 if no more paths are
+    // wanted at this time.
+    int Claim();
+
+    const CompiledPathProperty* const path_property;
+    const State* const state;
+    const ModelCheckingParams params;
+    const int probabilistic_level;
+    // Cancellation token of the path that the test belongs to, which helpers
+    // use for the paths they sample.  May be null.
+    const CancellationToken* const cancellation;
+    std::atomic<int> next_index;
+    std::atomic<int> index_limit;
+    std::atomic<int> helper_count;
+    std::mutex mutex;
+    std::map<int, Result> results;
   };
 
  public:
+  // Nested tasks that are open for help, shared by all verifiers of a single
+  // top-level property.
+  struct NestedTaskQueue {
+    std::vector<NestedTask*> tasks;
+    std::mutex mutex;
+  };
+
   SamplingVerifier(
       const CompiledModel* model, const DecisionDiagramModel* dd_model,
-      DdCache* dd_cache, ModelCheckingStats* stats,
+      DdCache* dd_cache, SampleCache* sample_cache,
+      NestedTaskQueue* nested_tasks, ModelCheckingStats* stats,
       const ModelCheckingParams& params, const State* state,
-      std::vector<CompiledExpressionEvaluator>* evaluators,
-      std::vector<CompiledDistributionSampler<std::mt19937_64>>* samplers,
-      std::vector<NextStateSampler<std::mt19937_64>>* simulators);
+      SamplingThreadPool* thread_pool);
 
   SamplingVerifier(
       const CompiledModel* model, const DecisionDiagramModel* dd_model,
-      DdCache* dd_cache, ModelCheckingStats* stats,
+      DdCache* dd_cache, SampleCache* sample_cache,
+      NestedTaskQueue* nested_tasks, ModelCheckingStats* stats,
       const ModelCheckingParams& params, const State* state,
-      std::vector<CompiledExpressionEvaluator>* evaluators,
-      std::vector<CompiledDistributionSampler<std::mt19937_64>>* samplers,
-      std::vector<NextStateSampler<std::mt19937_64>>* simulators,
-      int thread_index, ResultQueue* result_queue);
+      SamplingThreadPool* thread_pool, int thread_index,
+      int probabilistic_level);
 
   bool result() const { return result_.value; }
 
-  int GetSampleCacheSize() const;
+  // Resumes the top-level tests from the given state, if not nullptr, and
+  // offers checkpoints to the given checkpointer, if not nullptr.
+  void SetCheckpointing(const VerifierState* resume_state,
+                        VerifyCheckpointer* checkpointer);
+
+  // Reports snapshots of the top-level tests to the given listener.
+  void set_progress(VerifyProgressListener* progress) { progress_ = progress; }
+
+  // Writes the progress and results of top-level tests to out instead of
+  // std::cout.
+  void set_out(std::ostream* out) { out_ = out; }
+
+  // Predicts the cost of the outermost probabilistic tests of the given
+  // property instead of verifying it.  Samples pilot_path_count paths for
+  // each test, with nested properties verified as usual.
+  std::vector<SamplingPlan> Plan(const CompiledProperty& property,
+                                 int pilot_path_count);
+
+  // Verifies the given properties, which must all be supported by
+  // SupportsSharedPaths, on shared sample paths.
+  std::vector<SharedPathResult> VerifyOnSharedPaths(
+      const std::vector<const CompiledProperty*>& properties,
+      std::vector<ModelCheckingStats>* stats);
+
+  // Samples a single path, advancing a monitor for each of the given path
+  // properties until each has been decided, and sets (*outcomes)[i] to the
+  // outcome for path_properties[i].
+  void SampleSharedPath(
+      const std::vector<const CompiledUntilProperty*>& path_properties,
+      std::vector<PathOutcome>* outcomes);
+
+  // Samples paths for the until property of the given property, which must be
+  // supported by SupportsFirstPassageTimes, and returns the distribution of
+  // their first passage times.
+  FirstPassageDistribution SampleFirstPassageTimes(
+      const CompiledProperty& property);
+
+  // Samples a path for an open nested task, if there is one.  Returns false if
+  // there was no nested task to help with.
+  bool HelpWithNestedTask();
 
  private:
   void DoVisitCompiledNaryProperty(
@@ -151,6 +854,30 @@ class SamplingVerifier final : public CompiledPropertyVisitor,
   std::unique_ptr<SequentialTester<typename ResultType<Algorithm>::type>>
   VerifyProbabilisticProperty(Algorithm algorithm, double theta,
                               const CompiledPathProperty& path_property);
+  // Starts checkpointing of a new top-level test, restoring the sample of the
+  // test from resume_state_ if the state has one.
+  template <typename T>
+  void ResumeTopLevelTest(SequentialTester<T>* tester);
+  // Records the sample of the current top-level test in checkpoint_state_,
+  // and saves a checkpoint if save is true.
+  template <typename T>
+  void CheckpointTopLevelTest(const SequentialTester<T>& tester, bool save);
+  // Reports a snapshot of the current top-level test to progress_.  The
+  // confidence interval has coverage 1 - alpha, and busy_time holds the
+  // nanoseconds that each pool thread has spent sampling paths for the test,
+  // or is nullptr if the test does not use worker threads.
+  template <typename T>
+  void ReportTopLevelTest(const SequentialTester<T>& tester, double alpha,
+                          const Timer<>& timer,
+                          const std::atomic<int64_t>* busy_time, bool done);
+  // Adds a plan for a test with the given algorithm and indifference region
+  // to plans_, sampling pilot paths for path_property with the given nested
+  // parameters.
+  template <typename Algorithm>
+  void PlanProbabilisticProperty(Algorithm algorithm, double theta0,
+                                 double theta1,
+                                 const CompiledPathProperty& path_property,
+                                 const ModelCheckingParams& nested_params);
   template <typename Algorithm>
   std::unique_ptr<SequentialTester<typename ResultType<Algorithm>::type>>
   NewSequentialTester(Algorithm algorithm, double theta0, double theta1) const;
@@ -158,71 +885,171 @@ class SamplingVerifier final : public CompiledPropertyVisitor,
   bool VerifyHelper(const CompiledProperty& property,
                     const std::optional<BDD>& ddf, bool default_result,
                     OutputIterator* state_inserter);
+  // A top-level path whose nested checks have been deferred.
+  struct DeferredPath {
+    const CompiledUntilProperty* path_property;
+    double alpha;
+    double beta;
+    std::set<State, StateLess> unique_pre_states;
+    std::vector<State> post_states;
+    // Position of the path in the batch.
+    int index;
+  };
+
+  // Results of nested checks, keyed by property and state.
+  using NestedResultMap =
+      std::map<std::pair<const CompiledProperty*, std::vector<int>>, bool>;
+
+  // Sets result_.value to the result of verifying the probabilistic operands
+  // of path_property in the given states.
+  void VerifyNestedStates(const CompiledUntilProperty& path_property,
+                          const std::set<State, StateLess>& unique_pre_states,
+                          const std::vector<State>& post_states);
+  // Sets result_.value to the result of verifying property in state, using
+  // nested_results_ if it has a result for the pair.
+  void VerifyInState(const CompiledProperty& property, const State& state);
+  // Samples a batch of paths for path_property, deferring nested checks until
+  // the end of the batch.  The distinct nested checks of the batch are then
+  // verified once each, in parallel if there are pool threads, before the
+  // results of the paths are resolved.
+  //
+  // The top-level paths of a batch are sampled on the calling thread only.
+  // With deferred checks they are cheap compared to the nested checks, which
+  // is where the pool threads are used instead.  Paths of a batch that visit
+  // the same nested state share the result of a single nested check, so their
+  // observations are no longer independent: an erroneous nested result
+  // affects all of them at once.  Each shared check uses the strictest error
+  // bounds that any of the paths needs, so the marginal error of every
+  // observation is still within the bounds that the top-level test accounts
+  // for, but the variance of the number of erroneous observations grows with
+  // the batch size.
+  void SampleNestedBatch(const CompiledPathProperty& path_property,
+                         std::vector<Result>* results);
+  // Sets result_ to the next result for the given nested task, sampling paths
+  // on this thread while the next result is not available from a helper.
+  void NextNestedTaskResult(NestedTask* task, int index);
+  // Records the length of a path with the given outcome in stats.
+  static void AddPathStats(const PathOutcome& outcome,
+                           ModelCheckingStats* stats);
+  // Records the length of a path with the given result in stats.
+  static void AddPathStats(const Result& result, ModelCheckingStats* stats);
+  // Returns the observation for a path with the given result.  Accepted paths
+  // of unbounded path properties are weighted to correct for the termination
+  // probability.
+  double ObservationWeight(const CompiledPathProperty& path_property,
+                           const Result& result) const;
+  // Limits how far worker threads may sample ahead of the given tester, in
+  // groups of the given number of paths.
+  template <typename T>
+  void SetTargetDepth(const SequentialTester<T>& tester, int group_size,
+                      ResultReorderBuffer* results) const;
+  // Returns the error bounds for the operands of the given property, which
+  // together sum to error.  The error is split in proportion to the estimated
+  // operand costs if error optimization is enabled, and evenly otherwise.
+  std::vector<double> OperandErrors(double error,
+                                    const CompiledNaryProperty& property) const;
   std::string StateToString(const State& state) const;
+  // Returns true if the path being sampled is no longer needed.  Cancelled
+  // paths have no meaningful result and must be discarded.
+  bool Cancelled() const {
+    return cancellation_ != nullptr && cancellation_->cancelled();
+  }
 
   const CompiledModel* const model_;
   const DecisionDiagramModel* const dd_model_;
   DdCache* const dd_cache_;
+  SampleCache* const sample_cache_;
+  NestedTaskQueue* const nested_tasks_;
   ModelCheckingStats* const stats_;
   Result result_;
   ModelCheckingParams params_;
   const State* state_;
   int probabilistic_level_;
-  std::vector<CompiledExpressionEvaluator>* evaluators_;
+  // Plans of the outermost probabilistic tests when planning, or nullptr.
+  std::vector<SamplingPlan>* plans_;
+  int pilot_path_count_;
+  // Checkpointing of top-level tests; only set for a top-level verifier.
+  const VerifierState* resume_state_;
+  VerifyCheckpointer* checkpointer_;
+  VerifierState checkpoint_state_;
+  // Receives snapshots of top-level tests if not null.
+  VerifyProgressListener* progress_;
+  // Receives the progress and results of top-level tests.
+  std::ostream* out_;
+  SamplingThreadPool* const thread_pool_;
   CompiledExpressionEvaluator* evaluator_;
-  std::vector<CompiledDistributionSampler<std::mt19937_64>>* samplers_;
   CompiledDistributionSampler<std::mt19937_64>* sampler_;
-  std::vector<NextStateSampler<std::mt19937_64>>* simulators_;
   NextStateSampler<std::mt19937_64>* simulator_;
-  ResultQueue* const result_queue_;
-  std::unordered_map<int, std::map<std::vector<int>, Sample<double>>>
-      sample_cache_;
+  // Index of the pool thread this verifier runs on, or -1 for the verifier of
+  // the top-level property.
+  const int thread_index_;
+  // Receives paths with deferred nested checks if not null.
+  std::vector<DeferredPath>* deferred_paths_;
+  // Results of nested checks for resolving deferred paths if not null.
+  const NestedResultMap* nested_results_;
+  // Cancels the paths sampled by this verifier if not null.
+  const CancellationToken* cancellation_;
 };
 
 SamplingVerifier::SamplingVerifier(
     const CompiledModel* model, const DecisionDiagramModel* dd_model,
-    DdCache* dd_cache, ModelCheckingStats* stats,
+    DdCache* dd_cache, SampleCache* sample_cache,
+    NestedTaskQueue* nested_tasks, ModelCheckingStats* stats,
     const ModelCheckingParams& params, const State* state,
-    std::vector<CompiledExpressionEvaluator>* evaluators,
-    std::vector<CompiledDistributionSampler<std::mt19937_64>>* samplers,
-    std::vector<NextStateSampler<std::mt19937_64>>* simulators)
+    SamplingThreadPool* thread_pool)
     : model_(model),
       dd_model_(dd_model),
       dd_cache_(dd_cache),
+      sample_cache_(sample_cache),
+      nested_tasks_(nested_tasks),
       stats_(stats),
       params_(params),
       state_(state),
       probabilistic_level_(0),
-      evaluators_(evaluators),
-      evaluator_(&(*evaluators)[0]),
-      samplers_(samplers),
-      sampler_(&(*samplers)[0]),
-      simulators_(simulators),
-      simulator_(&(*simulators)[0]),
-      result_queue_(nullptr) {}
+      plans_(nullptr),
+      pilot_path_count_(0),
+      resume_state_(nullptr),
+      checkpointer_(nullptr),
+      progress_(nullptr),
+      out_(&std::cout),
+      thread_pool_(thread_pool),
+      evaluator_(thread_pool->evaluator(0)),
+      sampler_(thread_pool->sampler(0)),
+      simulator_(thread_pool->simulator(0)),
+      thread_index_(-1),
+      deferred_paths_(nullptr),
+      nested_results_(nullptr),
+      cancellation_(nullptr) {}
 
 SamplingVerifier::SamplingVerifier(
     const CompiledModel* model, const DecisionDiagramModel* dd_model,
-    DdCache* dd_cache, ModelCheckingStats* stats,
+    DdCache* dd_cache, SampleCache* sample_cache,
+    NestedTaskQueue* nested_tasks, ModelCheckingStats* stats,
     const ModelCheckingParams& params, const State* state,
-    std::vector<CompiledExpressionEvaluator>* evaluators,
-    std::vector<CompiledDistributionSampler<std::mt19937_64>>* samplers,
-    std::vector<NextStateSampler<std::mt19937_64>>* simulators,
-    int thread_index, ResultQueue* result_queue)
+    SamplingThreadPool* thread_pool, int thread_index, int probabilistic_level)
     : model_(model),
       dd_model_(dd_model),
       dd_cache_(dd_cache),
+      sample_cache_(sample_cache),
+      nested_tasks_(nested_tasks),
       stats_(stats),
       params_(params),
       state_(state),
-      probabilistic_level_(1),
-      evaluators_(evaluators),
-      evaluator_(&(*evaluators)[thread_index]),
-      samplers_(samplers),
-      sampler_(&(*samplers)[thread_index]),
-      simulators_(simulators),
-      simulator_(&(*simulators)[thread_index]),
-      result_queue_(result_queue) {}
+      probabilistic_level_(probabilistic_level),
+      plans_(nullptr),
+      pilot_path_count_(0),
+      resume_state_(nullptr),
+      checkpointer_(nullptr),
+      progress_(nullptr),
+      out_(&std::cout),
+      thread_pool_(thread_pool),
+      evaluator_(thread_pool->evaluator(thread_index)),
+      sampler_(thread_pool->sampler(thread_index)),
+      simulator_(thread_pool->simulator(thread_index)),
+      thread_index_(thread_index),
+      deferred_paths_(nullptr),
+      nested_results_(nullptr),
+      cancellation_(nullptr) {}
 
 void SamplingVerifier::DoVisitCompiledNaryProperty(
     const CompiledNaryProperty& property) {
@@ -234,15 +1061,17 @@ void SamplingVerifier::DoVisitCompiledNaryProperty(
             property.expr_operand().expr(), state_->values());
       }
       if (result_.value == true && !property.other_operands().empty()) {
-        double alpha = params_.alpha / property.other_operands().size();
-        std::swap(params_.alpha, alpha);
-        for (const CompiledProperty& operand : property.other_operands()) {
-          operand.Accept(this);
-          if (result_.value == false) {
+        const std::vector<double> alphas =
+            OperandErrors(params_.alpha, property);
+        double alpha = params_.alpha;
+        for (size_t i = 0; i < alphas.size(); ++i) {
+          params_.alpha = alphas[i];
+          property.other_operands()[i].Accept(this);
+          if (result_.value == false && plans_ == nullptr) {
             break;
           }
         }
-        std::swap(params_.alpha, alpha);
+        params_.alpha = alpha;
       }
       break;
     case CompiledNaryOperator::OR:
@@ -252,15 +1081,16 @@ void SamplingVerifier::DoVisitCompiledNaryProperty(
             property.expr_operand().expr(), state_->values());
       }
       if (result_.value == false && !property.other_operands().empty()) {
-        double beta = params_.beta / property.other_operands().size();
-        std::swap(params_.beta, beta);
-        for (const CompiledProperty& operand : property.other_operands()) {
-          operand.Accept(this);
-          if (result_.value == true) {
+        const std::vector<double> betas = OperandErrors(params_.beta, property);
+        double beta = params_.beta;
+        for (size_t i = 0; i < betas.size(); ++i) {
+          params_.beta = betas[i];
+          property.other_operands()[i].Accept(this);
+          if (result_.value == true && plans_ == nullptr) {
             break;
           }
         }
-        std::swap(params_.beta, beta);
+        params_.beta = beta;
       }
       break;
     case CompiledNaryOperator::IFF: {
@@ -270,22 +1100,22 @@ void SamplingVerifier::DoVisitCompiledNaryProperty(
             property.expr_operand().expr(), state_->values());
         has_value = true;
       }
-      double alpha = std::min(params_.alpha, params_.beta) /
-                     property.other_operands().size();
-      double beta = std::min(params_.alpha, params_.beta) /
-                    property.other_operands().size();
-      std::swap(params_.alpha, alpha);
-      std::swap(params_.beta, beta);
-      for (const CompiledProperty& operand : property.other_operands()) {
+      const std::vector<double> errors =
+          OperandErrors(std::min(params_.alpha, params_.beta), property);
+      double alpha = params_.alpha;
+      double beta = params_.beta;
+      for (size_t i = 0; i < errors.size(); ++i) {
+        params_.alpha = errors[i];
+        params_.beta = errors[i];
         bool prev_value = result_.value;
-        operand.Accept(this);
+        property.other_operands()[i].Accept(this);
         if (has_value) {
           result_.value = prev_value == result_.value;
         }
         has_value = true;
       }
-      std::swap(params_.beta, beta);
-      std::swap(params_.alpha, alpha);
+      params_.beta = beta;
+      params_.alpha = alpha;
       break;
     }
   }
@@ -314,18 +1144,211 @@ void SamplingVerifier::DoVisitCompiledProbabilityEstimationProperty(
     const CompiledProbabilityEstimationProperty& property) {
   auto tester = VerifyProbabilisticProperty(params_.estimation_algorithm, 0.5,
                                             property.path_property());
-  if (probabilistic_level_ == 0) {
-    std::cout << "Pr[" << property.path_property().string()
-              << "] = " << tester->sample().mean() << " ("
-              << std::max(0.0, tester->sample().mean() - params_.delta) << ','
-              << std::min(1.0, tester->sample().mean() + params_.delta) << ")"
-              << std::endl;
+  if (probabilistic_level_ == 0 && plans_ == nullptr) {
+    stats_->estimate.AddObservation(tester->Estimate());
+    *out_ << "Pr[" << property.path_property().string()
+          << "] = " << tester->Estimate() << " ("
+          << std::max(0.0, tester->Estimate() - params_.delta) << ','
+          << std::min(1.0, tester->Estimate() + params_.delta) << ")"
+          << std::endl;
   }
 }
 
-template <typename Algorithm>
-std::unique_ptr<SequentialTester<typename ResultType<Algorithm>::type>>
-SamplingVerifier::VerifyProbabilisticProperty(
+double SamplingVerifier::ObservationWeight(
+    const CompiledPathProperty& path_property, const Result& result) const {
+  if (!result.value) {
+    return 0;
+  }
+  if (dd_model_ == nullptr && path_property.is_unbounded()) {
+    return pow(1 - params_.termination_probability, -(result.path_length - 1));
+  }
+  return 1;
+}
+
+void SamplingVerifier::SetCheckpointing(const VerifierState* resume_state,
+                                        VerifyCheckpointer* checkpointer) {
+  resume_state_ = resume_state;
+  checkpointer_ = checkpointer;
+  if (resume_state_ != nullptr && params_.memoization) {
+    CHECK(sample_cache_->Load(resume_state_->sample_cache))
+        << "malformed sample cache in checkpoint";
+  }
+}
+
+template <typename T>
+void SamplingVerifier::ResumeTopLevelTest(SequentialTester<T>* tester) {
+  if (resume_state_ == nullptr && checkpointer_ == nullptr) {
+    return;
+  }
+  const size_t index = checkpoint_state_.test_samples.size();
+  checkpoint_state_.test_samples.emplace_back();
+  if (resume_state_ != nullptr &&
+      index < resume_state_->test_samples.size()) {
+    std::istringstream in(resume_state_->test_samples[index]);
+    Sample<T> sample;
+    CHECK(sample.Load(&in)) << "malformed test sample in checkpoint";
+    tester->SetSample(sample);
+  }
+}
+
+template <typename T>
+void SamplingVerifier::CheckpointTopLevelTest(
+    const SequentialTester<T>& tester, bool save) {
+  if (checkpointer_ == nullptr) {
+    return;
+  }
+  std::ostringstream out;
+  tester.sample().Save(&out);
+  std::string sample = out.str();
+  sample.pop_back();
+  checkpoint_state_.test_samples.back() = std::move(sample);
+  if (save) {
+    checkpoint_state_.sample_cache.clear();
+    if (params_.memoization) {
+      sample_cache_->Save(&checkpoint_state_.sample_cache);
+    }
+    checkpointer_->Save(checkpoint_state_);
+  }
+}
+
+template <typename T>
+void SamplingVerifier::ReportTopLevelTest(const SequentialTester<T>& tester,
+                                          double alpha, const Timer<>& timer,
+                                          const std::atomic<int64_t>* busy_time,
+                                          bool done) {
+  if (progress_ == nullptr) {
+    return;
+  }
+  VerifyProgress progress;
+  progress.observation_count = tester.sample().count();
+  progress.estimate = tester.Estimate();
+  std::tie(progress.lower_bound, progress.upper_bound) =
+      AnytimeConfidenceInterval(progress.observation_count, progress.estimate,
+                                alpha);
+  progress.log_likelihood_ratio = tester.LogLikelihoodRatio();
+  progress.elapsed_seconds = timer.GetElapsedSeconds();
+  if (busy_time != nullptr) {
+    for (int i = 0; i < thread_pool_->size(); ++i) {
+      const double busy_seconds =
+          1e-9 * busy_time[i].load(std::memory_order_relaxed);
+      progress.thread_utilization.push_back(
+          (progress.elapsed_seconds > 0)
+              ? std::min(1.0, busy_seconds / progress.elapsed_seconds)
+              : 0.0);
+    }
+  }
+  progress.done = done;
+  progress_->Report(progress);
+}
+
+std::vector<SamplingPlan> SamplingVerifier::Plan(
+    const CompiledProperty& property, int pilot_path_count) {
+  CHECK_GT(pilot_path_count, 0);
+  std::vector<SamplingPlan> plans;
+  plans_ = &plans;
+  pilot_path_count_ = pilot_path_count;
+  property.Accept(this);
+  plans_ = nullptr;
+  return plans;
+}
+
+template <typename Algorithm>
+void SamplingVerifier::PlanProbabilisticProperty(
+    Algorithm algorithm, double theta0, double theta1,
+    const CompiledPathProperty& path_property,
+    const ModelCheckingParams& nested_params) {
+  ModelCheckingParams params = nested_params;
+  std::swap(params_, params);
+  Sample<double> pilot;
+  Sample<int> path_length;
+  Timer<> timer;
+  for (int i = 0; i < pilot_path_count_; ++i) {
+    path_property.Accept(this);
+    pilot.AddObservation(ObservationWeight(path_property, result_));
+    path_length.AddObservation(result_.path_length);
+  }
+  const double seconds = timer.GetElapsedSeconds();
+  std::swap(params_, params);
+  plans_->push_back(
+      {&path_property,
+       ExpectedSampleSize(algorithm, theta0, theta1, params_, pilot),
+       path_length.mean(), seconds / std::max(1, path_length.sum())});
+}
+
+std::vector<double> SamplingVerifier::OperandErrors(
+    double error, const CompiledNaryProperty& property) const {
+  const size_t n = property.other_operands().size();
+  if (!params_.optimize_errors) {
+    return std::vector<double>(n, error / n);
+  }
+  std::vector<double> costs;
+  costs.reserve(n);
+  OperandCostEstimator estimator(params_);
+  for (const CompiledProperty& operand : property.other_operands()) {
+    costs.push_back(estimator.Estimate(operand));
+  }
+  return AllocateError(error, costs);
+}
+
+template <typename T>
+void SamplingVerifier::SetTargetDepth(const SequentialTester<T>& tester,
+                                      int group_size,
+                                      ResultReorderBuffer* results) const {
+  const int64_t remaining_groups =
+      (int64_t{tester.EstimatedRemainingObservations()} + group_size - 1) /
+      group_size;
+  results->SetTargetDepth(std::max<int64_t>(
+      kMinTargetDepthPerThread * thread_pool_->size(), remaining_groups));
+}
+
+void SamplingVerifier::AddPathStats(const PathOutcome& outcome,
+                                    ModelCheckingStats* stats) {
+  stats->path_length.AddObservation(outcome.path_length);
+  if (outcome.value) {
+    stats->path_length_accept.AddObservation(outcome.path_length);
+  } else if (outcome.early_termination) {
+    stats->path_length_terminate.AddObservation(outcome.path_length);
+  } else {
+    stats->path_length_reject.AddObservation(outcome.path_length);
+  }
+}
+
+void SamplingVerifier::AddPathStats(const Result& result,
+                                    ModelCheckingStats* stats) {
+  AddPathStats(
+      PathOutcome{result.path_length, result.early_termination, result.value},
+      stats);
+}
+
+void SamplingVerifier::PathStatsShard::Add(int64_t sequence,
+                                           const PathOutcome& outcome) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_.emplace_back(sequence, outcome);
+}
+
+void SamplingVerifier::PathStatsShard::Commit(int64_t consumed_count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CommitLocked(consumed_count);
+}
+
+void SamplingVerifier::PathStatsShard::MoveCommittedTo(
+    int64_t consumed_count, ModelCheckingStats* stats) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CommitLocked(consumed_count);
+  stats->MergeFrom(stats_);
+  stats_ = ModelCheckingStats(stats_.path_length.populate_distribution());
+}
+
+void SamplingVerifier::PathStatsShard::CommitLocked(int64_t consumed_count) {
+  while (!pending_.empty() && pending_.front().first < consumed_count) {
+    AddPathStats(pending_.front().second, &stats_);
+    pending_.pop_front();
+  }
+}
+
+template <typename Algorithm>
+std::unique_ptr<SequentialTester<typename ResultType<Algorithm>::type>>
+SamplingVerifier::VerifyProbabilisticProperty(
     Algorithm algorithm, const double theta,
     const CompiledPathProperty& path_property) {
   ++probabilistic_level_;
@@ -334,6 +1357,9 @@ SamplingVerifier::VerifyProbabilisticProperty(
     if (params_.nested_error > 0) {
       // User-specified nested error.
       nested_error = params_.nested_error;
+    } else if (params_.optimize_errors) {
+      nested_error = OptimalNestedError(theta, params_.delta, params_.alpha,
+                                        params_.beta);
     } else {
       // Simple heuristic for nested error.
       nested_error = 0.8 * MaxNestedError(params_.delta);
@@ -344,70 +1370,180 @@ SamplingVerifier::VerifyProbabilisticProperty(
               << MaxNestedError(params_.delta);
     }
   }
-  const double theta0 =
-      std::min(1.0, (theta + params_.delta) * (1.0 - nested_error));
-  const double theta1 = std::max(
-      0.0, 1.0 - (1.0 - (theta - params_.delta)) * (1.0 - nested_error));
+  const auto region =
+      NestedIndifferenceRegion(theta, params_.delta, nested_error);
+  const double theta0 = region.first;
+  const double theta1 = region.second;
   ModelCheckingParams nested_params = params_;
   nested_params.alpha = nested_error;
   nested_params.beta = nested_error;
 
   auto tester = NewSequentialTester(algorithm, theta0, theta1);
+  if (plans_ != nullptr && probabilistic_level_ == 1) {
+    PlanProbabilisticProperty(algorithm, theta0, theta1, path_property,
+                              nested_params);
+    --probabilistic_level_;
+    return tester;
+  }
   if (probabilistic_level_ == 1) {
-    std::cout << "Acceptance sampling";
+    *out_ << "Acceptance sampling";
   }
   if (params_.memoization) {
-    auto& sample_cache = sample_cache_[path_property.index()];
-    auto ci = sample_cache.find(state_->values());
-    if (ci != sample_cache.end()) {
-      tester->SetSample(ci->second);
+    auto sample = sample_cache_->Find(path_property.index(), state_->values());
+    if (sample.has_value()) {
+      tester->SetSample(sample.value());
     }
   }
-  std::vector<ResultQueue> result_queues;
+  if (probabilistic_level_ == 1) {
+    ResumeTopLevelTest(tester.get());
+  }
+  const double alpha = params_.alpha;
+  const Timer<> timer;
+  std::unique_ptr<std::atomic<int64_t>[]> busy_time;
+  std::unique_ptr<ResultReorderBuffer> results;
   std::vector<SamplingVerifier> verifiers;
-  std::vector<std::thread> workers;
-  std::queue<int> schedule;
-  if (result_queue_ == nullptr && evaluators_->size() > 1) {
-    result_queues = std::vector<ResultQueue>(evaluators_->size());
-    verifiers.reserve(evaluators_->size());
-    for (size_t i = 0; i < evaluators_->size(); ++i) {
-      verifiers.emplace_back(model_, dd_model_, dd_cache_, nullptr,
-                             nested_params, state_, evaluators_, samplers_,
-                             simulators_, i, &result_queues[i]);
-      workers.emplace_back([&path_property, &result_queues, &verifiers, i]() {
-        while (result_queues[i].Enabled()) {
-          path_property.Accept(&verifiers[i]);
-          result_queues[i].Push(verifiers[i].result_);
+  std::vector<std::unique_ptr<PathStatsShard>> stats_shards;
+  CancellationToken cancellation;
+  std::unique_ptr<NestedTask> nested_task;
+  int nested_index = 0;
+  // In batch mode, the pool threads verify the nested checks of each batch
+  // instead of sampling top-level paths (see SampleNestedBatch).
+  const bool batch_nested_checks =
+      params_.nested_batch_size > 0 && probabilistic_level_ == 1 &&
+      thread_index_ < 0 && dd_model_ == nullptr &&
+      path_property.is_probabilistic();
+  std::vector<Result> batch;
+  size_t batch_index = 0;
+  int group_size = 1;
+  if (thread_pool_->size() > 1 && !batch_nested_checks) {
+    if (thread_index_ < 0) {
+      group_size = std::max(1, params_.group_size);
+      results.reset(new ResultReorderBuffer(thread_pool_->size()));
+      SetTargetDepth(*tester, group_size, results.get());
+      verifiers.reserve(thread_pool_->size());
+      for (int i = 0; i < thread_pool_->size(); ++i) {
+        verifiers.emplace_back(model_, dd_model_, dd_cache_, sample_cache_,
+                               nested_tasks_, nullptr, nested_params, state_,
+                               thread_pool_, i, probabilistic_level_);
+        verifiers.back().cancellation_ = &cancellation;
+      }
+      if (probabilistic_level_ == 1) {
+        stats_shards.reserve(thread_pool_->size());
+        for (int i = 0; i < thread_pool_->size(); ++i) {
+          stats_shards.emplace_back(
+              new PathStatsShard(stats_->path_length.populate_distribution()));
+        }
+        if (progress_ != nullptr) {
+          busy_time.reset(new std::atomic<int64_t>[thread_pool_->size()]());
+        }
+      }
+      thread_pool_->Start([&path_property, &results, &verifiers, &stats_shards,
+                           &busy_time, group_size](int i) {
+        SamplingVerifier& verifier = verifiers[i];
+        PathStatsShard* shard =
+            stats_shards.empty() ? nullptr : stats_shards[i].get();
+        Backoff backoff;
+        while (results->Enabled()) {
+          if (verifier.HelpWithNestedTask()) {
+            backoff.Reset();
+          } else {
+            const int64_t sequence = results->TryClaim(i);
+            if (sequence < 0) {
+              // The coordinator has enough results in flight; make sure it
+              // can see ours, and check for nested tasks again before backing
+              // off.
+              results->Flush(i);
+              backoff.Wait();
+              continue;
+            }
+            backoff.Reset();
+            if (shard != nullptr) {
+              shard->Commit(results->consumed_count());
+            }
+            const auto start = (busy_time != nullptr)
+                                   ? std::chrono::steady_clock::now()
+                                   : std::chrono::steady_clock::time_point();
+            std::optional<Sample<double>> group;
+            if (group_size > 1) {
+              group.emplace();
+            }
+            for (int j = 0; j < group_size && !verifier.Cancelled(); ++j) {
+              path_property.Accept(&verifier);
+              if (group.has_value()) {
+                group->AddObservation(verifier.ObservationWeight(
+                    path_property, verifier.result_));
+              }
+              if (shard != nullptr && !verifier.Cancelled()) {
+                shard->Add(sequence, {verifier.result_.path_length,
+                                      verifier.result_.early_termination,
+                                      verifier.result_.value});
+              }
+            }
+            if (busy_time != nullptr) {
+              busy_time[i].fetch_add(
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count(),
+                  std::memory_order_relaxed);
+            }
+            if (verifier.Cancelled()) {
+              break;
+            }
+            verifier.result_.group = std::move(group);
+            results->Put(sequence, i, std::move(verifier.result_));
+          }
         }
       });
-      schedule.push(i);
+    } else {
+      nested_task.reset(new NestedTask(&path_property, state_, nested_params,
+                                       probabilistic_level_, cancellation_));
+      std::lock_guard<std::mutex> lock(nested_tasks_->mutex);
+      nested_tasks_->tasks.push_back(nested_task.get());
     }
   }
   std::swap(params_, nested_params);
   while (!tester->done()) {
-    if (result_queues.empty()) {
+    if (nested_task != nullptr) {
+      NextNestedTaskResult(nested_task.get(), nested_index++);
+    } else if (batch_nested_checks) {
+      if (batch_index == batch.size()) {
+        SampleNestedBatch(path_property, &batch);
+        batch_index = 0;
+      }
+      result_ = batch[batch_index++];
+    } else if (results == nullptr) {
       path_property.Accept(this);
     } else {
-      int i = schedule.front();
-      schedule.pop();
-      result_ = result_queues[i].Pop();
-      schedule.push(i);
+      result_ = results->Take();
+    }
+    if (Cancelled()) {
+      break;
+    }
+    const int previous_count = tester->sample().count();
+    if (group_size > 1) {
+      tester->AddObservations(*result_.group);
+    } else {
+      tester->AddObservation(ObservationWeight(path_property, result_));
     }
-    double observation_weight = 1;
-    if (dd_model_ == nullptr && path_property.is_unbounded()) {
-      observation_weight =
-          pow(1 - params_.termination_probability, -(result_.path_length - 1));
+    if (results != nullptr) {
+      SetTargetDepth(*tester, group_size, results.get());
     }
-    tester->AddObservation(result_.value ? observation_weight : 0);
     if (probabilistic_level_ == 1) {
-      PrintProgress(tester->sample().count());
-      stats_->path_length.AddObservation(result_.path_length);
-      if (result_.value) {
-        stats_->path_length_accept.AddObservation(result_.path_length);
-      } else if (result_.early_termination) {
-        stats_->path_length_terminate.AddObservation(result_.path_length);
-      } else {
-        stats_->path_length_reject.AddObservation(result_.path_length);
+      for (int n = previous_count + 1; n <= tester->sample().count(); ++n) {
+        PrintProgress(n, out_);
+      }
+      if (results == nullptr) {
+        AddPathStats(result_, stats_);
+      }
+      if (checkpointer_ != nullptr && batch_index == batch.size() &&
+          checkpointer_->Due()) {
+        for (const auto& shard : stats_shards) {
+          shard->MoveCommittedTo(results->consumed_count(), stats_);
+        }
+        CheckpointTopLevelTest(*tester, true);
+      }
+      if (progress_ != nullptr && progress_->Due()) {
+        ReportTopLevelTest(*tester, alpha, timer, busy_time.get(), false);
       }
     }
     if (VLOG_IS_ON(2)) {
@@ -417,24 +1553,43 @@ SamplingVerifier::VerifyProbabilisticProperty(
   }
   std::swap(params_, nested_params);
   if (probabilistic_level_ == 1) {
-    std::cout << tester->sample().count() << " observations." << std::endl;
+    *out_ << tester->sample().count() << " observations." << std::endl;
     stats_->sample_size.AddObservation(tester->sample().count());
+    CheckpointTopLevelTest(*tester, false);
+    ReportTopLevelTest(*tester, alpha, timer, busy_time.get(), true);
   }
-  if (!result_queues.empty()) {
-    for (size_t i = 0; i < result_queues.size(); ++i) {
-      result_queues[i].Disable();
-      workers[i].join();
-      std::cout << "Used " << result_queues[i].pop_count() << " of "
-                << result_queues[i].push_count() << " observations from thread "
-                << i + 1 << "." << std::endl;
+  if (results != nullptr) {
+    cancellation.Cancel();
+    results->Disable();
+    thread_pool_->Wait();
+    for (int i = 0; i < thread_pool_->size(); ++i) {
+      *out_ << "Used " << results->pop_count(i) << " of "
+            << results->push_count(i) << " observations from thread " << i + 1
+            << "." << std::endl;
+    }
+    stats_->wasted_paths.AddObservation(results->wasted_count());
+    // Only the results that the test consumed count towards path statistics.
+    for (const auto& shard : stats_shards) {
+      shard->MoveCommittedTo(results->consumed_count(), stats_);
     }
   }
-  if (params_.memoization) {
-    sample_cache_[path_property.index()][state_->values()] = tester->sample();
+  if (nested_task != nullptr) {
+    std::unique_lock<std::mutex> lock(nested_tasks_->mutex);
+    auto& tasks = nested_tasks_->tasks;
+    tasks.erase(std::find(tasks.begin(), tasks.end(), nested_task.get()));
+    lock.unlock();
+    Backoff backoff;
+    while (nested_task->helper_count.load(std::memory_order_acquire) > 0) {
+      backoff.Wait();
+    }
+  }
+  if (params_.memoization && !Cancelled()) {
+    sample_cache_->Insert(path_property.index(), state_->values(),
+                          tester->sample());
   }
   result_.value = tester->accept();
   --probabilistic_level_;
-  return std::move(tester);
+  return tester;
 }
 
 template <>
@@ -455,6 +1610,15 @@ std::unique_ptr<SequentialTester<bool>> SamplingVerifier::NewSequentialTester(
     case ThresholdAlgorithm::CHOW_ROBBINS:
       return std::unique_ptr<SequentialTester<bool>>(
           new ChowRobbinsTester<bool>(theta0, theta1, params_.alpha));
+    case ThresholdAlgorithm::BAYES_FACTOR:
+      return std::unique_ptr<SequentialTester<bool>>(
+          new BayesFactorBernoulliTester(theta0, theta1, params_.alpha,
+                                         params_.beta, params_.prior_a,
+                                         params_.prior_b));
+    case ThresholdAlgorithm::BAYESIAN_INTERVAL:
+      return std::unique_ptr<SequentialTester<bool>>(
+          new BayesianIntervalTester<bool>(theta0, theta1, params_.alpha,
+                                           params_.prior_a, params_.prior_b));
   }
   LOG(FATAL) << "bad threshold algorithm";
 }
@@ -470,6 +1634,11 @@ std::unique_ptr<SequentialTester<double>> SamplingVerifier::NewSequentialTester(
     case EstimationAlgorithm::CHOW_ROBBINS:
       return std::unique_ptr<SequentialTester<double>>(
           new ChowRobbinsTester<double>(theta0, theta1, params_.alpha));
+    case EstimationAlgorithm::BAYESIAN_INTERVAL:
+      return std::unique_ptr<SequentialTester<double>>(
+          new BayesianIntervalTester<double>(theta0, theta1, params_.alpha,
+                                             params_.prior_a,
+                                             params_.prior_b));
   }
   LOG(FATAL) << "bad estimation algorithm";
 }
@@ -480,13 +1649,6 @@ void SamplingVerifier::DoVisitCompiledExpressionProperty(
       evaluator_->EvaluateIntExpression(property.expr(), state_->values());
 }
 
-class StateLess {
- public:
-  bool operator()(const State& lhs, const State& rhs) const {
-    return lhs.values() < rhs.values();
-  }
-};
-
 void SamplingVerifier::DoVisitCompiledUntilProperty(
     const CompiledUntilProperty& path_property) {
   std::optional<BDD> dd1;
@@ -506,9 +1668,9 @@ void SamplingVerifier::DoVisitCompiledUntilProperty(
       feasible = i->second.feasible;
     } else {
       dd1 = Verify(path_property.pre_property(), *dd_model_, false,
-                   params_.epsilon);
+                   params_.epsilon, 1, 0);
       dd2 = Verify(path_property.post_property(), *dd_model_, false,
-                   params_.epsilon);
+                   params_.epsilon, 1, 0);
       if (path_property.is_unbounded()) {
         feasible = VerifyExistsUntil(*dd_model_, dd1.value(), dd2.value());
         if (feasible.value().is_same(dd_model_->reachable_states())) {
@@ -539,6 +1701,11 @@ void SamplingVerifier::DoVisitCompiledUntilProperty(
       path_property.post_property().is_probabilistic() ? &post_states_inserter
                                                        : nullptr;
   while (!done && path_length < params_.max_path_length) {
+    if (path_length % kCancellationCheckInterval == 0 && Cancelled()) {
+      result_.value = false;
+      early_termination = true;
+      break;
+    }
     if (VLOG_IS_ON(3) && probabilistic_level_ == 1) {
       LOG(INFO) << "t = " << t << ": " << StateToString(curr_state);
     }
@@ -593,94 +1760,284 @@ void SamplingVerifier::DoVisitCompiledUntilProperty(
   }
   if (!early_termination &&
       (!unique_pre_states.empty() || !post_states.empty())) {
-    if (path_property.pre_property().is_probabilistic()) {
-      if (path_property.post_property().is_probabilistic()) {
-        // For each post state, verify post_property in that state, and verify
-        // pre_property in unique_pre_states and all prior post states, treating
-        // each verification as a conjunct.  Each such verification is treated
-        // as a disjunct.
-        if (!post_states.empty()) {
-          double beta = params_.beta / post_states.size();
-          std::swap(params_.beta, beta);
-          for (size_t i = 0; i < post_states.size(); ++i) {
-            result_.value = true;
-            double alpha = params_.alpha / (unique_pre_states.size() + i + 1);
-            std::swap(params_.alpha, alpha);
-            for (const State& state : unique_pre_states) {
-              const State* curr_state_ptr = &state;
-              std::swap(state_, curr_state_ptr);
-              path_property.pre_property().Accept(this);
-              std::swap(state_, curr_state_ptr);
-              if (result_.value == false) {
-                break;
-              }
-            }
-            for (size_t j = 0; result_.value == true && j < i; ++j) {
-              const State* curr_state_ptr = &post_states[j];
-              std::swap(state_, curr_state_ptr);
-              path_property.pre_property().Accept(this);
-              std::swap(state_, curr_state_ptr);
-            }
-            if (result_.value == true) {
-              const State* curr_state_ptr = &post_states[i];
-              std::swap(state_, curr_state_ptr);
-              path_property.post_property().Accept(this);
-              std::swap(state_, curr_state_ptr);
-            }
-            std::swap(params_.alpha, alpha);
-            if (result_.value == true) {
+    if (deferred_paths_ != nullptr) {
+      deferred_paths_->push_back({&path_property, params_.alpha, params_.beta,
+                                  std::move(unique_pre_states),
+                                  std::move(post_states), -1});
+    } else {
+      VerifyNestedStates(path_property, unique_pre_states, post_states);
+    }
+  }
+  if (VLOG_IS_ON(3) && probabilistic_level_ == 1) {
+    LOG(INFO) << "t = " << t << ": " << StateToString(curr_state);
+    if (result_.value) {
+      LOG(INFO) << ">>positive sample";
+    } else {
+      LOG(INFO) << ">>negative sample";
+    }
+  }
+  result_.path_length = path_length;
+  result_.early_termination = early_termination;
+  result_.first_passage_time =
+      result_.value ? t : std::numeric_limits<double>::infinity();
+}
+
+void SamplingVerifier::VerifyNestedStates(
+    const CompiledUntilProperty& path_property,
+    const std::set<State, StateLess>& unique_pre_states,
+    const std::vector<State>& post_states) {
+  if (path_property.pre_property().is_probabilistic()) {
+    if (path_property.post_property().is_probabilistic()) {
+      // For each post state, verify post_property in that state, and verify
+      // pre_property in unique_pre_states and all prior post states, treating
+      // each verification as a conjunct.  Each such verification is treated
+      // as a disjunct.
+      if (!post_states.empty()) {
+        double beta = params_.beta / post_states.size();
+        std::swap(params_.beta, beta);
+        for (size_t i = 0; i < post_states.size(); ++i) {
+          result_.value = true;
+          double alpha = params_.alpha / (unique_pre_states.size() + i + 1);
+          std::swap(params_.alpha, alpha);
+          for (const State& state : unique_pre_states) {
+            VerifyInState(path_property.pre_property(), state);
+            if (result_.value == false) {
               break;
             }
           }
-          std::swap(params_.beta, beta);
-        }
-      } else {
-        // Just verify pre_property in unique_pre_states, treating each
-        // verification as a conjunct.
-        result_.value = true;
-        double alpha = params_.alpha / unique_pre_states.size();
-        std::swap(params_.alpha, alpha);
-        for (const State& state : unique_pre_states) {
-          const State* curr_state_ptr = &state;
-          std::swap(state_, curr_state_ptr);
-          path_property.pre_property().Accept(this);
-          std::swap(state_, curr_state_ptr);
-          if (result_.value == false) {
+          for (size_t j = 0; result_.value == true && j < i; ++j) {
+            VerifyInState(path_property.pre_property(), post_states[j]);
+          }
+          if (result_.value == true) {
+            VerifyInState(path_property.post_property(), post_states[i]);
+          }
+          std::swap(params_.alpha, alpha);
+          if (result_.value == true) {
             break;
           }
         }
-        std::swap(params_.alpha, alpha);
+        std::swap(params_.beta, beta);
       }
-    } else if (path_property.post_property().is_probabilistic()) {
-      // Just verify post_property in unique_post_states, treating each
-      // verification as a disjunct.
-      std::set<State, StateLess> unique_post_states(post_states.begin(),
-                                                    post_states.end());
-      result_.value = false;
-      double beta = params_.beta / unique_post_states.size();
-      std::swap(params_.beta, beta);
-      for (const State& state : unique_post_states) {
-        const State* curr_state_ptr = &state;
-        std::swap(state_, curr_state_ptr);
-        path_property.pre_property().Accept(this);
-        std::swap(state_, curr_state_ptr);
-        if (result_.value == true) {
+    } else {
+      // Just verify pre_property in unique_pre_states, treating each
+      // verification as a conjunct.
+      result_.value = true;
+      double alpha = params_.alpha / unique_pre_states.size();
+      std::swap(params_.alpha, alpha);
+      for (const State& state : unique_pre_states) {
+        VerifyInState(path_property.pre_property(), state);
+        if (result_.value == false) {
           break;
         }
       }
+      std::swap(params_.alpha, alpha);
+    }
+  } else if (path_property.post_property().is_probabilistic()) {
+    // Just verify post_property in unique_post_states, treating each
+    // verification as a disjunct.
+    std::set<State, StateLess> unique_post_states(post_states.begin(),
+                                                  post_states.end());
+    result_.value = false;
+    double beta = params_.beta / unique_post_states.size();
+    std::swap(params_.beta, beta);
+    for (const State& state : unique_post_states) {
+      VerifyInState(path_property.post_property(), state);
+      if (result_.value == true) {
+        break;
+      }
+    }
+    std::swap(params_.beta, beta);
+  }
+}
+
+namespace {
+
+// A distinct nested check in a batch of top-level paths.
+struct NestedCheck {
+  const CompiledProperty* property;
+  const State* state;
+  double alpha;
+  double beta;
+  bool result;
+};
+
+void AddNestedCheck(
+    const CompiledProperty& property, const State& state, double alpha,
+    double beta,
+    std::map<std::pair<const CompiledProperty*, std::vector<int>>, int>*
+        check_indices,
+    std::vector<NestedCheck>* checks) {
+  auto ci = check_indices->insert(
+      {{&property, state.values()}, static_cast<int>(checks->size())});
+  if (ci.second) {
+    checks->push_back({&property, &state, alpha, beta, false});
+  } else {
+    NestedCheck& check = (*checks)[ci.first->second];
+    check.alpha = std::min(check.alpha, alpha);
+    check.beta = std::min(check.beta, beta);
+  }
+}
+
+}  // namespace
+
+void SamplingVerifier::SampleNestedBatch(
+    const CompiledPathProperty& path_property, std::vector<Result>* results) {
+  std::vector<DeferredPath> deferred_paths;
+  results->clear();
+  deferred_paths_ = &deferred_paths;
+  for (int i = 0; i < params_.nested_batch_size; ++i) {
+    path_property.Accept(this);
+    if (!deferred_paths.empty() && deferred_paths.back().index < 0) {
+      deferred_paths.back().index = i;
+    }
+    results->push_back(result_);
+  }
+  deferred_paths_ = nullptr;
+
+  // Collect the distinct nested checks of the batch.  Each check uses the
+  // strictest error bounds that VerifyNestedStates would use for it on any of
+  // the paths.
+  std::map<std::pair<const CompiledProperty*, std::vector<int>>, int>
+      check_indices;
+  std::vector<NestedCheck> checks;
+  for (const DeferredPath& path : deferred_paths) {
+    const CompiledProperty& pre = path.path_property->pre_property();
+    const CompiledProperty& post = path.path_property->post_property();
+    const size_t pre_count = path.unique_pre_states.size();
+    const size_t post_count = path.post_states.size();
+    if (pre.is_probabilistic()) {
+      if (post.is_probabilistic()) {
+        if (post_count > 0) {
+          const double beta = path.beta / post_count;
+          const double min_alpha = path.alpha / (pre_count + post_count);
+          for (const State& state : path.unique_pre_states) {
+            AddNestedCheck(pre, state, min_alpha, beta, &check_indices,
+                           &checks);
+          }
+          for (size_t i = 0; i < post_count; ++i) {
+            if (i + 1 < post_count) {
+              AddNestedCheck(pre, path.post_states[i], min_alpha, beta,
+                             &check_indices, &checks);
+            }
+            AddNestedCheck(post, path.post_states[i],
+                           path.alpha / (pre_count + i + 1), beta,
+                           &check_indices, &checks);
+          }
+        }
+      } else {
+        for (const State& state : path.unique_pre_states) {
+          AddNestedCheck(pre, state, path.alpha / pre_count, path.beta,
+                         &check_indices, &checks);
+        }
+      }
+    } else if (post.is_probabilistic()) {
+      const std::set<State, StateLess> unique_post_states(
+          path.post_states.begin(), path.post_states.end());
+      // NOTE: checks refer to states owned by path, so we add the checks from
+      // post_states and let AddNestedCheck remove duplicates.
+      for (const State& state : path.post_states) {
+        AddNestedCheck(post, state, path.alpha,
+                       path.beta / unique_post_states.size(), &check_indices,
+                       &checks);
+      }
+    }
+  }
+  VLOG(1) << deferred_paths.size() << " of " << results->size()
+          << " paths with " << checks.size() << " distinct nested checks";
+
+  // Verify each distinct nested check once.
+  if (thread_pool_->size() > 1) {
+    std::vector<SamplingVerifier> helpers;
+    helpers.reserve(thread_pool_->size());
+    for (int i = 0; i < thread_pool_->size(); ++i) {
+      helpers.emplace_back(model_, dd_model_, dd_cache_, sample_cache_,
+                           nested_tasks_, nullptr, params_, state_,
+                           thread_pool_, i, probabilistic_level_);
+      helpers.back().cancellation_ = cancellation_;
+    }
+    std::atomic<size_t> next_check(0);
+    std::atomic<size_t> completed_count(0);
+    thread_pool_->Start(
+        [this, &checks, &helpers, &next_check, &completed_count](int i) {
+          Backoff backoff;
+          while (!Cancelled()) {
+            const size_t k = next_check.fetch_add(1, std::memory_order_relaxed);
+            if (k < checks.size()) {
+              NestedCheck& check = checks[k];
+              ModelCheckingParams params = params_;
+              params.alpha = check.alpha;
+              params.beta = check.beta;
+              SamplingVerifier verifier(
+                  model_, dd_model_, dd_cache_, sample_cache_, nested_tasks_,
+                  nullptr, params, check.state, thread_pool_, i,
+                  probabilistic_level_);
+              verifier.cancellation_ = cancellation_;
+              check.property->Accept(&verifier);
+              check.result = verifier.result_.value;
+              completed_count.fetch_add(1, std::memory_order_release);
+            } else if (completed_count.load(std::memory_order_acquire) ==
+                       checks.size()) {
+              break;
+            } else if (!helpers[i].HelpWithNestedTask()) {
+              backoff.Wait();
+            }
+          }
+        });
+    thread_pool_->Wait();
+  } else {
+    for (NestedCheck& check : checks) {
+      if (Cancelled()) {
+        break;
+      }
+      double alpha = check.alpha;
+      double beta = check.beta;
+      std::swap(params_.alpha, alpha);
       std::swap(params_.beta, beta);
+      VerifyInState(*check.property, *check.state);
+      check.result = result_.value;
+      std::swap(params_.beta, beta);
+      std::swap(params_.alpha, alpha);
     }
   }
-  if (VLOG_IS_ON(3) && probabilistic_level_ == 1) {
-    LOG(INFO) << "t = " << t << ": " << StateToString(curr_state);
-    if (result_.value) {
-      LOG(INFO) << ">>positive sample";
-    } else {
-      LOG(INFO) << ">>negative sample";
+  if (Cancelled()) {
+    // The results of the batch are discarded by the caller.
+    return;
+  }
+
+  // Resolve the deferred paths.
+  NestedResultMap nested_results;
+  for (const NestedCheck& check : checks) {
+    nested_results.insert(
+        {{check.property, check.state->values()}, check.result});
+  }
+  nested_results_ = &nested_results;
+  for (const DeferredPath& path : deferred_paths) {
+    double alpha = path.alpha;
+    double beta = path.beta;
+    std::swap(params_.alpha, alpha);
+    std::swap(params_.beta, beta);
+    VerifyNestedStates(*path.path_property, path.unique_pre_states,
+                       path.post_states);
+    std::swap(params_.beta, beta);
+    std::swap(params_.alpha, alpha);
+    (*results)[path.index].value = result_.value;
+  }
+  nested_results_ = nullptr;
+}
+
+void SamplingVerifier::VerifyInState(const CompiledProperty& property,
+                                     const State& state) {
+  if (nested_results_ != nullptr) {
+    auto ri = nested_results_->find({&property, state.values()});
+    if (ri != nested_results_->end()) {
+      result_.value = ri->second;
+      return;
     }
   }
-  result_.path_length = path_length;
-  result_.early_termination = early_termination;
+  const State* curr_state_ptr = &state;
+  std::swap(state_, curr_state_ptr);
+  property.Accept(this);
+  std::swap(state_, curr_state_ptr);
 }
 
 template <typename OutputIterator>
@@ -699,6 +2056,388 @@ bool SamplingVerifier::VerifyHelper(const CompiledProperty& property,
   return default_result;
 }
 
+SamplingVerifier::NestedTask::NestedTask(
+    const CompiledPathProperty* path_property, const State* state,
+    const ModelCheckingParams& params, int probabilistic_level,
+    const CancellationToken* cancellation)
+    : path_property(path_property),
+      state(state),
+      params(params),
+      probabilistic_level(probabilistic_level),
+      cancellation(cancellation),
+      next_index(0),
+      index_limit(0),
+      helper_count(0) {}
+
+int SamplingVerifier::NestedTask::Claim() {
+  int index = next_index.load(std::memory_order_relaxed);
+  do {
+    if (index >= index_limit.load(std::memory_order_relaxed)) {
+      return -1;
+    }
+  } while (!next_index.compare_exchange_weak(index, index + 1,
+                                             std::memory_order_relaxed));
+  return index;
+}
+
+bool SamplingVerifier::HelpWithNestedTask() {
+  NestedTask* task = nullptr;
+  std::unique_lock<std::mutex> lock(nested_tasks_->mutex);
+  for (NestedTask* t : nested_tasks_->tasks) {
+    if (t->next_index.load(std::memory_order_relaxed) <
+        t->index_limit.load(std::memory_order_relaxed)) {
+      task = t;
+      break;
+    }
+  }
+  if (task == nullptr) {
+    return false;
+  }
+  // The owner waits for helper_count to drop to zero after removing the task
+  // from the queue, so the task stays alive while we use it.
+  task->helper_count.fetch_add(1, std::memory_order_relaxed);
+  lock.unlock();
+  const int index = task->Claim();
+  if (index >= 0) {
+    SamplingVerifier helper(model_, dd_model_, dd_cache_, sample_cache_,
+                            nested_tasks_, nullptr, task->params, task->state,
+                            thread_pool_, thread_index_,
+                            task->probabilistic_level);
+    helper.cancellation_ = task->cancellation;
+    task->path_property->Accept(&helper);
+    std::lock_guard<std::mutex> result_lock(task->mutex);
+    task->results.insert({index, helper.result_});
+  }
+  task->helper_count.fetch_sub(1, std::memory_order_release);
+  return index >= 0;
+}
+
+void SamplingVerifier::NextNestedTaskResult(NestedTask* task, int index) {
+  // Allow helpers to run at most one path per pool thread ahead of the
+  // observations consumed so far.
+  task->index_limit.store(index + thread_pool_->size(),
+                          std::memory_order_relaxed);
+  Backoff backoff;
+  while (!Cancelled()) {
+    {
+      std::lock_guard<std::mutex> lock(task->mutex);
+      auto ri = task->results.find(index);
+      if (ri != task->results.end()) {
+        result_ = ri->second;
+        task->results.erase(ri);
+        return;
+      }
+    }
+    const int claimed_index = task->Claim();
+    if (claimed_index >= 0) {
+      task->path_property->Accept(this);
+      if (claimed_index == index) {
+        return;
+      }
+      std::lock_guard<std::mutex> lock(task->mutex);
+      task->results.insert({claimed_index, result_});
+    } else {
+      backoff.Wait();
+    }
+  }
+}
+
+namespace {
+
+// State of a single property being verified on shared sample paths.
+struct SharedPathTest {
+  const CompiledUntilProperty* path_property;
+  bool negated;
+  std::unique_ptr<SequentialTester<bool>> threshold_tester;
+  std::unique_ptr<SequentialTester<double>> estimation_tester;
+
+  bool done() const {
+    return (threshold_tester != nullptr) ? threshold_tester->done()
+                                         : estimation_tester->done();
+  }
+};
+
+template <typename T>
+void RemoveDoneTests(const std::vector<bool>& done, std::vector<T>* tests) {
+  size_t j = 0;
+  for (size_t i = 0; i < tests->size(); ++i) {
+    if (!done[i]) {
+      (*tests)[j++] = (*tests)[i];
+    }
+  }
+  tests->resize(j);
+}
+
+}  // namespace
+
+FirstPassageDistribution SamplingVerifier::SampleFirstPassageTimes(
+    const CompiledProperty& property) {
+  CHECK(dd_model_ == nullptr);
+  const SharedPathPropertyMatcher matcher(property);
+  CHECK(matcher.matches() && matcher.is_estimation());
+  const CompiledUntilProperty& path_property = *matcher.path_property();
+  FirstPassageDistribution distribution;
+  distribution.path_property = &path_property;
+  distribution.sample_size = DkwSampleSize(params_.alpha, params_.delta);
+  distribution.band_width =
+      DkwBandWidth(distribution.sample_size, params_.alpha);
+  ++probabilistic_level_;
+  // Each thread samples every thread_count-th path, so the result only
+  // depends on the number of threads.
+  const int thread_count = thread_pool_->size();
+  const int sample_size = distribution.sample_size;
+  std::vector<std::vector<double>> times(thread_count);
+  std::vector<PathOutcome> outcomes(sample_size);
+  auto sample_paths = [this, &path_property, &times, &outcomes, thread_count,
+                       sample_size](int i) {
+    SamplingVerifier verifier(model_, nullptr, nullptr, nullptr, nullptr,
+                              nullptr, params_, state_, thread_pool_, i,
+                              probabilistic_level_);
+    for (int j = i; j < sample_size; j += thread_count) {
+      path_property.Accept(&verifier);
+      outcomes[j] = {verifier.result_.path_length,
+                     verifier.result_.early_termination,
+                     verifier.result_.value};
+      if (verifier.result_.value) {
+        times[i].push_back(verifier.result_.first_passage_time);
+      }
+    }
+  };
+  if (thread_count > 1) {
+    thread_pool_->Start(sample_paths);
+    thread_pool_->Wait();
+  } else {
+    sample_paths(0);
+  }
+  for (int i = 0; i < thread_count; ++i) {
+    distribution.times.insert(distribution.times.end(), times[i].begin(),
+                              times[i].end());
+  }
+  // Record path statistics in path order, independent of the threads.
+  for (const PathOutcome& outcome : outcomes) {
+    AddPathStats(outcome, stats_);
+  }
+  std::sort(distribution.times.begin(), distribution.times.end());
+  stats_->sample_size.AddObservation(sample_size);
+  --probabilistic_level_;
+  return distribution;
+}
+
+std::vector<SharedPathResult> SamplingVerifier::VerifyOnSharedPaths(
+    const std::vector<const CompiledProperty*>& properties,
+    std::vector<ModelCheckingStats>* stats) {
+  CHECK(dd_model_ == nullptr);
+  CHECK_EQ(properties.size(), stats->size());
+  Timer<> timer;
+  std::vector<SharedPathTest> tests(properties.size());
+  std::vector<SharedPathTest*> running_tests;
+  for (size_t i = 0; i < properties.size(); ++i) {
+    const SharedPathPropertyMatcher matcher(*properties[i]);
+    CHECK(matcher.matches());
+    SharedPathTest& test = tests[i];
+    test.path_property = matcher.path_property();
+    test.negated = matcher.negated();
+    ModelCheckingParams params = params_;
+    if (test.negated) {
+      std::swap(params.alpha, params.beta);
+    }
+    std::swap(params_, params);
+    const double theta = matcher.threshold();
+    const double theta0 = std::min(1.0, theta + params_.delta);
+    const double theta1 = std::max(0.0, theta - params_.delta);
+    if (matcher.is_estimation() || test.path_property->is_unbounded()) {
+      test.estimation_tester =
+          NewSequentialTester(params_.estimation_algorithm, theta0, theta1);
+    } else {
+      test.threshold_tester =
+          NewSequentialTester(params_.threshold_algorithm, theta0, theta1);
+    }
+    std::swap(params_, params);
+    running_tests.push_back(&test);
+  }
+  // Each round, every thread samples a fixed number of paths for the running
+  // tests, and the tests consume the paths in thread order.  The observations
+  // of each test therefore only depend on the number of threads.
+  const int thread_count = thread_pool_->size();
+  const int paths_per_thread = (thread_count > 1) ? kSharedPathsPerThread : 1;
+  std::vector<SamplingVerifier> verifiers;
+  verifiers.reserve(thread_count);
+  for (int i = 0; i < thread_count; ++i) {
+    verifiers.emplace_back(model_, nullptr, nullptr, nullptr, nullptr, nullptr,
+                           params_, state_, thread_pool_, i,
+                           probabilistic_level_);
+  }
+  // Outcomes indexed by thread, path, and running test.
+  std::vector<std::vector<std::vector<PathOutcome>>> outcomes(
+      thread_count, std::vector<std::vector<PathOutcome>>(paths_per_thread));
+  std::vector<const CompiledUntilProperty*> path_properties;
+  std::vector<bool> done;
+  while (!running_tests.empty()) {
+    path_properties.clear();
+    for (const SharedPathTest* test : running_tests) {
+      path_properties.push_back(test->path_property);
+    }
+    auto sample_paths = [&verifiers, &path_properties, &outcomes](int i) {
+      for (std::vector<PathOutcome>& path_outcomes : outcomes[i]) {
+        verifiers[i].SampleSharedPath(path_properties, &path_outcomes);
+      }
+    };
+    if (thread_count > 1) {
+      thread_pool_->Start(sample_paths);
+      thread_pool_->Wait();
+    } else {
+      sample_paths(0);
+    }
+    // Feed the paths to each running test in order, ignoring paths that are
+    // left over once a test is done.
+    for (const auto& thread_outcomes : outcomes) {
+      for (const auto& path_outcomes : thread_outcomes) {
+        for (size_t i = 0; i < running_tests.size(); ++i) {
+          SharedPathTest* test = running_tests[i];
+          if (test->done()) {
+            continue;
+          }
+          const PathOutcome& outcome = path_outcomes[i];
+          ModelCheckingStats& test_stats = (*stats)[test - &tests[0]];
+          int sample_size;
+          if (test->threshold_tester != nullptr) {
+            test->threshold_tester->AddObservation(outcome.value);
+            sample_size = test->threshold_tester->sample().count();
+          } else {
+            double observation_weight = 1;
+            if (test->path_property->is_unbounded()) {
+              observation_weight = pow(1 - params_.termination_probability,
+                                       -(outcome.path_length - 1));
+            }
+            test->estimation_tester->AddObservation(
+                outcome.value ? observation_weight : 0);
+            sample_size = test->estimation_tester->sample().count();
+          }
+          AddPathStats(outcome, &test_stats);
+          if (test->done()) {
+            test_stats.sample_size.AddObservation(sample_size);
+            test_stats.time.AddObservation(timer.GetElapsedSeconds());
+          }
+        }
+      }
+    }
+    // Retire the tests that are done.
+    done.assign(running_tests.size(), false);
+    for (size_t i = 0; i < running_tests.size(); ++i) {
+      done[i] = running_tests[i]->done();
+    }
+    RemoveDoneTests(done, &running_tests);
+  }
+  std::vector<SharedPathResult> results;
+  results.reserve(tests.size());
+  for (const SharedPathTest& test : tests) {
+    SharedPathResult result;
+    result.path_property = test.path_property;
+    if (test.threshold_tester != nullptr) {
+      result.accept = test.threshold_tester->accept() != test.negated;
+      result.mean = test.threshold_tester->Estimate();
+      result.sample_size = test.threshold_tester->sample().count();
+    } else {
+      result.accept = test.estimation_tester->accept() != test.negated;
+      result.mean = test.estimation_tester->Estimate();
+      result.sample_size = test.estimation_tester->sample().count();
+    }
+    results.push_back(result);
+  }
+  return results;
+}
+
+void SamplingVerifier::SampleSharedPath(
+    const std::vector<const CompiledUntilProperty*>& path_properties,
+    std::vector<PathOutcome>* outcomes) {
+  outcomes->resize(path_properties.size());
+  // Indices of the path properties that have not been decided yet.
+  std::vector<size_t> pending;
+  for (size_t i = 0; i < path_properties.size(); ++i) {
+    (*outcomes)[i] = {0, false, false};
+    pending.push_back(i);
+  }
+  std::vector<bool> done;
+  State curr_state = *state_;
+  State next_state = *state_;
+  double t = 0.0;
+  int path_length = 1;
+  while (!pending.empty() && path_length < params_.max_path_length) {
+    done.assign(pending.size(), false);
+    bool has_unbounded = false;
+    for (size_t i : pending) {
+      has_unbounded = has_unbounded || path_properties[i]->is_unbounded();
+    }
+    if (has_unbounded &&
+        sampler_->StandardUniform() < params_.termination_probability) {
+      for (size_t j = 0; j < pending.size(); ++j) {
+        const size_t i = pending[j];
+        if (path_properties[i]->is_unbounded()) {
+          (*outcomes)[i].early_termination = true;
+          (*outcomes)[i].path_length = path_length;
+          done[j] = true;
+        }
+      }
+      RemoveDoneTests(done, &pending);
+      if (pending.empty()) {
+        break;
+      }
+      done.assign(pending.size(), false);
+    }
+    simulator_->NextState(curr_state, &next_state);
+    const double next_t = t + (next_state.time() - curr_state.time());
+    const State* curr_state_ptr = &curr_state;
+    std::swap(state_, curr_state_ptr);
+    for (size_t j = 0; j < pending.size(); ++j) {
+      const size_t i = pending[j];
+      const CompiledUntilProperty& path_property = *path_properties[i];
+      PathOutcome& outcome = (*outcomes)[i];
+      const double t_min = path_property.min_time();
+      if (t_min <= t) {
+        path_property.post_property().Accept(this);
+        if (result_.value) {
+          outcome.value = true;
+          done[j] = true;
+        } else {
+          path_property.pre_property().Accept(this);
+          done[j] = !result_.value;
+        }
+      } else {
+        path_property.pre_property().Accept(this);
+        if (!result_.value) {
+          done[j] = true;
+        } else if (t_min < next_t) {
+          path_property.post_property().Accept(this);
+          outcome.value = result_.value;
+          done[j] = result_.value;
+        }
+      }
+      if (done[j]) {
+        outcome.path_length = path_length;
+      }
+    }
+    std::swap(state_, curr_state_ptr);
+    RemoveDoneTests(done, &pending);
+    curr_state.swap(next_state);
+    t = next_t;
+    ++path_length;
+    done.assign(pending.size(), false);
+    for (size_t j = 0; j < pending.size(); ++j) {
+      const size_t i = pending[j];
+      if (path_properties[i]->max_time() < t ||
+          t == std::numeric_limits<double>::infinity()) {
+        (*outcomes)[i].path_length = path_length;
+        done[j] = true;
+      }
+    }
+    RemoveDoneTests(done, &pending);
+  }
+  for (size_t i : pending) {
+    // Maximum path length reached.
+    (*outcomes)[i].path_length = path_length;
+  }
+}
+
 std::string SamplingVerifier::StateToString(const State& state) const {
   std::string result;
   for (size_t i = 0; i < model_->variables().size(); ++i) {
@@ -710,42 +2449,251 @@ std::string SamplingVerifier::StateToString(const State& state) const {
   return result;
 }
 
-int SamplingVerifier::GetSampleCacheSize() const {
-  int sample_cache_size = 0;
-  for (const auto& cache : sample_cache_) {
-    sample_cache_size += cache.second.size();
+SamplingVerifier::ResultQueue::ResultQueue()
+    : tail_(0),
+      pending_tail_(0),
+      cached_head_(0),
+      push_count_(0),
+      head_(0),
+      cached_tail_(0),
+      consumer_waiting_(false),
+      entries_(new Entry[kCapacity]) {}
+
+bool SamplingVerifier::ResultQueue::HasSpace() {
+  if (pending_tail_ - cached_head_ == kCapacity) {
+    cached_head_ = head_.load(std::memory_order_acquire);
   }
-  return sample_cache_size;
+  return pending_tail_ - cached_head_ < kCapacity;
 }
 
-SamplingVerifier::ResultQueue::ResultQueue()
-    : push_count_(0), pop_count_(0), enabled_(true) {}
+void SamplingVerifier::ResultQueue::Push(Entry&& entry,
+                                         int64_t publish_before) {
+  push_count_ += entry.result.observation_count();
+  entries_[pending_tail_ % kCapacity] = std::move(entry);
+  ++pending_tail_;
+  const uint64_t tail = tail_.load(std::memory_order_relaxed);
+  if (pending_tail_ - tail >= kPublishBatchSize ||
+      entries_[tail % kCapacity].sequence < publish_before ||
+      consumer_waiting_.load(std::memory_order_relaxed)) {
+    Publish();
+  }
+}
 
-bool SamplingVerifier::ResultQueue::Enabled() const {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return enabled_;
+void SamplingVerifier::ResultQueue::Publish() {
+  if (tail_.load(std::memory_order_relaxed) != pending_tail_) {
+    tail_.store(pending_tail_, std::memory_order_release);
+  }
+}
+
+SamplingVerifier::ResultQueue::Entry* SamplingVerifier::ResultQueue::Front() {
+  const uint64_t head = head_.load(std::memory_order_relaxed);
+  if (head == cached_tail_) {
+    cached_tail_ = tail_.load(std::memory_order_acquire);
+    if (head == cached_tail_) {
+      return nullptr;
+    }
+  }
+  return &entries_[head % kCapacity];
+}
+
+SamplingVerifier::ResultReorderBuffer::ResultReorderBuffer(int thread_count)
+    : next_sequence_(0),
+      head_(0),
+      limit_(std::numeric_limits<int64_t>::max()),
+      enabled_(true),
+      window_(new Slot[kCapacity]),
+      pop_counts_(thread_count) {
+  queues_.reserve(thread_count);
+  for (int i = 0; i < thread_count; ++i) {
+    queues_.emplace_back(new ResultQueue());
+  }
+  for (int64_t i = 0; i < kCapacity; ++i) {
+    window_[i].sequence = -1;
+  }
+}
+
+int SamplingVerifier::ResultReorderBuffer::wasted_count() const {
+  int wasted_count = 0;
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    wasted_count += queues_[i]->push_count() - pop_counts_[i];
+  }
+  return wasted_count;
+}
+
+void SamplingVerifier::ResultReorderBuffer::SetTargetDepth(int64_t depth) {
+  limit_.store(
+      head_.load(std::memory_order_relaxed) + std::max<int64_t>(1, depth),
+      std::memory_order_release);
+}
+
+int64_t SamplingVerifier::ResultReorderBuffer::TryClaim(int thread_index) {
+  // Each claim leads to at most one push, so a claim that finds space in the
+  // queue guarantees that the push will not have to wait.
+  if (!queues_[thread_index]->HasSpace()) {
+    return -1;
+  }
+  int64_t sequence = next_sequence_.load(std::memory_order_relaxed);
+  do {
+    if (Full(sequence)) {
+      return -1;
+    }
+  } while (!next_sequence_.compare_exchange_weak(sequence, sequence + 1,
+                                                 std::memory_order_relaxed));
+  return sequence;
+}
+
+void SamplingVerifier::ResultReorderBuffer::Put(int64_t sequence,
+                                                int thread_index,
+                                                Result&& result) {
+  // Results that the coordinator will take within the next round of paths
+  // are published right away instead of waiting for a full batch.
+  queues_[thread_index]->Push(
+      {sequence, std::move(result)},
+      head_.load(std::memory_order_relaxed) +
+          static_cast<int64_t>(queues_.size()));
+}
+
+void SamplingVerifier::ResultReorderBuffer::Drain() {
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    ResultQueue* queue = queues_[i].get();
+    for (ResultQueue::Entry* entry = queue->Front(); entry != nullptr;
+         entry = queue->Front()) {
+      Slot& slot = window_[entry->sequence % kCapacity];
+      slot.sequence = entry->sequence;
+      slot.thread_index = i;
+      slot.result = std::move(entry->result);
+      queue->Pop();
+    }
+  }
+}
+
+SamplingVerifier::Result SamplingVerifier::ResultReorderBuffer::Take() {
+  const int64_t sequence = head_.load(std::memory_order_relaxed);
+  Slot& slot = window_[sequence % kCapacity];
+  if (slot.sequence != sequence) {
+    Drain();
+    if (slot.sequence != sequence) {
+      for (const auto& queue : queues_) {
+        queue->SetConsumerWaiting(true);
+      }
+      Backoff backoff;
+      do {
+        backoff.Wait();
+        Drain();
+      } while (slot.sequence != sequence);
+      for (const auto& queue : queues_) {
+        queue->SetConsumerWaiting(false);
+      }
+    }
+  }
+  Result result = std::move(slot.result);
+  slot.sequence = -1;
+  pop_counts_[slot.thread_index] += result.observation_count();
+  head_.store(sequence + 1, std::memory_order_release);
+  return result;
+}
+
+}  // namespace
+
+SamplingThreadPool::SamplingThreadPool(
+    const CompiledModel* model,
+    std::vector<CompiledExpressionEvaluator>* evaluators,
+    std::vector<CompiledDistributionSampler<std::mt19937_64>>* samplers)
+    : evaluators_(evaluators),
+      samplers_(samplers),
+      generation_(0),
+      running_count_(0),
+      shutdown_(false) {
+  CHECK(!evaluators->empty());
+  CHECK_EQ(evaluators->size(), samplers->size());
+  SetModel(model);
+  if (evaluators->size() > 1) {
+    threads_.reserve(evaluators->size());
+    for (size_t i = 0; i < evaluators->size(); ++i) {
+      threads_.emplace_back([this, i]() { Run(i); });
+    }
+  }
 }
 
-void SamplingVerifier::ResultQueue::Push(const Result& result) {
-  ++push_count_;
+SamplingThreadPool::~SamplingThreadPool() {
   std::unique_lock<std::mutex> lock(mutex_);
-  results_.push(result);
+  shutdown_ = true;
   lock.unlock();
-  cv_.notify_one();
+  start_cv_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void SamplingThreadPool::SetModel(const CompiledModel* model) {
+  // NextStateSampler binds its model at construction.
+  simulators_.clear();
+  simulators_.reserve(evaluators_->size());
+  for (size_t i = 0; i < evaluators_->size(); ++i) {
+    simulators_.emplace_back(model, &(*evaluators_)[i], &(*samplers_)[i]);
+  }
 }
 
-SamplingVerifier::Result SamplingVerifier::ResultQueue::Pop() {
-  ++pop_count_;
+void SamplingThreadPool::Start(std::function<void(int)> job) {
   std::unique_lock<std::mutex> lock(mutex_);
-  cv_.wait(lock, [this] { return !results_.empty(); });
-  Result result = results_.front();
-  results_.pop();
-  return result;
+  CHECK_EQ(running_count_, 0);
+  job_ = std::move(job);
+  running_count_ = threads_.size();
+  ++generation_;
+  lock.unlock();
+  start_cv_.notify_all();
 }
 
-void SamplingVerifier::ResultQueue::Disable() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  enabled_ = false;
+void SamplingThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this] { return running_count_ == 0; });
+}
+
+void SamplingThreadPool::Run(int thread_index) {
+  uint64_t generation = 0;
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    start_cv_.wait(lock, [this, generation] {
+      return shutdown_ || generation_ != generation;
+    });
+    if (shutdown_) {
+      return;
+    }
+    generation = generation_;
+    lock.unlock();
+    job_(thread_index);
+    lock.lock();
+    if (--running_count_ == 0) {
+      done_cv_.notify_all();
+    }
+  }
+}
+
+namespace {
+
+// Verifies property in the given state as Verify does, writing the progress
+// and results of top-level tests to out.
+bool VerifyToStream(const CompiledProperty& property,
+                    const CompiledModel& model,
+                    const DecisionDiagramModel* dd_model,
+                    const ModelCheckingParams& params, const State& state,
+                    SamplingThreadPool* thread_pool, ModelCheckingStats* stats,
+                    const VerifierState* resume_state,
+                    VerifyCheckpointer* checkpointer,
+                    VerifyProgressListener* progress, std::ostream* out) {
+  DdCache dd_cache;
+  SampleCache sample_cache(kSampleCacheMemoryLimit);
+  SamplingVerifier::NestedTaskQueue nested_tasks;
+  SamplingVerifier verifier(&model, dd_model, &dd_cache, &sample_cache,
+                            &nested_tasks, stats, params, &state, thread_pool);
+  verifier.SetCheckpointing(resume_state, checkpointer);
+  verifier.set_progress(progress);
+  verifier.set_out(out);
+  property.Accept(&verifier);
+  stats->sample_cache_size.AddObservation(sample_cache.size());
+  stats->sample_cache_hits.AddObservation(sample_cache.hit_count());
+  stats->sample_cache_misses.AddObservation(sample_cache.miss_count());
+  return verifier.result();
 }
 
 }  // namespace
@@ -753,18 +2701,111 @@ void SamplingVerifier::ResultQueue::Disable() {
 bool Verify(const CompiledProperty& property, const CompiledModel& model,
             const DecisionDiagramModel* dd_model,
             const ModelCheckingParams& params, const State& state,
-            std::vector<CompiledExpressionEvaluator>* evaluators,
-            std::vector<CompiledDistributionSampler<std::mt19937_64>>* samplers,
-            ModelCheckingStats* stats) {
-  DdCache dd_cache;
-  std::vector<NextStateSampler<std::mt19937_64>> simulators;
-  simulators.reserve(evaluators->size());
-  for (size_t i = 0; i < evaluators->size(); ++i) {
-    simulators.emplace_back(&model, &(*evaluators)[i], &(*samplers)[i]);
+            SamplingThreadPool* thread_pool, ModelCheckingStats* stats,
+            const VerifierState* resume_state, VerifyCheckpointer* checkpointer,
+            VerifyProgressListener* progress) {
+  return VerifyToStream(property, model, dd_model, params, state, thread_pool,
+                        stats, resume_state, checkpointer, progress,
+                        &std::cout);
+}
+
+void VerifyTrials(const CompiledProperty& property, const CompiledModel& model,
+                  const ModelCheckingParams& params, const State& state,
+                  SamplingThreadPool* thread_pool, size_t seed,
+                  int trial_count, bool populate_distribution,
+                  const std::function<void(const TrialResult&)>& done) {
+  std::vector<std::optional<TrialResult>> results(trial_count);
+  std::mutex mutex;
+  std::condition_variable ready_cv;
+  std::atomic<int> next_trial(0);
+  auto run_trials = [&](int i) {
+    // A pool of size 1 that samples on the thread running the trials.
+    std::vector<CompiledExpressionEvaluator> evaluators(
+        1, *thread_pool->evaluator(i));
+    std::mt19937_64 engine;
+    std::vector<CompiledDistributionSampler<std::mt19937_64>> samplers(
+        1, CompiledDistributionSampler<std::mt19937_64>(&engine));
+    SamplingThreadPool trial_pool(&model, &evaluators, &samplers);
+    for (int trial = next_trial.fetch_add(1, std::memory_order_relaxed);
+         trial < trial_count;
+         trial = next_trial.fetch_add(1, std::memory_order_relaxed)) {
+      std::seed_seq seed_generator{seed, static_cast<size_t>(trial)};
+      std::uint32_t trial_seed;
+      seed_generator.generate(&trial_seed, &trial_seed + 1);
+      engine.seed(trial_seed);
+      samplers[0] = CompiledDistributionSampler<std::mt19937_64>(&engine);
+      TrialResult result(populate_distribution);
+      std::ostringstream out;
+      Timer<> timer;
+      result.accept =
+          VerifyToStream(property, model, nullptr, params, state, &trial_pool,
+                         &result.stats, nullptr, nullptr, nullptr, &out);
+      result.stats.time.AddObservation(timer.GetElapsedSeconds());
+      result.output = out.str();
+      std::lock_guard<std::mutex> lock(mutex);
+      results[trial] = std::move(result);
+      ready_cv.notify_all();
+    }
+  };
+  if (thread_pool->size() == 1) {
+    run_trials(0);
+  } else {
+    thread_pool->Start(run_trials);
   }
-  SamplingVerifier verifier(&model, dd_model, &dd_cache, stats, params, &state,
-                            evaluators, samplers, &simulators);
-  property.Accept(&verifier);
-  stats->sample_cache_size.AddObservation(verifier.GetSampleCacheSize());
-  return verifier.result();
+  for (int trial = 0; trial < trial_count; ++trial) {
+    std::unique_lock<std::mutex> lock(mutex);
+    ready_cv.wait(lock,
+                  [&results, trial] { return results[trial].has_value(); });
+    const TrialResult result = std::move(results[trial].value());
+    results[trial].reset();
+    lock.unlock();
+    done(result);
+  }
+  if (thread_pool->size() > 1) {
+    thread_pool->Wait();
+  }
+}
+
+std::vector<SamplingPlan> PlanVerification(
+    const CompiledProperty& property, const CompiledModel& model,
+    const ModelCheckingParams& params, const State& state,
+    int pilot_path_count, SamplingThreadPool* thread_pool) {
+  DdCache dd_cache;
+  SampleCache sample_cache(kSampleCacheMemoryLimit);
+  SamplingVerifier::NestedTaskQueue nested_tasks;
+  ModelCheckingStats stats(false);
+  SamplingVerifier verifier(&model, nullptr, &dd_cache, &sample_cache,
+                            &nested_tasks, &stats, params, &state,
+                            thread_pool);
+  return verifier.Plan(property, pilot_path_count);
+}
+
+bool SupportsFirstPassageTimes(const CompiledProperty& property) {
+  const SharedPathPropertyMatcher matcher(property);
+  return matcher.matches() && matcher.is_estimation() && !matcher.negated() &&
+         !matcher.path_property()->is_unbounded() &&
+         matcher.path_property()->min_time() == 0;
+}
+
+FirstPassageDistribution EstimateFirstPassageTimes(
+    const CompiledProperty& property, const CompiledModel& model,
+    const ModelCheckingParams& params, const State& state,
+    SamplingThreadPool* thread_pool, ModelCheckingStats* stats) {
+  SamplingVerifier verifier(&model, nullptr, nullptr, nullptr, nullptr, stats,
+                            params, &state, thread_pool);
+  return verifier.SampleFirstPassageTimes(property);
+}
+
+bool SupportsSharedPaths(const CompiledProperty& property) {
+  return SharedPathPropertyMatcher(property).matches();
+}
+
+std::vector<SharedPathResult> VerifyOnSharedPaths(
+    const std::vector<const CompiledProperty*>& properties,
+    const CompiledModel& model, const ModelCheckingParams& params,
+    const State& state, SamplingThreadPool* thread_pool,
+    std::vector<ModelCheckingStats>* stats) {
+  SamplingVerifier verifier(&model, nullptr, nullptr, nullptr, nullptr,
+                            nullptr, params, &state, thread_pool);
+  return verifier.VerifyOnSharedPaths(properties, stats);
 }
@@ -24,7 +24,12 @@
 
 #include <cmath>
 #include <initializer_list>
+#include <istream>
+#include <limits>
+#include <ostream>
 #include <random>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include "glog/logging.h"
@@ -71,6 +76,13 @@ class CompiledDistributionSampler {
   double StandardUniform();
   double Exponential(double lambda);
 
+  // Writes the state of this sampler and its engine to out on a single line,
+  // in a form that LoadState reads back exactly.
+  void SaveState(std::ostream* out) const;
+  // Restores a state written by SaveState from the next line of in.  Returns
+  // false if the line is malformed.
+  bool LoadState(std::istream* in);
+
  private:
   std::uniform_real_distribution<> standard_uniform_;
   Engine* engine_;
@@ -128,4 +140,36 @@ double CompiledDistributionSampler<Engine>::Exponential(double lambda) {
   return -log(1.0 - StandardUniform()) / lambda;
 }
 
+template <typename Engine>
+void CompiledDistributionSampler<Engine>::SaveState(std::ostream* out) const {
+  const auto precision =
+      out->precision(std::numeric_limits<double>::max_digits10);
+  *out << *engine_ << ' ' << standard_uniform_ << ' ' << has_unused_lognormal_
+       << ' ' << (has_unused_lognormal_ ? unused_lognormal_ : 0.0) << '\n';
+  out->precision(precision);
+}
+
+template <typename Engine>
+bool CompiledDistributionSampler<Engine>::LoadState(std::istream* in) {
+  std::string line;
+  if (!std::getline(*in, line)) {
+    return false;
+  }
+  std::istringstream fields(line);
+  Engine engine;
+  std::uniform_real_distribution<> standard_uniform;
+  bool has_unused_lognormal;
+  double unused_lognormal;
+  if (!(fields >> engine >> standard_uniform >> has_unused_lognormal >>
+        unused_lognormal) ||
+      !(fields >> std::ws).eof()) {
+    return false;
+  }
+  *engine_ = engine;
+  standard_uniform_ = standard_uniform;
+  has_unused_lognormal_ = has_unused_lognormal;
+  unused_lognormal_ = unused_lognormal;
+  return true;
+}
+
 #endif  // COMPILED_DISTRIBUTION_H_
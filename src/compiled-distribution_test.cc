@@ -19,6 +19,10 @@
 
 #include "compiled-distribution.h"
 
+#include <random>
+#include <sstream>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 namespace {
@@ -44,4 +48,26 @@ TEST(CompiledDistributionTest, MakesUniform) {
   EXPECT_EQ(std::vector<double>({0.5, 2}), dist.parameters());
 }
 
+TEST(CompiledDistributionSamplerTest, SaveAndLoadState) {
+  const CompiledGsmpDistribution dist(
+      CompiledGsmpDistribution::MakeLognormal(17.0, 0.5));
+  const std::vector<int> state;
+  std::mt19937_64 engine(17);
+  CompiledDistributionSampler<std::mt19937_64> sampler(&engine);
+  sampler.Sample(dist, state);
+  std::stringstream buffer;
+  sampler.SaveState(&buffer);
+  const double x1 = sampler.Sample(dist, state);
+  const double x2 = sampler.Sample(dist, state);
+
+  std::mt19937_64 other_engine;
+  CompiledDistributionSampler<std::mt19937_64> other_sampler(&other_engine);
+  EXPECT_TRUE(other_sampler.LoadState(&buffer));
+  EXPECT_EQ(x1, other_sampler.Sample(dist, state));
+  EXPECT_EQ(x2, other_sampler.Sample(dist, state));
+
+  std::istringstream malformed("17 0 1\n");
+  EXPECT_FALSE(other_sampler.LoadState(&malformed));
+}
+
 }  // namespace
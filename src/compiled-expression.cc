@@ -20,7 +20,9 @@
 #include "compiled-expression.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <limits>
 #include <map>
 #include <ostream>
 #include <queue>
@@ -642,6 +644,82 @@ CompiledExpression CompiledExpression::WithAssignment(
   return CompiledExpression(operations, dd);
 }
 
+namespace {
+
+// The maximum domain size for which an expression is memoized.  Bounds the
+// mixed-radix index, which is used as cache key.
+constexpr uint64_t kMaxMemoDomainSize = uint64_t{1} << 40;
+
+// The number of entries in the per-evaluator direct-mapped cache for memoized
+// expressions.  Must be a power of two.
+constexpr size_t kMemoCacheSize = 1024;
+
+bool HasIntegerModulo(const CompiledExpression& expr) {
+  for (const Operation& o : expr.operations()) {
+    if (o.opcode() == Opcode::MOD) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+CompiledExpression CompiledExpression::WithMemoization(
+    const std::vector<VariableBounds>& variable_bounds,
+    size_t max_table_size) const {
+  // Expressions with at most two operations (constants and plain variable
+  // loads) are cheaper to evaluate than to look up.
+  if (operations_.size() <= 2) {
+    return *this;
+  }
+  const std::set<int> variables = GetExpressionVariables(*this);
+  if (variables.empty()) {
+    return *this;
+  }
+  static std::atomic<uint64_t> next_memo_id(1);
+  auto memo = std::make_shared<ExpressionMemo>();
+  memo->id = next_memo_id++;
+  uint64_t domain_size = 1;
+  for (auto i = variables.rbegin(); i != variables.rend(); ++i) {
+    if (*i >= static_cast<int>(variable_bounds.size())) {
+      return *this;
+    }
+    const VariableBounds& bounds = variable_bounds[*i];
+    memo->variables.insert(memo->variables.begin(), *i);
+    memo->min_values.insert(memo->min_values.begin(), bounds.min_value);
+    memo->max_values.insert(memo->max_values.begin(), bounds.max_value);
+    memo->strides.insert(memo->strides.begin(), domain_size);
+    domain_size *= bounds.max_value - bounds.min_value + 1;
+    if (domain_size > kMaxMemoDomainSize) {
+      return *this;
+    }
+  }
+  // Integer modulo can trap for assignments that are never evaluated in
+  // practice, so such expressions are only cached, never tabulated.
+  if (domain_size <= max_table_size && !HasIntegerModulo(*this)) {
+    const std::pair<int, int> reg_counts = GetExpressionRegisterCounts(*this);
+    CompiledExpressionEvaluator evaluator(reg_counts.first, reg_counts.second);
+    std::vector<int> state(variable_bounds.size());
+    for (size_t i = 0; i < variable_bounds.size(); ++i) {
+      state[i] = variable_bounds[i].min_value;
+    }
+    memo->table.reserve(domain_size);
+    for (uint64_t index = 0; index < domain_size; ++index) {
+      for (size_t i = 0; i < memo->variables.size(); ++i) {
+        state[memo->variables[i]] =
+            memo->min_values[i] +
+            (index / memo->strides[i]) %
+                (memo->max_values[i] - memo->min_values[i] + 1);
+      }
+      memo->table.push_back(evaluator.EvaluateDoubleExpression(*this, state));
+    }
+  }
+  CompiledExpression result(operations_, dd_);
+  result.memo_ = std::move(memo);
+  return result;
+}
+
 std::ostream& operator<<(std::ostream& os, const CompiledExpression& expr) {
   for (size_t pc = 0; pc < expr.operations().size(); ++pc) {
     if (pc > 0) {
@@ -730,6 +808,26 @@ std::pair<int, int> GetExpressionRegisterCounts(
   return {max_ireg + 1, max_dreg + 1};
 }
 
+std::set<int> GetExpressionVariables(const CompiledExpression& expr) {
+  std::set<int> variables;
+  for (const Operation& o : expr.operations()) {
+    switch (o.opcode()) {
+      case Opcode::ILOAD:
+      case Opcode::IVEQ:
+      case Opcode::IVNE:
+      case Opcode::IVLT:
+      case Opcode::IVLE:
+      case Opcode::IVGE:
+      case Opcode::IVGT:
+        variables.insert(o.ioperand1());
+        continue;
+      default:
+        continue;
+    }
+  }
+  return variables;
+}
+
 CompiledExpressionEvaluator::CompiledExpressionEvaluator(int ireg_count,
                                                          int dreg_count)
     : iregs_(ireg_count), dregs_(dreg_count) {}
@@ -742,10 +840,41 @@ int CompiledExpressionEvaluator::EvaluateIntExpression(
 
 double CompiledExpressionEvaluator::EvaluateDoubleExpression(
     const CompiledExpression& expr, const std::vector<int>& state) {
+  if (expr.memo() != nullptr) {
+    return EvaluateMemoizedDoubleExpression(expr, state);
+  }
   ExecuteOperations(expr.operations(), state);
   return dregs_[0];
 }
 
+double CompiledExpressionEvaluator::EvaluateMemoizedDoubleExpression(
+    const CompiledExpression& expr, const std::vector<int>& state) {
+  const ExpressionMemo& memo = *expr.memo();
+  uint64_t index = 0;
+  for (size_t i = 0; i < memo.variables.size(); ++i) {
+    const int value = state[memo.variables[i]];
+    if (value < memo.min_values[i] || value > memo.max_values[i]) {
+      ExecuteOperations(expr.operations(), state);
+      return dregs_[0];
+    }
+    index += (value - memo.min_values[i]) * memo.strides[i];
+  }
+  if (!memo.table.empty()) {
+    return memo.table[index];
+  }
+  if (memo_cache_.empty()) {
+    memo_cache_.resize(kMemoCacheSize, {0, 0, 0.0});
+  }
+  MemoCacheEntry& entry =
+      memo_cache_[(memo.id * 0x9E3779B97F4A7C15ULL + index) &
+                  (kMemoCacheSize - 1)];
+  if (entry.memo_id != memo.id || entry.index != index) {
+    ExecuteOperations(expr.operations(), state);
+    entry = {memo.id, index, dregs_[0]};
+  }
+  return entry.value;
+}
+
 void CompiledExpressionEvaluator::ExecuteOperations(
     const std::vector<Operation>& operations, const std::vector<int>& state) {
   for (size_t pc = 0; pc < operations.size(); ++pc) {
@@ -1761,14 +1890,18 @@ class RegisterState {
   void SetValue(T value, const OperationIndex& dependency);
   void SetDependency(const OperationIndex& dependency);
   void AddDependencies(const std::set<OperationIndex>& dependencies);
+  void SetBounds(const std::optional<std::pair<T, T>>& bounds);
   void MergeWith(const RegisterState<T>& other_state);
 
   const T* value() const { return has_value_ ? &value_ : nullptr; }
+  const std::optional<std::pair<T, T>>& bounds() const { return bounds_; }
   const std::set<OperationIndex>& dependencies() const { return dependencies_; }
 
  private:
   bool has_value_;
   T value_;
+  // Inclusive lower and upper bounds on the value of the register, if known.
+  std::optional<std::pair<T, T>> bounds_;
   std::set<OperationIndex> dependencies_;
 };
 
@@ -1780,12 +1913,14 @@ template <typename T>
 void RegisterState<T>::SetValue(T value, const OperationIndex& dependency) {
   has_value_ = true;
   value_ = value;
+  bounds_ = std::make_pair(value, value);
   dependencies_ = {dependency};
 }
 
 template <typename T>
 void RegisterState<T>::SetDependency(const OperationIndex& dependency) {
   has_value_ = false;
+  bounds_.reset();
   dependencies_ = {dependency};
 }
 
@@ -1793,11 +1928,25 @@ template <typename T>
 void RegisterState<T>::AddDependencies(
     const std::set<OperationIndex>& dependencies) {
   has_value_ = false;
+  bounds_.reset();
   dependencies_.insert(dependencies.begin(), dependencies.end());
 }
 
+template <typename T>
+void RegisterState<T>::SetBounds(const std::optional<std::pair<T, T>>& bounds) {
+  bounds_ = bounds;
+}
+
 template <typename T>
 void RegisterState<T>::MergeWith(const RegisterState<T>& other_state) {
+  std::optional<std::pair<T, T>> bounds;
+  if (dependencies_.empty()) {
+    bounds = other_state.bounds_;
+  } else if (bounds_.has_value() && other_state.bounds_.has_value()) {
+    bounds = std::make_pair(
+        std::min(bounds_.value().first, other_state.bounds_.value().first),
+        std::max(bounds_.value().second, other_state.bounds_.value().second));
+  }
   if (has_value_) {
     if ((other_state.has_value_ && value_ != other_state.value_) ||
         (!other_state.has_value_ && other_state.dependencies_.empty())) {
@@ -1808,6 +1957,216 @@ void RegisterState<T>::MergeWith(const RegisterState<T>& other_state) {
     value_ = other_state.value_;
   }
   AddDependencies(other_state.dependencies_);
+  bounds_ = bounds;
+}
+
+// Returns the given integer bounds, or none if they do not fit in an int.
+std::optional<std::pair<int, int>> MakeIntBounds(long long min_value,
+                                                 long long max_value) {
+  if (min_value < std::numeric_limits<int>::min() ||
+      max_value > std::numeric_limits<int>::max()) {
+    return {};
+  }
+  return std::make_pair(static_cast<int>(min_value),
+                        static_cast<int>(max_value));
+}
+
+// Returns the given integral double bounds as integer bounds, or none if they
+// do not fit in an int.
+std::optional<std::pair<int, int>> RoundedIntBounds(double min_value,
+                                                    double max_value) {
+  if (!(min_value >= std::numeric_limits<int>::min() &&
+        max_value <= std::numeric_limits<int>::max())) {
+    return {};
+  }
+  return std::make_pair(static_cast<int>(min_value),
+                        static_cast<int>(max_value));
+}
+
+// Returns the given double bounds, or none if either bound is NaN.
+std::optional<std::pair<double, double>> MakeDoubleBounds(double min_value,
+                                                          double max_value) {
+  if (std::isnan(min_value) || std::isnan(max_value)) {
+    return {};
+  }
+  return std::make_pair(min_value, max_value);
+}
+
+// Returns the result of the given comparison for operands with the given
+// bounds, or none if the bounds do not decide the comparison.
+template <typename T>
+std::optional<bool> CompareBounds(Opcode opcode, const std::pair<T, T>& bounds1,
+                                  const std::pair<T, T>& bounds2) {
+  switch (opcode) {
+    case Opcode::IEQ:
+    case Opcode::DEQ:
+      if (bounds1.second < bounds2.first || bounds2.second < bounds1.first) {
+        return false;
+      } else if (bounds1.first == bounds1.second &&
+                 bounds2.first == bounds2.second) {
+        return true;
+      }
+      return {};
+    case Opcode::INE:
+    case Opcode::DNE: {
+      const std::optional<bool> equal =
+          CompareBounds(Opcode::IEQ, bounds1, bounds2);
+      if (equal.has_value()) {
+        return !equal.value();
+      }
+      return {};
+    }
+    case Opcode::ILT:
+    case Opcode::DLT:
+      if (bounds1.second < bounds2.first) {
+        return true;
+      } else if (bounds1.first >= bounds2.second) {
+        return false;
+      }
+      return {};
+    case Opcode::ILE:
+    case Opcode::DLE:
+      if (bounds1.second <= bounds2.first) {
+        return true;
+      } else if (bounds1.first > bounds2.second) {
+        return false;
+      }
+      return {};
+    case Opcode::IGE:
+    case Opcode::DGE:
+      return CompareBounds(Opcode::ILE, bounds2, bounds1);
+    case Opcode::IGT:
+    case Opcode::DGT:
+      return CompareBounds(Opcode::ILT, bounds2, bounds1);
+    default:
+      return {};
+  }
+}
+
+// Returns the bounds of the result of the given binary operation with operands
+// with the given bounds, or none if the result bounds are unknown.
+std::optional<std::pair<int, int>> BinaryIntBounds(
+    Opcode opcode, const std::pair<int, int>& bounds1,
+    const std::pair<int, int>& bounds2) {
+  const long long min1 = bounds1.first;
+  const long long max1 = bounds1.second;
+  const long long min2 = bounds2.first;
+  const long long max2 = bounds2.second;
+  switch (opcode) {
+    case Opcode::IADD:
+      return MakeIntBounds(min1 + min2, max1 + max2);
+    case Opcode::ISUB:
+      return MakeIntBounds(min1 - max2, max1 - min2);
+    case Opcode::IMUL: {
+      const long long products[] = {min1 * min2, min1 * max2, max1 * min2,
+                                    max1 * max2};
+      return MakeIntBounds(*std::min_element(products, products + 4),
+                           *std::max_element(products, products + 4));
+    }
+    case Opcode::IEQ:
+    case Opcode::INE:
+    case Opcode::ILT:
+    case Opcode::ILE:
+    case Opcode::IGE:
+    case Opcode::IGT:
+      return std::make_pair(0, 1);
+    case Opcode::IMIN:
+      return MakeIntBounds(std::min(min1, min2), std::min(max1, max2));
+    case Opcode::IMAX:
+      return MakeIntBounds(std::max(min1, min2), std::max(max1, max2));
+    case Opcode::MOD:
+      if (min1 >= 0 && min2 > 0) {
+        return MakeIntBounds(0, std::min(max1, max2 - 1));
+      }
+      return {};
+    default:
+      return {};
+  }
+}
+
+// Returns the bounds of the result of the given binary operation with operands
+// with the given bounds, or none if the result bounds are unknown.
+std::optional<std::pair<double, double>> BinaryDoubleBounds(
+    Opcode opcode, const std::pair<double, double>& bounds1,
+    const std::pair<double, double>& bounds2) {
+  switch (opcode) {
+    case Opcode::DADD:
+      return MakeDoubleBounds(bounds1.first + bounds2.first,
+                              bounds1.second + bounds2.second);
+    case Opcode::DSUB:
+      return MakeDoubleBounds(bounds1.first - bounds2.second,
+                              bounds1.second - bounds2.first);
+    case Opcode::DMUL:
+    case Opcode::DDIV: {
+      if (opcode == Opcode::DDIV &&
+          bounds2.first <= 0 && bounds2.second >= 0) {
+        return {};
+      }
+      double values[4];
+      if (opcode == Opcode::DMUL) {
+        values[0] = bounds1.first * bounds2.first;
+        values[1] = bounds1.first * bounds2.second;
+        values[2] = bounds1.second * bounds2.first;
+        values[3] = bounds1.second * bounds2.second;
+      } else {
+        values[0] = bounds1.first / bounds2.first;
+        values[1] = bounds1.first / bounds2.second;
+        values[2] = bounds1.second / bounds2.first;
+        values[3] = bounds1.second / bounds2.second;
+      }
+      for (double value : values) {
+        if (std::isnan(value)) {
+          return {};
+        }
+      }
+      return MakeDoubleBounds(*std::min_element(values, values + 4),
+                              *std::max_element(values, values + 4));
+    }
+    case Opcode::DMIN:
+      return MakeDoubleBounds(std::min(bounds1.first, bounds2.first),
+                              std::min(bounds1.second, bounds2.second));
+    case Opcode::DMAX:
+      return MakeDoubleBounds(std::max(bounds1.first, bounds2.first),
+                              std::max(bounds1.second, bounds2.second));
+    default:
+      return {};
+  }
+}
+
+// Returns true if the given min or max operation always evaluates to its first
+// operand, given the bounds of its operands.
+template <typename T>
+bool IsFirstOperandResult(Opcode opcode, const std::pair<T, T>& bounds1,
+                          const std::pair<T, T>& bounds2) {
+  switch (opcode) {
+    case Opcode::IMIN:
+    case Opcode::DMIN:
+      return bounds1.second <= bounds2.first;
+    case Opcode::IMAX:
+    case Opcode::DMAX:
+      return bounds1.first >= bounds2.second;
+    case Opcode::MOD:
+      return bounds1.first >= 0 && bounds1.second < bounds2.first;
+    default:
+      return false;
+  }
+}
+
+// Returns true if the given min or max operation always evaluates to its
+// second operand, given the bounds of its operands.
+template <typename T>
+bool IsSecondOperandResult(Opcode opcode, const std::pair<T, T>& bounds1,
+                           const std::pair<T, T>& bounds2) {
+  switch (opcode) {
+    case Opcode::IMIN:
+    case Opcode::DMIN:
+      return bounds2.second <= bounds1.first;
+    case Opcode::IMAX:
+    case Opcode::DMAX:
+      return bounds2.first >= bounds1.second;
+    default:
+      return false;
+  }
 }
 
 // A basic block of a control flow graph.
@@ -1820,6 +2179,10 @@ class BasicBlock {
   void SetIntDependency(size_t r, const Operation& o);
   void SetDoubleValue(size_t r, double value);
   void AddOperation(const Operation& o);
+  void AddVariableLoad(const Operation& o,
+                       const std::vector<VariableBounds>& variable_bounds);
+  void AddVariableComparison(
+      const Operation& o, const std::vector<VariableBounds>& variable_bounds);
   void AddUnaryIntOperation(const Operation& o);
   void AddUnaryIntFromDoubleOperation(const Operation& o);
   void AddUnaryDoubleOperation(const Operation& o);
@@ -1845,6 +2208,8 @@ class BasicBlock {
 
   const int* GetIntValue(size_t r) const;
   const double* GetDoubleValue(size_t r) const;
+  std::optional<std::pair<int, int>> GetIntBounds(size_t r) const;
+  std::optional<std::pair<double, double>> GetDoubleBounds(size_t r) const;
   std::optional<int> GetVariable(size_t r,
                                  const std::vector<BasicBlock>& blocks) const;
   std::set<OperationIndex> GetIntDependencies(size_t r) const;
@@ -1852,6 +2217,8 @@ class BasicBlock {
   bool IsFallthrough() const;
 
  private:
+  void AddBinaryIntOperationImpl(const Operation& o,
+                                 const std::vector<BasicBlock>& blocks);
   void SetDoubleDependency(size_t r, const Operation& o);
   void AddIntDependency(size_t r, const Operation& o);
   void AddDoubleDependency(size_t r, const Operation& o);
@@ -1892,10 +2259,77 @@ void BasicBlock::SetDoubleValue(size_t r, double value) {
 
 void BasicBlock::AddOperation(const Operation& o) { operations_.push_back(o); }
 
+void BasicBlock::AddVariableLoad(
+    const Operation& o, const std::vector<VariableBounds>& variable_bounds) {
+  SetIntDependency(o.operand2(), o);
+  const size_t variable = o.ioperand1();
+  if (variable < variable_bounds.size()) {
+    int_states_[o.operand2()].SetBounds(
+        std::make_pair(variable_bounds[variable].min_value,
+                       variable_bounds[variable].max_value));
+  }
+}
+
+void BasicBlock::AddVariableComparison(
+    const Operation& o, const std::vector<VariableBounds>& variable_bounds) {
+  const size_t variable = o.ioperand1();
+  if (variable < variable_bounds.size()) {
+    Opcode opcode;
+    switch (o.opcode()) {
+      case Opcode::IVEQ:
+        opcode = Opcode::IEQ;
+        break;
+      case Opcode::IVNE:
+        opcode = Opcode::INE;
+        break;
+      case Opcode::IVLT:
+        opcode = Opcode::ILT;
+        break;
+      case Opcode::IVLE:
+        opcode = Opcode::ILE;
+        break;
+      case Opcode::IVGE:
+        opcode = Opcode::IGE;
+        break;
+      case Opcode::IVGT:
+        opcode = Opcode::IGT;
+        break;
+      default:
+        LOG(FATAL) << "internal error";
+    }
+    const std::optional<bool> result = CompareBounds(
+        opcode,
+        std::make_pair(variable_bounds[variable].min_value,
+                       variable_bounds[variable].max_value),
+        std::make_pair(o.operand2(), o.operand2()));
+    if (result.has_value()) {
+      SetIntValue(o.operand3(), result.value());
+      return;
+    }
+  }
+  SetIntDependency(o.operand3(), o);
+  int_states_[o.operand3()].SetBounds(std::make_pair(0, 1));
+}
+
 void BasicBlock::AddUnaryIntOperation(const Operation& o) {
   const int* value = GetIntValue(o.ioperand1());
   if (value == nullptr) {
+    const std::optional<std::pair<int, int>> bounds =
+        GetIntBounds(o.ioperand1());
+    std::optional<std::pair<int, int>> result_bounds;
+    if (bounds.has_value()) {
+      if (o.opcode() == Opcode::INEG) {
+        result_bounds = MakeIntBounds(-static_cast<long long>(bounds->second),
+                                      -static_cast<long long>(bounds->first));
+      } else if (bounds->first > 0 || bounds->second < 0) {
+        SetIntValue(o.ioperand1(), 0);
+        return;
+      } else if (bounds->first == 0 && bounds->second == 1) {
+        result_bounds = bounds;
+      }
+    }
     AddIntDependency(o.ioperand1(), o);
+    int_states_[o.ioperand1()].SetBounds(result_bounds);
   } else {
     int v;
     switch (o.opcode()) {
@@ -1915,8 +2349,16 @@ void BasicBlock::AddUnaryIntOperation(const Operation& o) {
 void BasicBlock::AddUnaryIntFromDoubleOperation(const Operation& o) {
   const double* value = GetDoubleValue(o.ioperand1());
   if (value == nullptr) {
+    const std::optional<std::pair<double, double>> bounds =
+        GetDoubleBounds(o.ioperand1());
     SetIntDependency(o.ioperand1(), o);
     AddIntDependenciesFromDoubleDependencies(o.ioperand1(), o.ioperand1());
+    if (bounds.has_value()) {
+      int_states_[o.ioperand1()].SetBounds(
+          (o.opcode() == Opcode::FLOOR)
+              ? RoundedIntBounds(floor(bounds->first), floor(bounds->second))
+              : RoundedIntBounds(ceil(bounds->first), ceil(bounds->second)));
+    }
   } else {
     int v;
     switch (o.opcode()) {
@@ -1936,7 +2378,13 @@ void BasicBlock::AddUnaryIntFromDoubleOperation(const Operation& o) {
 void BasicBlock::AddUnaryDoubleOperation(const Operation& o) {
   const double* value = GetDoubleValue(o.ioperand1());
   if (value == nullptr) {
+    const std::optional<std::pair<double, double>> bounds =
+        GetDoubleBounds(o.ioperand1());
     AddDoubleDependency(o.ioperand1(), o);
+    if (bounds.has_value()) {
+      double_states_[o.ioperand1()].SetBounds(
+          std::make_pair(-bounds->second, -bounds->first));
+    }
   } else {
     double v;
     switch (o.opcode()) {
@@ -1953,8 +2401,14 @@ void BasicBlock::AddUnaryDoubleOperation(const Operation& o) {
 void BasicBlock::AddUnaryDoubleFromIntOperation(const Operation& o) {
   const int* value = GetIntValue(o.ioperand1());
   if (value == nullptr) {
+    const std::optional<std::pair<int, int>> bounds =
+        GetIntBounds(o.ioperand1());
     SetDoubleDependency(o.ioperand1(), o);
     AddDoubleDependenciesFromIntDependencies(o.ioperand1(), o.ioperand1());
+    if (bounds.has_value()) {
+      double_states_[o.ioperand1()].SetBounds(std::make_pair<double, double>(
+          bounds->first, bounds->second));
+    }
   } else {
     double v;
     switch (o.opcode()) {
@@ -1970,6 +2424,49 @@ void BasicBlock::AddUnaryDoubleFromIntOperation(const Operation& o) {
 
 void BasicBlock::AddBinaryIntOperation(const Operation& o,
                                        const std::vector<BasicBlock>& blocks) {
+  const std::optional<std::pair<int, int>> bounds1 =
+      GetIntBounds(o.ioperand1());
+  const std::optional<std::pair<int, int>> bounds2 = GetIntBounds(o.operand2());
+  std::optional<std::pair<int, int>> result_bounds;
+  if (bounds1.has_value() && bounds2.has_value()) {
+    const std::optional<bool> result =
+        CompareBounds(o.opcode(), bounds1.value(), bounds2.value());
+    if (result.has_value()) {
+      SetIntValue(o.ioperand1(), result.value());
+      return;
+    }
+    if (IsFirstOperandResult(o.opcode(), bounds1.value(), bounds2.value())) {
+      return;
+    }
+    if (IsSecondOperandResult(o.opcode(), bounds1.value(), bounds2.value())) {
+      const int* value2 = GetIntValue(o.operand2());
+      if (value2 != nullptr) {
+        SetIntValue(o.ioperand1(), *value2);
+        return;
+      }
+      const std::optional<int> variable = GetVariable(o.operand2(), blocks);
+      if (variable.has_value()) {
+        SetIntDependency(o.ioperand1(),
+                         Operation::MakeILOAD(variable.value(), o.ioperand1()));
+        int_states_[o.ioperand1()].SetBounds(bounds2);
+        return;
+      }
+    }
+    result_bounds =
+        BinaryIntBounds(o.opcode(), bounds1.value(), bounds2.value());
+  } else if (o.opcode() == Opcode::IEQ || o.opcode() == Opcode::INE ||
+             o.opcode() == Opcode::ILT || o.opcode() == Opcode::ILE ||
+             o.opcode() == Opcode::IGE || o.opcode() == Opcode::IGT) {
+    result_bounds = std::make_pair(0, 1);
+  }
+  AddBinaryIntOperationImpl(o, blocks);
+  if (GetIntValue(o.ioperand1()) == nullptr) {
+    int_states_[o.ioperand1()].SetBounds(result_bounds);
+  }
+}
+
+void BasicBlock::AddBinaryIntOperationImpl(
+    const Operation& o, const std::vector<BasicBlock>& blocks) {
   const int* value1 = GetIntValue(o.ioperand1());
   const int* value2 = GetIntValue(o.operand2());
   if (value1 == nullptr || value2 == nullptr) {
@@ -2096,9 +2593,22 @@ void BasicBlock::AddBinaryIntFromDoubleOperation(const Operation& o) {
   const double* value1 = GetDoubleValue(o.ioperand1());
   const double* value2 = GetDoubleValue(o.operand2());
   if (value1 == nullptr || value2 == nullptr) {
+    const std::optional<std::pair<double, double>> bounds1 =
+        GetDoubleBounds(o.ioperand1());
+    const std::optional<std::pair<double, double>> bounds2 =
+        GetDoubleBounds(o.operand2());
+    if (bounds1.has_value() && bounds2.has_value()) {
+      const std::optional<bool> result =
+          CompareBounds(o.opcode(), bounds1.value(), bounds2.value());
+      if (result.has_value()) {
+        SetIntValue(o.ioperand1(), result.value());
+        return;
+      }
+    }
     SetIntDependency(o.ioperand1(), o);
     AddIntDependenciesFromDoubleDependencies(o.ioperand1(), o.ioperand1());
     AddIntDependenciesFromDoubleDependencies(o.ioperand1(), o.operand2());
+    int_states_[o.ioperand1()].SetBounds(std::make_pair(0, 1));
   } else {
     int v;
     switch (o.opcode()) {
@@ -2131,8 +2641,26 @@ void BasicBlock::AddBinaryDoubleOperation(const Operation& o) {
   const double* value1 = GetDoubleValue(o.ioperand1());
   const double* value2 = GetDoubleValue(o.operand2());
   if (value1 == nullptr || value2 == nullptr) {
+    const std::optional<std::pair<double, double>> bounds1 =
+        GetDoubleBounds(o.ioperand1());
+    const std::optional<std::pair<double, double>> bounds2 =
+        GetDoubleBounds(o.operand2());
+    std::optional<std::pair<double, double>> result_bounds;
+    if (bounds1.has_value() && bounds2.has_value()) {
+      if (IsFirstOperandResult(o.opcode(), bounds1.value(), bounds2.value())) {
+        return;
+      }
+      if (value2 != nullptr &&
+          IsSecondOperandResult(o.opcode(), bounds1.value(), bounds2.value())) {
+        SetDoubleValue(o.ioperand1(), *value2);
+        return;
+      }
+      result_bounds =
+          BinaryDoubleBounds(o.opcode(), bounds1.value(), bounds2.value());
+    }
     AddDoubleDependency(o.ioperand1(), o);
     AddDoubleDependenciesFromDoubleDependencies(o.ioperand1(), o.operand2());
+    double_states_[o.ioperand1()].SetBounds(result_bounds);
   } else {
     double v;
     switch (o.opcode()) {
@@ -2243,6 +2771,23 @@ const double* BasicBlock::GetDoubleValue(size_t r) const {
   return (i == double_states_.end()) ? nullptr : i->second.value();
 }
 
+std::optional<std::pair<int, int>> BasicBlock::GetIntBounds(size_t r) const {
+  const auto i = int_states_.find(r);
+  if (i == int_states_.end()) {
+    return {};
+  }
+  return i->second.bounds();
+}
+
+std::optional<std::pair<double, double>> BasicBlock::GetDoubleBounds(
+    size_t r) const {
+  const auto i = double_states_.find(r);
+  if (i == double_states_.end()) {
+    return {};
+  }
+  return i->second.bounds();
+}
+
 std::optional<int> BasicBlock::GetVariable(
     size_t r, const std::vector<BasicBlock>& blocks) const {
   const auto i = int_states_.find(r);
@@ -2336,7 +2881,8 @@ void MaybeAddBranch(size_t block_index, const Operation& o, size_t pc,
 }
 
 std::vector<BasicBlock> MakeControlFlowGraph(
-    const std::vector<Operation>& operations) {
+    const std::vector<Operation>& operations,
+    const std::vector<VariableBounds>& variable_bounds) {
   std::vector<BasicBlock> blocks;
   std::map<size_t, size_t> block_starts;
   size_t block_index = 0;
@@ -2362,7 +2908,7 @@ std::vector<BasicBlock> MakeControlFlowGraph(
         block.SetDoubleValue(o.operand2(), o.doperand1());
         continue;
       case Opcode::ILOAD:
-        block.SetIntDependency(o.operand2(), o);
+        block.AddVariableLoad(o, variable_bounds);
         continue;
       case Opcode::INEG:
       case Opcode::NOT:
@@ -2426,7 +2972,7 @@ std::vector<BasicBlock> MakeControlFlowGraph(
       case Opcode::IVLE:
       case Opcode::IVGE:
       case Opcode::IVGT:
-        block.SetIntDependency(o.operand3(), o);
+        block.AddVariableComparison(o, variable_bounds);
         continue;
     }
     LOG(FATAL) << "bad opcode";
@@ -2555,8 +3101,14 @@ CompiledExpression OptimizeExpressionImpl(
 }  // namespace
 
 CompiledExpression OptimizeIntExpression(const CompiledExpression& expr) {
+  return OptimizeIntExpression(expr, {});
+}
+
+CompiledExpression OptimizeIntExpression(
+    const CompiledExpression& expr,
+    const std::vector<VariableBounds>& variable_bounds) {
   const std::vector<BasicBlock> blocks =
-      MakeControlFlowGraph(expr.operations());
+      MakeControlFlowGraph(expr.operations(), variable_bounds);
   const size_t end_block_index = GetEndBlockIndex(blocks);
   const std::set<OperationIndex> live_operations =
       blocks[end_block_index].GetIntDependencies(0);
@@ -2565,8 +3117,14 @@ CompiledExpression OptimizeIntExpression(const CompiledExpression& expr) {
 }
 
 CompiledExpression OptimizeDoubleExpression(const CompiledExpression& expr) {
+  return OptimizeDoubleExpression(expr, {});
+}
+
+CompiledExpression OptimizeDoubleExpression(
+    const CompiledExpression& expr,
+    const std::vector<VariableBounds>& variable_bounds) {
   const std::vector<BasicBlock> blocks =
-      MakeControlFlowGraph(expr.operations());
+      MakeControlFlowGraph(expr.operations(), variable_bounds);
   const size_t end_block_index = GetEndBlockIndex(blocks);
   const std::set<OperationIndex> live_operations =
       blocks[end_block_index].GetDoubleDependencies(0);
@@ -24,9 +24,12 @@
 #ifndef COMPILED_EXPRESSION_H_
 #define COMPILED_EXPRESSION_H_
 
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <optional>
 #include <ostream>
+#include <set>
 #include <utility>
 #include <vector>
 
@@ -275,6 +278,27 @@ class IdentifierInfo {
   TypedValue value_;
 };
 
+// Inclusive bounds on the value of an integer-valued state variable.
+struct VariableBounds {
+  int min_value;
+  int max_value;
+};
+
+// Memoization data for a double-valued compiled expression that depends on a
+// few state variables.  Each assignment to the variables in the support of the
+// expression maps to the mixed-radix index sum_i (x_i - min_values[i]) *
+// strides[i].  If table is nonempty, it holds the value of the expression for
+// every index.  Otherwise, values are cached per evaluator.
+struct ExpressionMemo {
+  // A process-wide unique identifier for this memo, used as cache key.
+  uint64_t id;
+  std::vector<int> variables;
+  std::vector<int> min_values;
+  std::vector<int> max_values;
+  std::vector<uint64_t> strides;
+  std::vector<double> table;
+};
+
 // A compiled expression.
 class CompiledExpression {
  public:
@@ -292,14 +316,27 @@ class CompiledExpression {
   // Returns the optional decision diagram for this compiled expression.
   const std::optional<ADD>& dd() const { return dd_; }
 
+  // Returns the memoization data for this compiled expression, or nullptr if
+  // the expression is not memoized.
+  const ExpressionMemo* memo() const { return memo_.get(); }
+
   // Returns this compiled expression after the given variable assignment.
   CompiledExpression WithAssignment(
       const IdentifierInfo& variable, int value,
       const std::optional<DecisionDiagramManager>& dd_manager) const;
 
+  // Returns this compiled expression, interpreted as a double expression, with
+  // memoization enabled if it depends on few enough state variables.  The
+  // values of the expression are tabulated up front if the domain of the
+  // variables it depends on has at most max_table_size elements.
+  CompiledExpression WithMemoization(
+      const std::vector<VariableBounds>& variable_bounds,
+      size_t max_table_size) const;
+
  private:
   std::vector<Operation> operations_;
   std::optional<ADD> dd_;
+  std::shared_ptr<const ExpressionMemo> memo_;
 };
 
 // Output operator for compiled expressions.
@@ -309,6 +346,10 @@ std::ostream& operator<<(std::ostream& os, const CompiledExpression& expr);
 // compiled expression.
 std::pair<int, int> GetExpressionRegisterCounts(const CompiledExpression& expr);
 
+// Returns the indices of the state variables that the given compiled
+// expression depends on.
+std::set<int> GetExpressionVariables(const CompiledExpression& expr);
+
 // A virtual machine for evaluating for compiled expressions.
 class CompiledExpressionEvaluator {
  public:
@@ -322,17 +363,30 @@ class CompiledExpressionEvaluator {
                             const std::vector<int>& state);
 
   // Evaluates expr as a double expression in the given state.  Assumes that the
-  // result of the evaluation ends up in double register 0.
+  // result of the evaluation ends up in double register 0.  Uses the
+  // memoization data of expr, if any.
   double EvaluateDoubleExpression(const CompiledExpression& expr,
                                   const std::vector<int>& state);
 
  private:
+  // An entry in the direct-mapped cache for memoized expressions.
+  struct MemoCacheEntry {
+    uint64_t memo_id;
+    uint64_t index;
+    double value;
+  };
+
+  // Evaluates a memoized double expression in the given state.
+  double EvaluateMemoizedDoubleExpression(const CompiledExpression& expr,
+                                          const std::vector<int>& state);
+
   // Executes a sequence of operations in a given state.
   void ExecuteOperations(const std::vector<Operation>& operations,
                          const std::vector<int>& state);
 
   std::vector<int> iregs_;
   std::vector<double> dregs_;
+  std::vector<MemoCacheEntry> memo_cache_;
 };
 
 // The result of an expression compilation.  On success, expr will hold the
@@ -377,8 +431,21 @@ ADD PrimedIdentifierToAdd(const DecisionDiagramManager& dd_manager,
 // register 0.
 CompiledExpression OptimizeIntExpression(const CompiledExpression& expr);
 
+// Variation of OptimizeIntExpression that assumes that the value of the ith
+// state variable lies within variable_bounds[i].  Comparisons and min/max
+// operations that are decided by these bounds are folded.
+CompiledExpression OptimizeIntExpression(
+    const CompiledExpression& expr,
+    const std::vector<VariableBounds>& variable_bounds);
+
 // Optimizes the given expression, assuming it evaluates to a double in
 // register 0.
 CompiledExpression OptimizeDoubleExpression(const CompiledExpression& expr);
 
+// Variation of OptimizeDoubleExpression that assumes that the value of the ith
+// state variable lies within variable_bounds[i].
+CompiledExpression OptimizeDoubleExpression(
+    const CompiledExpression& expr,
+    const std::vector<VariableBounds>& variable_bounds);
+
 #endif  // COMPILED_EXPRESSION_H_
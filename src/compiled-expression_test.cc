@@ -151,6 +151,63 @@ TEST(CompiledExpressionTest, WithAssignment) {
                 .operations());
 }
 
+TEST(CompiledExpressionTest, WithMemoization) {
+  const std::vector<VariableBounds> variable_bounds = {{0, 3}, {1, 2}, {0, 9}};
+  // min(x0, 2) * x1 + 0.5
+  const CompiledExpression expr(
+      {Operation::MakeILOAD(0, 0), Operation::MakeICONST(2, 1),
+       Operation::MakeIMIN(0, 1), Operation::MakeILOAD(1, 1),
+       Operation::MakeIMUL(0, 1), Operation::MakeI2D(0),
+       Operation::MakeDCONST(0.5, 1), Operation::MakeDADD(0, 1)},
+      {});
+  EXPECT_EQ(nullptr, expr.memo());
+  const CompiledExpression tabulated =
+      expr.WithMemoization(variable_bounds, 8);
+  EXPECT_EQ(expr.operations(), tabulated.operations());
+  ASSERT_NE(nullptr, tabulated.memo());
+  EXPECT_EQ(std::vector<int>({0, 1}), tabulated.memo()->variables);
+  EXPECT_EQ(8U, tabulated.memo()->table.size());
+  const CompiledExpression cached = expr.WithMemoization(variable_bounds, 7);
+  ASSERT_NE(nullptr, cached.memo());
+  EXPECT_TRUE(cached.memo()->table.empty());
+  EXPECT_NE(tabulated.memo()->id, cached.memo()->id);
+  CompiledExpressionEvaluator evaluator(2, 2);
+  for (int x0 = 0; x0 <= 3; ++x0) {
+    for (int x1 = 1; x1 <= 2; ++x1) {
+      const std::vector<int> state = {x0, x1, 5};
+      const double expected = evaluator.EvaluateDoubleExpression(expr, state);
+      EXPECT_EQ(std::min(x0, 2) * x1 + 0.5, expected);
+      EXPECT_EQ(expected, evaluator.EvaluateDoubleExpression(tabulated, state));
+      EXPECT_EQ(expected, evaluator.EvaluateDoubleExpression(cached, state));
+      EXPECT_EQ(expected, evaluator.EvaluateDoubleExpression(cached, state));
+    }
+  }
+  // Values outside the bounds are evaluated directly.
+  EXPECT_EQ(6.5, evaluator.EvaluateDoubleExpression(tabulated, {4, 3, 0}));
+}
+
+TEST(CompiledExpressionTest, WithMemoizationSkipsSimpleExpressions) {
+  const std::vector<VariableBounds> variable_bounds = {{0, 3}};
+  const CompiledExpression expr1(
+      {Operation::MakeILOAD(0, 0), Operation::MakeI2D(0)}, {});
+  EXPECT_EQ(nullptr, expr1.WithMemoization(variable_bounds, 16).memo());
+  const CompiledExpression expr2(
+      {Operation::MakeDCONST(0.5, 0), Operation::MakeDCONST(2.0, 1),
+       Operation::MakeDMUL(0, 1)},
+      {});
+  EXPECT_EQ(nullptr, expr2.WithMemoization(variable_bounds, 16).memo());
+}
+
+TEST(GetExpressionVariablesTest, Program) {
+  const CompiledExpression expr1({Operation::MakeDCONST(0.5, 0)}, {});
+  EXPECT_EQ(std::set<int>(), GetExpressionVariables(expr1));
+  const CompiledExpression expr2(
+      {Operation::MakeILOAD(3, 0), Operation::MakeIVLT(1, 4, 1),
+       Operation::MakeILOAD(3, 2), Operation::MakeIADD(0, 2)},
+      {});
+  EXPECT_EQ(std::set<int>({1, 3}), GetExpressionVariables(expr2));
+}
+
 TEST(GetExpressionRegisterCountsTest, Constant) {
   const CompiledExpression expr1({Operation::MakeICONST(17, 3)}, {});
   EXPECT_EQ(std::make_pair(4, 0), GetExpressionRegisterCounts(expr1));
@@ -2916,4 +2973,110 @@ TEST(OptimizeDoubleExpressionTest, EliminatesDeadCode) {
   EXPECT_EQ(expected3, OptimizeDoubleExpression(expr3).operations());
 }
 
+TEST(OptimizeIntExpressionTest, VariableBoundsComparison) {
+  const std::vector<VariableBounds> variable_bounds = {{0, 5}, {-2, 2}};
+  const CompiledExpression expr1(
+      {Operation::MakeILOAD(0, 0), Operation::MakeICONST(0, 1),
+       Operation::MakeIGE(0, 1)},
+      {});
+  const std::vector<Operation> expected1 = {Operation::MakeICONST(true, 0)};
+  EXPECT_EQ(expected1,
+            OptimizeIntExpression(expr1, variable_bounds).operations());
+  const CompiledExpression expr2(
+      {Operation::MakeILOAD(0, 0), Operation::MakeICONST(5, 1),
+       Operation::MakeIGT(0, 1)},
+      {});
+  const std::vector<Operation> expected2 = {Operation::MakeICONST(false, 0)};
+  EXPECT_EQ(expected2,
+            OptimizeIntExpression(expr2, variable_bounds).operations());
+  const CompiledExpression expr3(
+      {Operation::MakeILOAD(0, 0), Operation::MakeICONST(4, 1),
+       Operation::MakeIGT(0, 1)},
+      {});
+  const std::vector<Operation> expected3 = {Operation::MakeIVGT(0, 4, 0)};
+  EXPECT_EQ(expected3,
+            OptimizeIntExpression(expr3, variable_bounds).operations());
+  const CompiledExpression expr4(
+      {Operation::MakeILOAD(0, 0), Operation::MakeILOAD(1, 1),
+       Operation::MakeIADD(0, 1), Operation::MakeICONST(8, 1),
+       Operation::MakeILT(0, 1)},
+      {});
+  const std::vector<Operation> expected4 = {Operation::MakeICONST(true, 0)};
+  EXPECT_EQ(expected4,
+            OptimizeIntExpression(expr4, variable_bounds).operations());
+  const CompiledExpression expr5({Operation::MakeIVLT(1, -2, 0)}, {});
+  const std::vector<Operation> expected5 = {Operation::MakeICONST(false, 0)};
+  EXPECT_EQ(expected5,
+            OptimizeIntExpression(expr5, variable_bounds).operations());
+  EXPECT_EQ(expr5.operations(), OptimizeIntExpression(expr5).operations());
+}
+
+TEST(OptimizeIntExpressionTest, VariableBoundsDeadBranch) {
+  const std::vector<VariableBounds> variable_bounds = {{0, 5}};
+  const CompiledExpression expr(
+      {Operation::MakeIVGE(0, 0, 0), Operation::MakeIFFALSE(0, 3),
+       Operation::MakeIVLT(0, 3, 0)},
+      {});
+  const std::vector<Operation> expected = {Operation::MakeIVLT(0, 3, 0)};
+  EXPECT_EQ(expected,
+            OptimizeIntExpression(expr, variable_bounds).operations());
+}
+
+TEST(OptimizeIntExpressionTest, VariableBoundsMinMax) {
+  const std::vector<VariableBounds> variable_bounds = {{0, 5}};
+  const CompiledExpression expr1(
+      {Operation::MakeILOAD(0, 0), Operation::MakeICONST(5, 1),
+       Operation::MakeIMIN(0, 1)},
+      {});
+  const std::vector<Operation> expected1 = {Operation::MakeILOAD(0, 0)};
+  EXPECT_EQ(expected1,
+            OptimizeIntExpression(expr1, variable_bounds).operations());
+  EXPECT_EQ(expr1.operations(), OptimizeIntExpression(expr1).operations());
+  const CompiledExpression expr2(
+      {Operation::MakeICONST(0, 0), Operation::MakeILOAD(0, 1),
+       Operation::MakeIMAX(0, 1)},
+      {});
+  const std::vector<Operation> expected2 = {Operation::MakeILOAD(0, 0)};
+  EXPECT_EQ(expected2,
+            OptimizeIntExpression(expr2, variable_bounds).operations());
+  const CompiledExpression expr3(
+      {Operation::MakeILOAD(0, 0), Operation::MakeICONST(7, 1),
+       Operation::MakeIMAX(0, 1)},
+      {});
+  const std::vector<Operation> expected3 = {Operation::MakeICONST(7, 0)};
+  EXPECT_EQ(expected3,
+            OptimizeIntExpression(expr3, variable_bounds).operations());
+  const CompiledExpression expr4(
+      {Operation::MakeILOAD(0, 0), Operation::MakeICONST(6, 1),
+       Operation::MakeMOD(0, 1)},
+      {});
+  const std::vector<Operation> expected4 = {Operation::MakeILOAD(0, 0)};
+  EXPECT_EQ(expected4,
+            OptimizeIntExpression(expr4, variable_bounds).operations());
+}
+
+TEST(OptimizeDoubleExpressionTest, VariableBounds) {
+  const std::vector<VariableBounds> variable_bounds = {{0, 5}};
+  const CompiledExpression expr1(
+      {Operation::MakeILOAD(0, 0), Operation::MakeI2D(0),
+       Operation::MakeDCONST(0.5, 1), Operation::MakeDMUL(0, 1),
+       Operation::MakeDCONST(2.5, 1), Operation::MakeDMIN(0, 1)},
+      {});
+  const std::vector<Operation> expected1 = {Operation::MakeILOAD(0, 0),
+                                            Operation::MakeI2D(0),
+                                            Operation::MakeDCONST(0.5, 1),
+                                            Operation::MakeDMUL(0, 1)};
+  EXPECT_EQ(expected1,
+            OptimizeDoubleExpression(expr1, variable_bounds).operations());
+  const CompiledExpression expr2(
+      {Operation::MakeILOAD(0, 0), Operation::MakeI2D(0),
+       Operation::MakeDCONST(-1.0, 1), Operation::MakeDGT(0, 1),
+       Operation::MakeIFFALSE(0, 7), Operation::MakeDCONST(0.5, 0),
+       Operation::MakeGOTO(8), Operation::MakeDCONST(0.25, 0)},
+      {});
+  const std::vector<Operation> expected2 = {Operation::MakeDCONST(0.5, 0)};
+  EXPECT_EQ(expected2,
+            OptimizeDoubleExpression(expr2, variable_bounds).operations());
+}
+
 }  // namespace
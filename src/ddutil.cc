@@ -18,6 +18,7 @@
 
 #include "ddutil.h"
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
 #include <stack>
@@ -640,12 +641,90 @@ BDD ODD::VectorToBdd(const DecisionDiagramManager& manager,
                          root_, 0, value_to_bool);
 }
 
-SparseMatrix::SparseMatrix(std::vector<double>&& values,
-                           std::vector<size_t>&& columns,
-                           std::vector<size_t>&& row_starts)
-    : values_(std::move(values)),
-      columns_(std::move(columns)),
-      row_starts_(std::move(row_starts)) {}
+SparseMatrix::SparseMatrix(const std::vector<double>& values,
+                           const std::vector<size_t>& columns,
+                           const std::vector<size_t>& row_starts)
+    : row_starts_(row_starts.begin(), row_starts.end()) {
+  CHECK(!row_starts.empty());
+  CHECK_EQ(values.size(), columns.size());
+  CHECK_EQ(values.size(), row_starts.back());
+  CHECK_LE(values.size(), std::numeric_limits<uint32_t>::max());
+  std::unordered_map<double, uint32_t> value_indices;
+  std::vector<uint32_t> indices;
+  indices.reserve(values.size());
+  for (double value : values) {
+    auto i = value_indices.find(value);
+    if (i == value_indices.end()) {
+      i = value_indices.emplace(value, distinct_values_.size()).first;
+      distinct_values_.push_back(value);
+    }
+    indices.push_back(i->second);
+  }
+  if (distinct_values_.size() <= 1 << 16) {
+    value_indices16_.assign(indices.begin(), indices.end());
+  } else {
+    value_indices32_ = std::move(indices);
+  }
+  size_t max_column = 0;
+  for (size_t column : columns) {
+    max_column = std::max(max_column, column);
+  }
+  CHECK_LE(max_column, std::numeric_limits<uint32_t>::max());
+  if (max_column <= std::numeric_limits<uint16_t>::max()) {
+    columns16_.assign(columns.begin(), columns.end());
+  } else {
+    columns32_.assign(columns.begin(), columns.end());
+  }
+}
+
+double SparseMatrix::MemoryEstimate(size_t row_count, size_t element_count) {
+  return element_count * (sizeof(uint16_t) + sizeof(uint16_t)) +
+         (row_count + 1.0) * sizeof(uint32_t);
+}
+
+size_t SparseMatrix::memory_usage() const {
+  return distinct_values_.size() * sizeof(double) +
+         value_indices16_.size() * sizeof(uint16_t) +
+         value_indices32_.size() * sizeof(uint32_t) +
+         columns16_.size() * sizeof(uint16_t) +
+         columns32_.size() * sizeof(uint32_t) +
+         row_starts_.size() * sizeof(uint32_t);
+}
+
+template <typename ColumnIndex, typename ValueIndex>
+void SparseMatrix::AddProductImpl(const ColumnIndex* columns,
+                                  const ValueIndex* value_indices,
+                                  const double* x, double scale,
+                                  double* y) const {
+  const double* values = distinct_values_.data();
+  const size_t n = row_count();
+  for (size_t r = 0; r < n; ++r) {
+    double sum = 0.0;
+    const uint32_t end = row_starts_[r + 1];
+    for (uint32_t i = row_starts_[r]; i < end; ++i) {
+      sum += values[value_indices[i]] * x[columns[i]];
+    }
+    y[r] += sum * scale;
+  }
+}
+
+void SparseMatrix::AddProduct(const double* x, double scale,
+                              double* y) const {
+  if (element_count() == 0) {
+    return;
+  }
+  if (columns16_.empty()) {
+    if (value_indices16_.empty()) {
+      AddProductImpl(columns32_.data(), value_indices32_.data(), x, scale, y);
+    } else {
+      AddProductImpl(columns32_.data(), value_indices16_.data(), x, scale, y);
+    }
+  } else if (value_indices16_.empty()) {
+    AddProductImpl(columns16_.data(), value_indices32_.data(), x, scale, y);
+  } else {
+    AddProductImpl(columns16_.data(), value_indices16_.data(), x, scale, y);
+  }
+}
 
 int Log2(int n) {
   CHECK_GT(n, 0);
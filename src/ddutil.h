@@ -22,6 +22,7 @@
 #ifndef DDUTIL_H_
 #define DDUTIL_H_
 
+#include <cstdint>
 #include <functional>
 #include <iterator>
 #include <optional>
@@ -396,7 +397,9 @@ class ODD {
   int node_count_;
 };
 
-// A matrix represented using compressed row storage format.
+// A matrix represented using compressed row storage format.  To save memory,
+// column indices are 16-bit when all columns fit, and values are stored once
+// each in a dictionary, with 16-bit indices when there are few distinct values.
 class SparseMatrix {
  public:
   class Iterator;
@@ -425,7 +428,7 @@ class SparseMatrix {
     bool operator==(const Iterator& rhs) const { return i_ == rhs.i_; }
     bool operator!=(const Iterator& rhs) const { return i_ != rhs.i_; }
     Element operator*() const {
-      return Element(m_->values_[i_], r_, m_->columns_[i_]);
+      return Element(m_->value(i_), r_, m_->column(i_));
     }
     Iterator& operator++() {
       ++i_;
@@ -445,7 +448,7 @@ class SparseMatrix {
     }
 
     void update_r() {
-      if (i_ < m_->values_.size()) {
+      if (i_ < m_->element_count()) {
         while (i_ >= m_->row_starts_[r_ + 1]) {
           ++r_;
         }
@@ -459,16 +462,55 @@ class SparseMatrix {
     friend class SparseMatrix;
  };
 
- SparseMatrix(std::vector<double>&& values, std::vector<size_t>&& columns,
-              std::vector<size_t>&& row_starts);
+  SparseMatrix(const std::vector<double>& values,
+               const std::vector<size_t>& columns,
+               const std::vector<size_t>& row_starts);
 
- Iterator begin() const { return Iterator(this, 0); }
- Iterator end() const { return Iterator(this, values_.size()); }
+  // Returns the number of bytes that a matrix with the given number of rows
+  // and nonzero elements needs, assuming 16-bit column and value indices.
+  static double MemoryEstimate(size_t row_count, size_t element_count);
 
-private:
- std::vector<double> values_;
- std::vector<size_t> columns_;
- std::vector<size_t> row_starts_;
+  size_t row_count() const { return row_starts_.size() - 1; }
+
+  size_t element_count() const { return row_starts_.back(); }
+
+  size_t distinct_value_count() const { return distinct_values_.size(); }
+
+  // Returns the number of bytes used by the elements of this matrix.
+  size_t memory_usage() const;
+
+  // Adds scale * (M * x)[r] to y[r] for each row r of this matrix M, summing
+  // each row before scaling it.
+  void AddProduct(const double* x, double scale, double* y) const;
+
+  Iterator begin() const { return Iterator(this, 0); }
+  Iterator end() const { return Iterator(this, element_count()); }
+
+ private:
+  double value(size_t i) const {
+    return distinct_values_[value_indices16_.empty() ? value_indices32_[i]
+                                                     : value_indices16_[i]];
+  }
+
+  size_t column(size_t i) const {
+    return columns16_.empty() ? columns32_[i] : columns16_[i];
+  }
+
+  template <typename ColumnIndex, typename ValueIndex>
+  void AddProductImpl(const ColumnIndex* columns,
+                      const ValueIndex* value_indices, const double* x,
+                      double scale, double* y) const;
+
+  std::vector<double> distinct_values_;
+  // Indices into distinct_values_.  Only one of the two is nonempty, unless
+  // the matrix has no elements.
+  std::vector<uint16_t> value_indices16_;
+  std::vector<uint32_t> value_indices32_;
+  // Column indices.  Only one of the two is nonempty, unless the matrix has no
+  // elements.
+  std::vector<uint16_t> columns16_;
+  std::vector<uint32_t> columns32_;
+  std::vector<uint32_t> row_starts_;
 };
 
 // Returns the base-2 logarithm of the given integer.
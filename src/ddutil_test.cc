@@ -930,6 +930,64 @@ TEST(SparseMatrixTest, IteratesOverElements) {
   EXPECT_TRUE(i == m.end());
 }
 
+TEST(SparseMatrixTest, AddsProduct) {
+  const SparseMatrix m({5, 8, 3, 6}, {0, 1, 2, 1}, {0, 0, 2, 3, 4});
+  const std::vector<double> x = {1, 2, 3};
+  std::vector<double> y = {1, 1, 1, 1};
+  m.AddProduct(x.data(), 2, y.data());
+  EXPECT_EQ(std::vector<double>({1, 43, 19, 25}), y);
+}
+
+TEST(SparseMatrixTest, StoresDistinctValuesOnce) {
+  const SparseMatrix m({2, 3, 2, 2}, {0, 1, 2, 1}, {0, 2, 4});
+  EXPECT_EQ(2U, m.row_count());
+  EXPECT_EQ(4U, m.element_count());
+  EXPECT_EQ(2U, m.distinct_value_count());
+  EXPECT_EQ(2 * sizeof(double) + 4 * 2 * sizeof(uint16_t) +
+                3 * sizeof(uint32_t),
+            m.memory_usage());
+  std::vector<double> values;
+  for (auto element : m) {
+    values.push_back(element.value());
+  }
+  EXPECT_EQ(std::vector<double>({2, 3, 2, 2}), values);
+}
+
+TEST(SparseMatrixTest, HandlesWideIndices) {
+  const size_t n = 70000;
+  std::vector<double> values;
+  std::vector<size_t> columns;
+  for (size_t i = 0; i < n; ++i) {
+    values.push_back(i + 0.5);
+    columns.push_back(n - i);
+  }
+  const SparseMatrix m(values, columns, {0, n / 2, n});
+  EXPECT_EQ(n, m.distinct_value_count());
+  auto i = m.begin();
+  for (size_t j = 0; j < n / 2 + 1; ++j) {
+    ++i;
+  }
+  const auto e = *i;
+  EXPECT_EQ(n / 2 + 1.5, e.value());
+  EXPECT_EQ(1U, e.row());
+  EXPECT_EQ(n / 2 - 1, e.column());
+  const std::vector<double> x(n + 1, 1);
+  std::vector<double> y(2, 0);
+  m.AddProduct(x.data(), 1, y.data());
+  EXPECT_EQ(std::vector<double>({n / 2 * (n / 2) / 2.0,
+                                 n / 2 * (n / 2 + n) / 2.0}),
+            y);
+}
+
+TEST(SparseMatrixTest, HandlesEmptyMatrix) {
+  const SparseMatrix m({}, {}, {0, 0, 0});
+  EXPECT_EQ(2U, m.row_count());
+  EXPECT_TRUE(m.begin() == m.end());
+  std::vector<double> y = {1, 2};
+  m.AddProduct(nullptr, 1, y.data());
+  EXPECT_EQ(std::vector<double>({1, 2}), y);
+}
+
 TEST(Log2Test, All) {
   EXPECT_EQ(0, Log2(1));
   EXPECT_EQ(1, Log2(2));
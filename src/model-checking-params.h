@@ -23,13 +23,20 @@
 #define MODEL_CHECKING_PARAMS_H_
 
 // Model checking eninges.
-enum class ModelCheckingEngine { SAMPLING, HYBRID, MIXED };
+enum class ModelCheckingEngine { SAMPLING, HYBRID, MIXED, SPARSE };
 
 // Hypothesis testing algorithms.
-enum class ThresholdAlgorithm { FIXED, SSP, SPRT, CHOW_ROBBINS };
+enum class ThresholdAlgorithm {
+  FIXED,
+  SSP,
+  SPRT,
+  CHOW_ROBBINS,
+  BAYES_FACTOR,
+  BAYESIAN_INTERVAL
+};
 
 // Estimation algorithm.
-enum class EstimationAlgorithm { FIXED, CHOW_ROBBINS };
+enum class EstimationAlgorithm { FIXED, CHOW_ROBBINS, BAYESIAN_INTERVAL };
 
 // Model checking parameters.
 struct ModelCheckingParams {
@@ -44,7 +51,18 @@ struct ModelCheckingParams {
   int fixed_sample_size;
   int max_path_length;
   double nested_error;
+  // Whether to derive the nested error and the error bounds of conjunction,
+  // disjunction, and equivalence operands from expected sample sizes.
+  bool optimize_errors;
   bool memoization;
+  bool shared_paths;
+  int nested_batch_size;
+  // Number of paths that each worker thread samples per result, with the
+  // sequential test only applied to complete groups.
+  int group_size;
+  // Parameters of the Beta prior used by Bayesian algorithms.
+  double prior_a;
+  double prior_b;
 };
 
 #endif  // MODEL_CHECKING_PARAMS_H_
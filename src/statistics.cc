@@ -21,6 +21,14 @@
 
 #include <algorithm>
 #include <cmath>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
 
 int binoinv(double y, int n, double p) {
   CHECK_LE(0, y);
@@ -88,13 +96,206 @@ int binoinv(double y, int n, double p) {
 
 double MaxNestedError(double delta) { return delta / (0.5 + delta); }
 
+std::pair<double, double> NestedIndifferenceRegion(double theta, double delta,
+                                                   double nested_error) {
+  return {std::min(1.0, (theta + delta) * (1.0 - nested_error)),
+          std::max(0.0, 1.0 - (1.0 - (theta - delta)) * (1.0 - nested_error))};
+}
+
+namespace {
+
+// Returns the Kullback-Leibler divergence of Bernoulli(q) from Bernoulli(p).
+double BernoulliDivergence(double p, double q) {
+  double result = 0.0;
+  if (p > 0.0) {
+    result += p * log(p / q);
+  }
+  if (p < 1.0) {
+    result += (1.0 - p) * log((1.0 - p) / (1.0 - q));
+  }
+  return result;
+}
+
+}  // namespace
+
+double SprtExpectedSampleSize(double theta0, double theta1, double alpha,
+                              double beta) {
+  const double log_a = log((1 - beta) / alpha);
+  const double log_b = log((1 - alpha) / beta);
+  const double n0 = ((1 - alpha) * log_b - alpha * log_a) /
+                    BernoulliDivergence(theta0, theta1);
+  const double n1 = ((1 - beta) * log_a - beta * log_b) /
+                    BernoulliDivergence(theta1, theta0);
+  return std::max({1.0, n0, n1});
+}
+
+namespace {
+
+// Returns log(p * exp(h * z1) + (1 - p) * exp(h * z0)).
+double LogMoment(double p, double z1, double z0, double h) {
+  const double x1 = log(p) + h * z1;
+  const double x0 = log(1 - p) + h * z0;
+  const double x = std::max(x1, x0);
+  return x + log(exp(x1 - x) + exp(x0 - x));
+}
+
+}  // namespace
+
+double SprtExpectedSampleSize(double theta0, double theta1, double alpha,
+                              double beta, double p) {
+  CHECK_GT(theta0, theta1);
+  // Log-likelihood ratio of H1 against H0 for a positive and a negative
+  // observation, and the thresholds for accepting H1 and H0.
+  const double z1 = log(theta1 / theta0);
+  const double z0 = log((1 - theta1) / (1 - theta0));
+  const double a = log((1 - beta) / alpha);
+  const double b = log(beta / (1 - alpha));
+  if (std::isinf(z1) && std::isinf(z0)) {
+    return 1;
+  } else if (std::isinf(z1) || p == 0) {
+    // Stops at the first positive observation, or after k negative ones.  If
+    // z0 is infinite too, the first observation always stops the test.
+    const double k = ceil(a / z0);
+    return std::max(1.0, (p > 0) ? (1 - pow(1 - p, k)) / p : k);
+  } else if (std::isinf(z0) || p == 1) {
+    // Stops at the first negative observation, or after k positive ones.
+    const double k = ceil(b / z1);
+    return std::max(1.0, (p < 1) ? (1 - pow(p, k)) / (1 - p) : k);
+  }
+  const double drift = p * z1 + (1 - p) * z0;
+  if (fabs(drift) < 1e-12) {
+    return -a * b / (p * z1 * z1 + (1 - p) * z0 * z0);
+  }
+  // Finds the nonzero root h of LogMoment, which has the opposite sign of the
+  // drift, to get the probability of accepting H0.
+  double low = 0.0;
+  double high = (drift < 0) ? 1.0 : -1.0;
+  while (LogMoment(p, z1, z0, high) < 0) {
+    high *= 2;
+  }
+  for (int i = 0; i < 100; ++i) {
+    const double h = 0.5 * (low + high);
+    if (LogMoment(p, z1, z0, h) < 0) {
+      low = h;
+    } else {
+      high = h;
+    }
+  }
+  const double h = 0.5 * (low + high);
+  const double accept_h0 =
+      (h > 0) ? -expm1(-h * a) / -expm1(h * (b - a))
+              : (exp(h * (a - b)) - exp(-h * b)) / expm1(h * (a - b));
+  return std::max(1.0, (accept_h0 * b + (1 - accept_h0) * a) / drift);
+}
+
+double ChowRobbinsExpectedSampleSize(double theta0, double theta1, double alpha,
+                                     double variance) {
+  // Solves 1/n + variance = n * delta^2 / a^2 for n.
+  const double delta = 0.5 * (theta0 - theta1);
+  const double a = gsl_cdf_ugaussian_Pinv(1 - 0.5 * alpha);
+  const double c = delta * delta / a / a;
+  return (variance + sqrt(variance * variance + 4 * c)) / (2 * c);
+}
+
+std::pair<double, double> AnytimeConfidenceInterval(int count, double mean,
+                                                    double alpha) {
+  if (count <= 0) {
+    return {0.0, 1.0};
+  }
+  const double n = count;
+  const double half_width = sqrt(log(2 * n * (n + 1) / alpha) / (2 * n));
+  return {std::max(0.0, mean - half_width), std::min(1.0, mean + half_width)};
+}
+
+int DkwSampleSize(double alpha, double epsilon) {
+  return std::max(1.0, ceil(log(2 / alpha) / (2 * epsilon * epsilon)));
+}
+
+double DkwBandWidth(int count, double alpha) {
+  return sqrt(log(2 / alpha) / (2 * count));
+}
+
+double OptimalNestedError(double theta, double delta, double alpha,
+                          double beta) {
+  constexpr int kSteps = 100;
+  const double max_nested_error = MaxNestedError(delta);
+  double best_nested_error = 0.0;
+  double best_cost = std::numeric_limits<double>::infinity();
+  for (int i = 1; i < kSteps; ++i) {
+    const double nested_error = max_nested_error * i / kSteps;
+    const auto region = NestedIndifferenceRegion(theta, delta, nested_error);
+    if (region.first <= region.second) {
+      continue;
+    }
+    const double cost =
+        SprtExpectedSampleSize(region.first, region.second, alpha, beta) *
+        (1 + SprtExpectedSampleSize(0.5 + delta, 0.5 - delta, nested_error,
+                                    nested_error));
+    if (cost < best_cost) {
+      best_cost = cost;
+      best_nested_error = nested_error;
+    }
+  }
+  CHECK_GT(best_nested_error, 0);
+  return best_nested_error;
+}
+
+std::vector<double> AllocateError(double error,
+                                  const std::vector<double>& costs) {
+  double total_cost = 0.0;
+  for (double cost : costs) {
+    CHECK_LE(0, cost);
+    total_cost += cost;
+  }
+  std::vector<double> errors;
+  for (double cost : costs) {
+    errors.push_back((total_cost > 0) ? error * cost / total_cost
+                                      : error / costs.size());
+  }
+  return errors;
+}
+
 SingleSamplingPlan::SingleSamplingPlan(int n, int c) : n_(n), c_(c) {
   CHECK_LE(0, c_);
   CHECK_LE(c_, n_);
 }
 
+namespace {
+
+using PlanKey = std::tuple<double, double, double, double>;
+
+// Process-wide memo table of single sampling plans, shared by all threads.
+struct PlanTable {
+  std::mutex mutex;
+  std::map<PlanKey, std::pair<int, int>> plans;
+};
+
+PlanTable& GetPlanTable() {
+  static PlanTable* const table = new PlanTable();
+  return *table;
+}
+
+}  // namespace
+
 SingleSamplingPlan SingleSamplingPlan::Create(double theta0, double theta1,
                                               double alpha, double beta) {
+  const PlanKey key(theta0, theta1, alpha, beta);
+  PlanTable& table = GetPlanTable();
+  {
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto i = table.plans.find(key);
+    if (i != table.plans.end()) {
+      return SingleSamplingPlan(i->second.first, i->second.second);
+    }
+  }
+  const SingleSamplingPlan ssp = Compute(theta0, theta1, alpha, beta);
+  std::lock_guard<std::mutex> lock(table.mutex);
+  table.plans.insert({key, {ssp.n(), ssp.c()}});
+  return ssp;
+}
+
+SingleSamplingPlan SingleSamplingPlan::Compute(double theta0, double theta1,
+                                               double alpha, double beta) {
   CHECK_LE(0, theta1);
   CHECK_LT(theta1, theta0);
   CHECK_LE(theta0, 1);
@@ -112,18 +313,56 @@ SingleSamplingPlan SingleSamplingPlan::Create(double theta0, double theta1,
     const int n = ceil(log(beta) / log(theta1));
     return SingleSamplingPlan(n, n - 1);
   }
-  int n = 0;
-  int c0 = -1;
-  int c1 = 0;
-  while (c0 < c1) {
-    ++n;
+  // We want the smallest n such that c0 >= c1.  Both c0 and c1 grow by at
+  // most one when n grows by one, so if c0 < c1 for some n, then c0 < c1 for
+  // all n' < n + c1 - c0 as well.  Skipping ahead by c1 - c0 therefore finds
+  // the same plan as trying every n, with far fewer calls to binoinv.
+  int n = 1;
+  int c0, c1;
+  while (true) {
     c0 = n - binoinv(1 - alpha, n, 1 - theta0) - 1;
     c1 = binoinv(1 - beta, n, theta1);
     VLOG(1) << n << '\t' << c0 << '\t' << c1;
+    if (c0 >= c1) {
+      break;
+    }
+    n += c1 - c0;
   }
   return SingleSamplingPlan(n, (c0 + c1) / 2);
 }
 
+void SingleSamplingPlan::SavePlans(std::ostream* out) {
+  PlanTable& table = GetPlanTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  const std::streamsize precision =
+      out->precision(std::numeric_limits<double>::max_digits10);
+  for (const auto& entry : table.plans) {
+    *out << std::get<0>(entry.first) << ' ' << std::get<1>(entry.first) << ' '
+         << std::get<2>(entry.first) << ' ' << std::get<3>(entry.first) << ' '
+         << entry.second.first << ' ' << entry.second.second << std::endl;
+  }
+  out->precision(precision);
+}
+
+bool SingleSamplingPlan::LoadPlans(std::istream* in) {
+  std::map<PlanKey, std::pair<int, int>> plans;
+  std::string line;
+  while (std::getline(*in, line)) {
+    std::istringstream fields(line);
+    double theta0, theta1, alpha, beta;
+    int n, c;
+    if (!(fields >> theta0 >> theta1 >> alpha >> beta >> n >> c) ||
+        !(fields >> std::ws).eof() || c < 0 || n < c) {
+      return false;
+    }
+    plans.insert({PlanKey(theta0, theta1, alpha, beta), {n, c}});
+  }
+  PlanTable& table = GetPlanTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  table.plans.insert(plans.begin(), plans.end());
+  return true;
+}
+
 SingleSamplingBernoulliTester::SingleSamplingBernoulliTester(double theta0,
                                                              double theta1,
                                                              double alpha,
@@ -159,6 +398,15 @@ void SingleSamplingBernoulliTester::UpdateState() {
   }
 }
 
+int SingleSamplingBernoulliTester::EstimatedRemainingObservations() const {
+  // The number of observations needed to reach either threshold if all
+  // further observations move the state towards it.
+  const int state = sample().sum();
+  return std::max(0, std::min(SingleSamplingAcceptThreshold(ssp_) - state,
+                              state - SingleSamplingRejectThreshold(sample(),
+                                                                    ssp_)));
+}
+
 std::string SingleSamplingBernoulliTester::StateToStringImpl() const {
   const int state = sample().sum();
   return StrCat(sample().count(), '\t', state, '\t',
@@ -225,6 +473,20 @@ void SprtBernoulliTester::UpdateState() {
   }
 }
 
+int SprtBernoulliTester::EstimatedRemainingObservations() const {
+  // The number of observations needed to reach either threshold if all
+  // further observations move the state towards it.
+  const double state = State();
+  const double n = std::min(ceil((state - accept_threshold_) /
+                                 -positive_coefficient_),
+                            ceil((reject_threshold_ - state) /
+                                 negative_coefficient_));
+  if (!(n < std::numeric_limits<int>::max())) {
+    return std::numeric_limits<int>::max();
+  }
+  return std::max(1, static_cast<int>(n));
+}
+
 std::string SprtBernoulliTester::StateToStringImpl() const {
   return StrCat(sample().count(), '\t', State(), '\t', accept_threshold_, '\t',
                 reject_threshold_);
@@ -243,6 +505,59 @@ double SprtBernoulliTester::State() const {
 
 namespace {
 
+// Returns the logarithm of the odds of mu >= theta for a Beta(a, b)
+// distribution.
+double LogOddsAtLeast(double theta, double a, double b) {
+  return log(gsl_cdf_beta_Q(theta, a, b)) - log(gsl_cdf_beta_P(theta, a, b));
+}
+
+}  // namespace
+
+BayesFactorBernoulliTester::BayesFactorBernoulliTester(double theta0,
+                                                       double theta1,
+                                                       double alpha,
+                                                       double beta,
+                                                       double prior_a,
+                                                       double prior_b)
+    : SequentialTester<bool>(theta0, theta1),
+      theta_(0.5 * (theta0 + theta1)),
+      prior_a_(prior_a),
+      prior_b_(prior_b),
+      log_prior_odds_(LogOddsAtLeast(theta_, prior_a, prior_b)),
+      accept_threshold_(log(1 - alpha) - log(beta)),
+      reject_threshold_(log(alpha) - log(1 - beta)) {
+  CHECK_NE(theta0, theta1);
+  CHECK_LT(0, prior_a);
+  CHECK_LT(0, prior_b);
+}
+
+void BayesFactorBernoulliTester::UpdateState() {
+  const double state = State();
+  if (state >= accept_threshold_) {
+    done_ = true;
+    accept_ = true;
+  } else if (state <= reject_threshold_) {
+    done_ = true;
+    accept_ = false;
+  } else {
+    done_ = false;
+  }
+}
+
+std::string BayesFactorBernoulliTester::StateToStringImpl() const {
+  return StrCat(sample().count(), '\t', State(), '\t', accept_threshold_, '\t',
+                reject_threshold_);
+}
+
+double BayesFactorBernoulliTester::State() const {
+  // The Bayes factor is the posterior odds of H0 divided by its prior odds.
+  return LogOddsAtLeast(theta_, sample().sum() + prior_a_,
+                        sample().count() - sample().sum() + prior_b_) -
+         log_prior_odds_;
+}
+
+namespace {
+
 double LaiIFunctionBernoulli(double theta_tilde, double theta) {
   double result = 0.0;
   if (theta_tilde > 0.0) {
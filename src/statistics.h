@@ -24,10 +24,15 @@
 
 #include <algorithm>
 #include <cmath>
+#include <istream>
 #include <limits>
 #include <map>
+#include <ostream>
+#include <sstream>
 #include <string>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "strutil.h"
 
@@ -44,18 +49,84 @@ int binoinv(double y, int n, double p);
 // width 2*delta.
 double MaxNestedError(double delta);
 
+// Returns the indifference region (theta0, theta1) for testing threshold theta
+// with an indifference region of width 2*delta, when observations are
+// subject to the given nested error.
+std::pair<double, double> NestedIndifferenceRegion(double theta, double delta,
+                                                   double nested_error);
+
+// Returns Wald's approximation of the expected sample size of the SPRT with
+// the given parameters, taking the larger of the values at theta0 and theta1.
+double SprtExpectedSampleSize(double theta0, double theta1, double alpha,
+                              double beta);
+
+// Returns Wald's approximation of the expected sample size of the SPRT with
+// the given parameters for Bernoulli observations with mean p.
+double SprtExpectedSampleSize(double theta0, double theta1, double alpha,
+                              double beta, double p);
+
+// Returns the sample size of the Chow-Robbins test with the given parameters
+// for observations with the given variance.  Uses the normal approximation of
+// the t distribution.
+double ChowRobbinsExpectedSampleSize(double theta0, double theta1, double alpha,
+                                     double variance);
+
+// Returns a confidence interval for the mean of observations in [0, 1], given
+// the mean of the first count observations, that holds with probability at
+// least 1 - alpha simultaneously for all count.  Uses Hoeffding's inequality
+// with error alpha / (count * (count + 1)) at each sample size.
+std::pair<double, double> AnytimeConfidenceInterval(int count, double mean,
+                                                    double alpha);
+
+// Returns the number of observations for which the empirical distribution
+// function is within epsilon of the true distribution function at all points
+// with probability at least 1 - alpha, by the Dvoretzky-Kiefer-Wolfowitz
+// inequality with Massart's constant.
+int DkwSampleSize(double alpha, double epsilon);
+
+// Returns the half-width of the confidence band with coverage 1 - alpha for
+// the empirical distribution function of count observations.
+double DkwBandWidth(int count, double alpha);
+
+// Returns the nested error that minimizes the expected number of sampled
+// paths for a test of threshold theta with error bounds alpha and beta, whose
+// observations come from nested tests with the same delta.  The expected
+// sample sizes are taken from SprtExpectedSampleSize, with the nested tests
+// assumed to have threshold 0.5 and no further nesting.
+double OptimalNestedError(double theta, double delta, double alpha,
+                          double beta);
+
+// Splits error among operands in proportion to their costs, which minimizes
+// the sum of costs * log(1 / error) over the operands.  Splits error evenly if
+// all costs are zero.
+std::vector<double> AllocateError(double error,
+                                  const std::vector<double>& costs);
+
 // A single sampling plan.
 class SingleSamplingPlan {
  public:
+  // Returns the plan for the given parameters.  Plans are memoized in a
+  // process-wide table that is safe to use from multiple threads.
   static SingleSamplingPlan Create(double theta0, double theta1, double alpha,
                                    double beta);
 
+  // Writes all memoized plans to out, one plan per line.
+  static void SavePlans(std::ostream* out);
+
+  // Adds the plans in in, as written by SavePlans, to the memoized plans.
+  // Returns false if the input is malformed, in which case no plans are
+  // added.
+  static bool LoadPlans(std::istream* in);
+
   int n() const { return n_; }
   int c() const { return c_; }
 
  private:
   SingleSamplingPlan(int n, int c);
 
+  static SingleSamplingPlan Compute(double theta0, double theta1, double alpha,
+                                    double beta);
+
   int n_;
   int c_;
 };
@@ -87,7 +158,26 @@ class Sample {
     return (count_ > 1) ? m2_ / (count_ - 1) : 0.0;
   }
   double sample_stddev() const { return sqrt(sample_variance()); }
-  const std::map<int, int>& distribution() const { return distribution_; }
+  // Returns the number of observations in each log2 bucket, indexed by bucket.
+  // Bucket 0 holds observations below 1, and bucket p > 0 holds observations
+  // in [2^(p-1), 2^p).
+  const std::vector<int>& histogram() const { return histogram_; }
+  // Returns the number of NaN and infinite observations, which have no log2
+  // bucket.
+  int nonfinite_count() const { return nonfinite_count_; }
+  // Returns the non-empty buckets of histogram() as a map from bucket to count,
+  // with nonfinite_count() under kNonFiniteBucket if it is nonzero.
+  std::map<int, int> distribution() const;
+
+  static constexpr int kNonFiniteBucket = -1;
+
+  // Writes the sample to out on a single line, in a form that Load reads back
+  // exactly.
+  void Save(std::ostream* out) const;
+  // Replaces this sample with one written by Save, read from the next line of
+  // in.  Returns false, leaving this sample unchanged, if the line is
+  // malformed.
+  bool Load(std::istream* in);
 
  private:
   bool populate_distribution_;
@@ -97,7 +187,8 @@ class Sample {
   int count_;
   double mean_;
   double m2_;
-  std::map<int, int> distribution_;
+  std::vector<int> histogram_;
+  int nonfinite_count_;
 };
 
 // An abstract sequential hypothesis tester.  Tests the hypothesis H0: mu >
@@ -114,6 +205,10 @@ class SequentialTester {
   virtual ~SequentialTester();
 
   void AddObservation(T x);
+  // Adds a group of observations at once.  The stopping rule is only applied
+  // to the combined sample, as in a group-sequential test.
+  template <typename U>
+  void AddObservations(const Sample<U>& group);
   void SetSample(const Sample<T>& sample);
 
   double theta0() const { return theta0_; }
@@ -122,6 +217,20 @@ class SequentialTester {
   bool accept() const { return accept_; }
   const Sample<T>& sample() const { return sample_; }
 
+  // Returns the estimate of mu given the current sample.
+  virtual double Estimate() const;
+
+  // Returns an estimate of the number of additional observations needed
+  // before done() becomes true, or std::numeric_limits<int>::max() if the
+  // tester has no estimate.  Testers err on the low side where they can, so
+  // that the estimate can be used to limit sampling ahead of the test.
+  virtual int EstimatedRemainingObservations() const;
+
+  // Returns the log-likelihood ratio that the test compares against its
+  // thresholds, or NaN if the test is not based on one.  For Bayesian tests,
+  // this is the logarithm of the Bayes factor.
+  virtual double LogLikelihoodRatio() const;
+
   std::string StateToString() const;
 
  protected:
@@ -149,6 +258,8 @@ class FixedSampleSizeTester : public SequentialTester<T> {
  public:
   FixedSampleSizeTester(double theta0, double theta1, int sample_size);
 
+  int EstimatedRemainingObservations() const override;
+
  private:
   void UpdateState() override;
   std::string StateToStringImpl() const override;
@@ -172,6 +283,8 @@ class ChowRobbinsTester : public SequentialTester<T> {
   // (theta0 - theta1) with coverage probability 1 - alpha.
   ChowRobbinsTester(double theta0, double theta1, double alpha);
 
+  int EstimatedRemainingObservations() const override;
+
  private:
   void UpdateState() override;
   std::string StateToStringImpl() const override;
@@ -191,6 +304,8 @@ class SingleSamplingBernoulliTester : public SequentialTester<bool> {
   SingleSamplingBernoulliTester(double theta0, double theta1, double alpha,
                                 double beta);
 
+  int EstimatedRemainingObservations() const override;
+
  private:
   void UpdateState() override;
   std::string StateToStringImpl() const override;
@@ -209,6 +324,9 @@ class SprtBernoulliTester : public SequentialTester<bool> {
  public:
   SprtBernoulliTester(double theta0, double theta1, double alpha, double beta);
 
+  int EstimatedRemainingObservations() const override;
+  double LogLikelihoodRatio() const override { return State(); }
+
  private:
   void UpdateState() override;
   std::string StateToStringImpl() const override;
@@ -244,13 +362,82 @@ class LaiBernoulliTester : public SequentialTester<bool> {
   double c_;
 };
 
+// A SequentialTester that uses the Bayes factor of H0 against H1 for
+// Bernoulli trials with a Beta prior on mu:
+//
+// Jha, Sumit K., Edmund M. Clarke, Christopher J. Langmead, Axel Legay, Andre
+// Platzer, and Paolo Zuliani.  2009.  A Bayesian approach to model checking
+// biological systems.  In Proc. 7th International Conference on Computational
+// Methods in Systems Biology, 218-234.
+//
+// Here, H0 is mu >= theta and H1 is mu < theta, with theta being the midpoint
+// of the indifference region.  Accepts H0 once the Bayes factor reaches
+// (1 - alpha) / beta, and accepts H1 once it drops to alpha / (1 - beta), as
+// with the SPRT.  Does not allow theta0 == theta1.
+class BayesFactorBernoulliTester : public SequentialTester<bool> {
+ public:
+  BayesFactorBernoulliTester(double theta0, double theta1, double alpha,
+                             double beta, double prior_a, double prior_b);
+
+  double LogLikelihoodRatio() const override { return State(); }
+
+ private:
+  void UpdateState() override;
+  std::string StateToStringImpl() const override;
+
+  // Returns the logarithm of the Bayes factor.
+  double State() const;
+
+  const double theta_;
+  const double prior_a_;
+  const double prior_b_;
+  const double log_prior_odds_;
+  const double accept_threshold_;
+  const double reject_threshold_;
+};
+
+// A SequentialTester that uses Bayesian interval estimation for Bernoulli
+// trials with a Beta prior on mu:
+//
+// Zuliani, Paolo, Andre Platzer, and Edmund M. Clarke.  2010.  Bayesian
+// statistical model checking with application to Simulink/Stateflow
+// verification.  In Proc. 13th ACM International Conference on Hybrid Systems:
+// Computation and Control, 243-252.
+//
+// Stops once the posterior probability of an interval of width (theta0 -
+// theta1) around the posterior mean is at least 1 - alpha.  Accepts H0 if the
+// posterior mean is greater than 0.5 * (theta0 + theta1).  Observations must
+// be 0 or 1.  Does not allow theta0 == theta1.
+template <typename T>
+class BayesianIntervalTester : public SequentialTester<T> {
+ public:
+  BayesianIntervalTester(double theta0, double theta1, double alpha,
+                         double prior_a, double prior_b);
+
+  double Estimate() const override;
+
+ private:
+  void UpdateState() override;
+  std::string StateToStringImpl() const override;
+
+  // Returns the posterior probability of the interval around Estimate().
+  double State() const;
+
+  const double coverage_;
+  const double prior_a_;
+  const double prior_b_;
+};
+
 template <typename T>
 Sample<T>::Sample(bool populate_distribution)
     : populate_distribution_(populate_distribution),
+      min_(),
+      max_(),
       sum_(0),
       count_(0),
       mean_(0.0),
-      m2_(0.0) {}
+      m2_(0.0),
+      nonfinite_count_(0) {}
 
 template <typename T>
 template <typename U>
@@ -262,7 +449,8 @@ Sample<T>::Sample(const Sample<U>& sample)
       count_(sample.count()),
       mean_(sample.mean()),
       m2_(sample.variance() * sample.count()),
-      distribution_(sample.distribution()) {}
+      histogram_(sample.histogram()),
+      nonfinite_count_(sample.nonfinite_count()) {}
 
 template <typename T>
 void Sample<T>::AddObservation(T x) {
@@ -274,13 +462,23 @@ void Sample<T>::AddObservation(T x) {
   mean_ += delta / count_;
   m2_ += delta * (x - mean_);
   if (populate_distribution_) {
-    ++distribution_[(x < 1) ? 0 : static_cast<int>(floor(log2(x))) + 1];
+    if (!std::isfinite(static_cast<double>(x))) {
+      ++nonfinite_count_;
+    } else {
+      const size_t bucket =
+          (x < 1) ? 0 : static_cast<int>(floor(log2(x))) + 1;
+      if (bucket >= histogram_.size()) {
+        histogram_.resize(bucket + 1);
+      }
+      ++histogram_[bucket];
+    }
   }
 }
 
 template <typename T>
 template <typename U>
 void Sample<T>::MergeFrom(const Sample<U>& sample) {
+  const double sample_m2 = sample.variance() * sample.count();
   if (count_ > 0 && sample.count() > 0) {
     min_ = std::min(min_, sample.min());
     max_ = std::max(max_, sample.max());
@@ -288,25 +486,83 @@ void Sample<T>::MergeFrom(const Sample<U>& sample) {
     mean_ += delta / (count_ + sample.count());
     const double delta2 =
         count_ * sample.sum() * sample.mean() - sum_ * (sample.sum() + delta);
-    m2_ += sample.m2_ + delta2 / (count_ + sample.count());
+    m2_ += sample_m2 + delta2 / (count_ + sample.count());
     count_ += sample.count();
     sum_ += sample.sum();
-    if (populate_distribution_) {
-      for (const auto& entry : sample.distribution()) {
-        distribution_[entry.first] += entry.second;
-      }
-    }
   } else if (sample.count() > 0) {
     min_ = sample.min();
     max_ = sample.max();
     mean_ = sample.mean();
-    m2_ = sample.m2_;
+    m2_ = sample_m2;
     count_ = sample.count();
-    sum_ = sample.count();
-    if (populate_distribution_) {
-      distribution_ = sample.distribution();
+    sum_ = sample.sum();
+  }
+  if (populate_distribution_) {
+    const std::vector<int>& histogram = sample.histogram();
+    if (histogram.size() > histogram_.size()) {
+      histogram_.resize(histogram.size());
+    }
+    for (size_t i = 0; i < histogram.size(); ++i) {
+      histogram_[i] += histogram[i];
+    }
+    nonfinite_count_ += sample.nonfinite_count();
+  }
+}
+
+template <typename T>
+void Sample<T>::Save(std::ostream* out) const {
+  const auto precision =
+      out->precision(std::numeric_limits<double>::max_digits10);
+  *out << populate_distribution_ << ' ' << min_ << ' ' << max_ << ' ' << sum_
+       << ' ' << count_ << ' ' << mean_ << ' ' << m2_ << ' '
+       << histogram_.size();
+  for (int n : histogram_) {
+    *out << ' ' << n;
+  }
+  *out << ' ' << nonfinite_count_ << '\n';
+  out->precision(precision);
+}
+
+template <typename T>
+bool Sample<T>::Load(std::istream* in) {
+  std::string line;
+  if (!std::getline(*in, line)) {
+    return false;
+  }
+  std::istringstream fields(line);
+  Sample<T> sample;
+  size_t bucket_count;
+  if (!(fields >> sample.populate_distribution_ >> sample.min_ >>
+        sample.max_ >> sample.sum_ >> sample.count_ >> sample.mean_ >>
+        sample.m2_ >> bucket_count) ||
+      sample.count_ < 0 || bucket_count > line.size()) {
+    return false;
+  }
+  sample.histogram_.resize(bucket_count);
+  for (int& n : sample.histogram_) {
+    if (!(fields >> n)) {
+      return false;
+    }
+  }
+  if (!(fields >> sample.nonfinite_count_) || !(fields >> std::ws).eof()) {
+    return false;
+  }
+  *this = std::move(sample);
+  return true;
+}
+
+template <typename T>
+std::map<int, int> Sample<T>::distribution() const {
+  std::map<int, int> distribution;
+  for (size_t i = 0; i < histogram_.size(); ++i) {
+    if (histogram_[i] > 0) {
+      distribution.emplace_hint(distribution.end(), i, histogram_[i]);
     }
   }
+  if (nonfinite_count_ > 0) {
+    distribution.emplace(kNonFiniteBucket, nonfinite_count_);
+  }
+  return distribution;
 }
 
 template <typename T>
@@ -324,12 +580,34 @@ void SequentialTester<T>::AddObservation(T x) {
   UpdateState();
 }
 
+template <typename T>
+template <typename U>
+void SequentialTester<T>::AddObservations(const Sample<U>& group) {
+  sample_.MergeFrom(Sample<T>(group));
+  UpdateState();
+}
+
 template <typename T>
 void SequentialTester<T>::SetSample(const Sample<T>& sample) {
   sample_ = sample;
   UpdateState();
 }
 
+template <typename T>
+double SequentialTester<T>::Estimate() const {
+  return sample_.mean();
+}
+
+template <typename T>
+int SequentialTester<T>::EstimatedRemainingObservations() const {
+  return std::numeric_limits<int>::max();
+}
+
+template <typename T>
+double SequentialTester<T>::LogLikelihoodRatio() const {
+  return std::numeric_limits<double>::quiet_NaN();
+}
+
 template <typename T>
 std::string SequentialTester<T>::StateToString() const {
   return StateToStringImpl();
@@ -351,6 +629,11 @@ void FixedSampleSizeTester<T>::UpdateState() {
   }
 }
 
+template <typename T>
+int FixedSampleSizeTester<T>::EstimatedRemainingObservations() const {
+  return std::max(0, sample_size_ - this->sample().count());
+}
+
 template <typename T>
 std::string FixedSampleSizeTester<T>::StateToStringImpl() const {
   return StrCat(this->sample().count(), '\t', this->sample().sum());
@@ -372,6 +655,23 @@ void ChowRobbinsTester<T>::UpdateState() {
   }
 }
 
+template <typename T>
+int ChowRobbinsTester<T>::EstimatedRemainingObservations() const {
+  if (this->sample().count() <= 1) {
+    return std::numeric_limits<int>::max();
+  }
+  // Solves State() <= Bound() for the sample size, assuming that the variance
+  // stays the same.
+  const double delta = 0.5 * (this->theta0() - this->theta1());
+  const double a =
+      gsl_cdf_tdist_Pinv(tdist_quantile_, this->sample().count() - 1);
+  const double n = ceil(State() * a * a / delta / delta);
+  if (n >= std::numeric_limits<int>::max()) {
+    return std::numeric_limits<int>::max();
+  }
+  return std::max(1, static_cast<int>(n) - this->sample().count());
+}
+
 template <typename T>
 std::string ChowRobbinsTester<T>::StateToStringImpl() const {
   return StrCat(this->sample().count(), '\t', State(), '\t', Bound());
@@ -395,4 +695,48 @@ double ChowRobbinsTester<T>::Bound() const {
   return 0;
 }
 
+template <typename T>
+BayesianIntervalTester<T>::BayesianIntervalTester(double theta0, double theta1,
+                                                  double alpha, double prior_a,
+                                                  double prior_b)
+    : SequentialTester<T>(theta0, theta1),
+      coverage_(1 - alpha),
+      prior_a_(prior_a),
+      prior_b_(prior_b) {
+  CHECK_NE(theta0, theta1);
+  CHECK_LT(0, prior_a);
+  CHECK_LT(0, prior_b);
+}
+
+template <typename T>
+double BayesianIntervalTester<T>::Estimate() const {
+  return (this->sample().sum() + prior_a_) /
+         (this->sample().count() + prior_a_ + prior_b_);
+}
+
+template <typename T>
+void BayesianIntervalTester<T>::UpdateState() {
+  CHECK_LE(this->sample().max(), 1)
+      << "Bayesian interval estimation requires Bernoulli observations";
+  this->done_ = (State() >= coverage_);
+  if (this->done_) {
+    this->accept_ = Estimate() > 0.5 * (this->theta0() + this->theta1());
+  }
+}
+
+template <typename T>
+std::string BayesianIntervalTester<T>::StateToStringImpl() const {
+  return StrCat(this->sample().count(), '\t', Estimate(), '\t', State());
+}
+
+template <typename T>
+double BayesianIntervalTester<T>::State() const {
+  const double width = this->theta0() - this->theta1();
+  const double low = std::min(std::max(0.0, Estimate() - 0.5 * width),
+                              1.0 - width);
+  const double a = this->sample().sum() + prior_a_;
+  const double b = this->sample().count() - this->sample().sum() + prior_b_;
+  return gsl_cdf_beta_P(low + width, a, b) - gsl_cdf_beta_P(low, a, b);
+}
+
 #endif  // STATISTICS_H_
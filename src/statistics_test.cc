@@ -21,6 +21,10 @@
 
 #include <cmath>
 #include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -88,6 +92,88 @@ TEST(MaxNestedErrorTest, All) {
   EXPECT_EQ(0.1 / 0.6, MaxNestedError(0.1));
 }
 
+TEST(NestedIndifferenceRegionTest, All) {
+  const auto region1 = NestedIndifferenceRegion(0.5, 0.1, 0.0);
+  EXPECT_DOUBLE_EQ(0.6, region1.first);
+  EXPECT_DOUBLE_EQ(0.4, region1.second);
+
+  const auto region2 = NestedIndifferenceRegion(0.5, 0.1, 0.1);
+  EXPECT_DOUBLE_EQ(0.54, region2.first);
+  EXPECT_DOUBLE_EQ(0.46, region2.second);
+
+  const auto region3 = NestedIndifferenceRegion(0.95, 0.1, 0.0);
+  EXPECT_EQ(1.0, region3.first);
+  EXPECT_DOUBLE_EQ(0.85, region3.second);
+}
+
+TEST(SprtExpectedSampleSizeTest, All) {
+  EXPECT_NEAR(55.53, SprtExpectedSampleSize(0.6, 0.4, 0.01, 0.01), 0.01);
+  EXPECT_NEAR(47.11, SprtExpectedSampleSize(0.6, 0.4, 0.01, 0.1), 0.01);
+  EXPECT_LT(SprtExpectedSampleSize(0.6, 0.4, 0.01, 0.01),
+            SprtExpectedSampleSize(0.55, 0.45, 0.01, 0.01));
+}
+
+TEST(SprtExpectedSampleSizeTest, GivenMean) {
+  EXPECT_NEAR(55.53, SprtExpectedSampleSize(0.6, 0.4, 0.01, 0.01, 0.6), 0.01);
+  EXPECT_NEAR(55.53, SprtExpectedSampleSize(0.6, 0.4, 0.01, 0.01, 0.4), 0.01);
+  EXPECT_NEAR(27.43, SprtExpectedSampleSize(0.6, 0.4, 0.01, 0.1, 0.6), 0.01);
+  EXPECT_NEAR(14.17, SprtExpectedSampleSize(0.6, 0.4, 0.01, 0.01, 0.9), 0.01);
+  EXPECT_NEAR(128.44, SprtExpectedSampleSize(0.6, 0.4, 0.01, 0.01, 0.5),
+              0.01);
+  EXPECT_EQ(12, SprtExpectedSampleSize(0.6, 0.4, 0.01, 0.01, 0.0));
+  EXPECT_EQ(12, SprtExpectedSampleSize(0.6, 0.4, 0.01, 0.01, 1.0));
+  EXPECT_NEAR(17.91, SprtExpectedSampleSize(1.0, 0.9, 0.01, 0.01, 0.95), 0.01);
+  EXPECT_EQ(44, SprtExpectedSampleSize(1.0, 0.9, 0.01, 0.01, 1.0));
+  EXPECT_EQ(1, SprtExpectedSampleSize(1.0, 0.0, 0.01, 0.01, 0.5));
+  EXPECT_EQ(1, SprtExpectedSampleSize(1.0, 0.9, 0.01, 0.01, 0.0));
+  EXPECT_EQ(1, SprtExpectedSampleSize(0.1, 0.0, 0.01, 0.01, 1.0));
+}
+
+TEST(ChowRobbinsExpectedSampleSizeTest, All) {
+  EXPECT_NEAR(99.88, ChowRobbinsExpectedSampleSize(0.6, 0.4, 0.05, 0.25),
+              0.01);
+  EXPECT_NEAR(19.60, ChowRobbinsExpectedSampleSize(0.6, 0.4, 0.05, 0.0), 0.01);
+}
+
+TEST(AnytimeConfidenceIntervalTest, All) {
+  EXPECT_EQ(std::make_pair(0.0, 1.0), AnytimeConfidenceInterval(0, 0.0, 0.01));
+  const auto interval = AnytimeConfidenceInterval(1000, 0.5, 0.01);
+  EXPECT_NEAR(0.5 - 0.0978, interval.first, 1e-4);
+  EXPECT_NEAR(0.5 + 0.0978, interval.second, 1e-4);
+  EXPECT_EQ(1.0, AnytimeConfidenceInterval(1000, 0.99, 0.01).second);
+  EXPECT_LT(AnytimeConfidenceInterval(1000, 0.5, 0.1).second,
+            interval.second);
+}
+
+TEST(DkwTest, All) {
+  EXPECT_EQ(26492, DkwSampleSize(0.01, 0.01));
+  EXPECT_EQ(1, DkwSampleSize(0.5, 1.0));
+  EXPECT_LE(DkwBandWidth(DkwSampleSize(0.01, 0.01), 0.01), 0.01);
+  EXPECT_GT(DkwBandWidth(DkwSampleSize(0.01, 0.01) - 1, 0.01), 0.01);
+}
+
+TEST(OptimalNestedErrorTest, All) {
+  const double nested_error = OptimalNestedError(0.5, 0.01, 0.01, 0.01);
+  EXPECT_LT(0.0, nested_error);
+  EXPECT_GT(MaxNestedError(0.01), nested_error);
+  const auto cost = [](double nested_error) {
+    const auto region = NestedIndifferenceRegion(0.5, 0.01, nested_error);
+    return SprtExpectedSampleSize(region.first, region.second, 0.01, 0.01) *
+           (1 + SprtExpectedSampleSize(0.51, 0.49, nested_error,
+                                       nested_error));
+  };
+  EXPECT_LT(cost(nested_error), cost(0.8 * MaxNestedError(0.01)));
+  EXPECT_LE(cost(nested_error), cost(0.5 * nested_error));
+  EXPECT_LE(cost(nested_error), cost(2 * nested_error));
+}
+
+TEST(AllocateErrorTest, All) {
+  EXPECT_EQ(std::vector<double>({0.0025, 0.0075}),
+            AllocateError(0.01, {1, 3}));
+  EXPECT_EQ(std::vector<double>({0.005, 0.005}), AllocateError(0.01, {0, 0}));
+  EXPECT_EQ(std::vector<double>({0.0, 0.01}), AllocateError(0.01, {0, 2}));
+}
+
 TEST(SingleSamplingPlanTest, All) {
   const auto ssp1 = SingleSamplingPlan::Create(1, 0, 0.01, 0.02);
   EXPECT_EQ(1, ssp1.n());
@@ -112,6 +198,30 @@ TEST(SingleSamplingPlanTest, All) {
   const auto ssp6 = SingleSamplingPlan::Create(0.25, 0, 0.02, 0.01);
   EXPECT_EQ(14, ssp6.n());
   EXPECT_EQ(0, ssp6.c());
+
+  const auto ssp7 = SingleSamplingPlan::Create(0.96, 0.94, 0.01, 0.01);
+  EXPECT_EQ(2546, ssp7.n());
+  EXPECT_EQ(2420, ssp7.c());
+}
+
+TEST(SingleSamplingPlanTest, SaveAndLoadPlans) {
+  SingleSamplingPlan::Create(0.5, 0.3, 0.2, 0.1);
+  std::ostringstream out;
+  SingleSamplingPlan::SavePlans(&out);
+  EXPECT_NE(std::string::npos, out.str().find("0.5 0.29999999999999999 "
+                                              "0.20000000000000001 "
+                                              "0.10000000000000001 30 12\n"));
+
+  std::istringstream in("0.75 0.25 0.125 0.0625 17 9\n");
+  EXPECT_TRUE(SingleSamplingPlan::LoadPlans(&in));
+  const auto ssp = SingleSamplingPlan::Create(0.75, 0.25, 0.125, 0.0625);
+  EXPECT_EQ(17, ssp.n());
+  EXPECT_EQ(9, ssp.c());
+
+  std::istringstream malformed("0.75 0.25 0.125 0.0625 17\n");
+  EXPECT_FALSE(SingleSamplingPlan::LoadPlans(&malformed));
+  std::istringstream invalid("0.7 0.2 0.1 0.1 5 6\n");
+  EXPECT_FALSE(SingleSamplingPlan::LoadPlans(&invalid));
 }
 
 TEST(SampleTest, IntegerObservations) {
@@ -215,6 +325,56 @@ TEST(SampleTest, MergeFromIntegerObservationsWithDistribution) {
   EXPECT_EQ(Dist({{0, 1}, {1, 1}, {2, 2}, {3, 1}}), s1.distribution());
 }
 
+TEST(SampleTest, MergeIntoEmptySample) {
+  Sample<int> s1, s2;
+
+  s2.AddObservation(3);
+  s2.AddObservation(1);
+  s1.MergeFrom(s2);
+  EXPECT_EQ(1, s1.min());
+  EXPECT_EQ(3, s1.max());
+  EXPECT_EQ(4, s1.sum());
+  EXPECT_EQ(2, s1.count());
+  EXPECT_EQ(2, s1.mean());
+  EXPECT_EQ(1, s1.variance());
+  EXPECT_EQ(2, s1.sample_variance());
+}
+
+TEST(SampleTest, MergeShardsWithHistogram) {
+  Sample<int> s1(true), s2(true), s3(true);
+
+  s1.AddObservation(1);
+  s2.AddObservation(8);
+  s2.AddObservation(0);
+  s3.AddObservation(2);
+  s1.MergeFrom(s2);
+  s1.MergeFrom(s3);
+  EXPECT_EQ(0, s1.min());
+  EXPECT_EQ(8, s1.max());
+  EXPECT_EQ(11, s1.sum());
+  EXPECT_EQ(4, s1.count());
+  EXPECT_EQ(std::vector<int>({1, 1, 1, 0, 1}), s1.histogram());
+}
+
+TEST(SampleTest, NonFiniteObservationsWithDistribution) {
+  using Dist = std::map<int, int>;
+  Sample<double> s1(true), s2(true);
+
+  s1.AddObservation(0.0);
+  s1.AddObservation(std::numeric_limits<double>::infinity());
+  s1.AddObservation(std::numeric_limits<double>::quiet_NaN());
+  EXPECT_EQ(std::vector<int>({1}), s1.histogram());
+  EXPECT_EQ(2, s1.nonfinite_count());
+  EXPECT_EQ(Dist({{Sample<double>::kNonFiniteBucket, 2}, {0, 1}}),
+            s1.distribution());
+
+  s2.AddObservation(-std::numeric_limits<double>::infinity());
+  s2.AddObservation(3.0);
+  s1.MergeFrom(s2);
+  EXPECT_EQ(std::vector<int>({1, 0, 1}), s1.histogram());
+  EXPECT_EQ(3, s1.nonfinite_count());
+}
+
 TEST(SampleTest, BoolObservations) {
   Sample<bool> s;
   EXPECT_EQ(0, s.count());
@@ -250,6 +410,54 @@ TEST(SampleTest, BoolObservations) {
   EXPECT_DOUBLE_EQ(sqrt(2.0 / 6.0), s.sample_stddev());
 }
 
+TEST(SampleTest, SaveAndLoad) {
+  Sample<double> s(true);
+  s.AddObservation(0.1);
+  s.AddObservation(5.5);
+  s.AddObservation(2.0 / 3.0);
+  std::stringstream buffer;
+  s.Save(&buffer);
+  Sample<double> t;
+  EXPECT_TRUE(t.Load(&buffer));
+  EXPECT_TRUE(t.populate_distribution());
+  EXPECT_EQ(s.min(), t.min());
+  EXPECT_EQ(s.max(), t.max());
+  EXPECT_EQ(s.sum(), t.sum());
+  EXPECT_EQ(s.count(), t.count());
+  EXPECT_EQ(s.mean(), t.mean());
+  EXPECT_EQ(s.variance(), t.variance());
+  EXPECT_EQ(s.histogram(), t.histogram());
+
+  Sample<bool> b;
+  b.AddObservation(true);
+  b.AddObservation(false);
+  b.Save(&buffer);
+  Sample<bool> c;
+  EXPECT_TRUE(c.Load(&buffer));
+  EXPECT_FALSE(c.min());
+  EXPECT_TRUE(c.max());
+  EXPECT_EQ(1, c.sum());
+  EXPECT_EQ(2, c.count());
+  EXPECT_EQ(0.25, c.variance());
+
+  std::istringstream malformed("0 1 2 3\n");
+  EXPECT_FALSE(c.Load(&malformed));
+  EXPECT_EQ(2, c.count());
+}
+
+TEST(SequentialTesterTest, LogLikelihoodRatio) {
+  SprtBernoulliTester sprt(0.6, 0.4, 0.01, 0.01);
+  EXPECT_EQ(0.0, sprt.LogLikelihoodRatio());
+  sprt.AddObservation(true);
+  sprt.AddObservation(false);
+  EXPECT_DOUBLE_EQ(0.0, sprt.LogLikelihoodRatio());
+  sprt.AddObservation(true);
+  EXPECT_DOUBLE_EQ(-log(1.5), sprt.LogLikelihoodRatio());
+
+  ChowRobbinsTester<bool> chow_robbins(0.6, 0.4, 0.01);
+  EXPECT_TRUE(std::isnan(chow_robbins.LogLikelihoodRatio()));
+}
+
 TEST(ChowRobbinsTesterTest, IntegerObservations) {
   ChowRobbinsTester<int> tester(0.6, 0.4, 0.01);
   EXPECT_EQ(0.6, tester.theta0());
@@ -366,6 +574,19 @@ TEST(SingleSamplingBernoulliTesterTest, RejectsThenAccepts) {
   EXPECT_TRUE(tester.accept());
 }
 
+TEST(SingleSamplingBernoulliTesterTest, EstimatedRemainingObservations) {
+  SingleSamplingBernoulliTester tester(0.5, 0.3, 0.2, 0.1);
+  EXPECT_EQ(13, tester.EstimatedRemainingObservations());
+  for (int i = 0; i < 5; ++i) {
+    tester.AddObservation(false);
+  }
+  EXPECT_EQ(13, tester.EstimatedRemainingObservations());
+  tester.AddObservation(false);
+  EXPECT_EQ(12, tester.EstimatedRemainingObservations());
+  tester.AddObservation(true);
+  EXPECT_EQ(12, tester.EstimatedRemainingObservations());
+}
+
 TEST(SprtBernoulliTesterTest, AcceptsThenRejects) {
   SprtBernoulliTester tester(0.5, 0.3, 0.2, 0.1);
   EXPECT_EQ(0.5, tester.theta0());
@@ -469,4 +690,158 @@ TEST(SprtBernoulliTesterTest, RejectsThenAcceptsWithMinTheta1) {
   EXPECT_TRUE(tester.accept());
 }
 
+TEST(SprtBernoulliTesterTest, AddObservationsInGroups) {
+  SprtBernoulliTester tester(0.5, 0.3, 0.2, 0.1);
+  Sample<double> group;
+  group.AddObservation(1);
+  group.AddObservation(0);
+  group.AddObservation(1);
+  group.AddObservation(1);
+  tester.AddObservations(group);
+  EXPECT_EQ(4, tester.sample().count());
+  EXPECT_EQ(3, tester.sample().sum());
+  EXPECT_FALSE(tester.done());
+  tester.AddObservations(group);
+  EXPECT_EQ(8, tester.sample().count());
+  EXPECT_EQ(6, tester.sample().sum());
+  EXPECT_TRUE(tester.done());
+  EXPECT_TRUE(tester.accept());
+}
+
+// Returns the fraction of the given number of simulated tests, with
+// observations drawn from a Bernoulli distribution with parameter p and added
+// in groups of the given size, that accept the null hypothesis.
+double GroupSprtAcceptanceRate(double theta0, double theta1, double alpha,
+                               double beta, double p, int group_size,
+                               int trials) {
+  std::mt19937_64 engine(17);
+  std::bernoulli_distribution bernoulli(p);
+  int accept_count = 0;
+  for (int trial = 0; trial < trials; ++trial) {
+    SprtBernoulliTester tester(theta0, theta1, alpha, beta);
+    while (!tester.done()) {
+      Sample<double> group;
+      for (int i = 0; i < group_size; ++i) {
+        group.AddObservation(bernoulli(engine) ? 1 : 0);
+      }
+      tester.AddObservations(group);
+    }
+    if (tester.accept()) {
+      ++accept_count;
+    }
+  }
+  return static_cast<double>(accept_count) / trials;
+}
+
+TEST(SprtBernoulliTesterTest, GroupsKeepErrorBounds) {
+  // Checking the stopping rule only at group boundaries can only overshoot
+  // the thresholds, so Wald's bounds alpha/(1-beta) and beta/(1-alpha) on the
+  // error probabilities still hold for any group size.
+  const double alpha = 0.05;
+  const double beta = 0.1;
+  const int kTrials = 10000;
+  for (int group_size : {1, 4, 16}) {
+    SCOPED_TRACE(group_size);
+    EXPECT_LE(1 - GroupSprtAcceptanceRate(0.6, 0.4, alpha, beta, 0.6,
+                                          group_size, kTrials),
+              alpha / (1 - beta));
+    EXPECT_LE(GroupSprtAcceptanceRate(0.6, 0.4, alpha, beta, 0.4, group_size,
+                                      kTrials),
+              beta / (1 - alpha));
+  }
+}
+
+TEST(SprtBernoulliTesterTest, EstimatedRemainingObservations) {
+  SprtBernoulliTester tester(0.5, 0.3, 0.2, 0.1);
+  EXPECT_EQ(5, tester.EstimatedRemainingObservations());
+  const std::vector<bool> observations = {true, false, true, true,
+                                          false, true, true, true};
+  for (size_t i = 0; i < observations.size(); ++i) {
+    EXPECT_LE(tester.EstimatedRemainingObservations(),
+              static_cast<int>(observations.size() - i));
+    tester.AddObservation(observations[i]);
+  }
+  EXPECT_TRUE(tester.done());
+
+  SprtBernoulliTester max_theta0_tester(1, 0.75, 0.01, 0.02);
+  EXPECT_EQ(1, max_theta0_tester.EstimatedRemainingObservations());
+  SprtBernoulliTester min_theta1_tester(0.25, 0, 0.02, 0.01);
+  EXPECT_EQ(1, min_theta1_tester.EstimatedRemainingObservations());
+}
+
+TEST(FixedSampleSizeTesterTest, EstimatedRemainingObservations) {
+  FixedSampleSizeTester<bool> tester(0.5, 0.3, 3);
+  EXPECT_EQ(3, tester.EstimatedRemainingObservations());
+  tester.AddObservation(true);
+  EXPECT_EQ(2, tester.EstimatedRemainingObservations());
+}
+
+TEST(BayesFactorBernoulliTesterTest, AcceptsThenRejects) {
+  BayesFactorBernoulliTester tester(0.5, 0.3, 0.2, 0.1, 1, 1);
+  EXPECT_EQ(0.5, tester.theta0());
+  EXPECT_EQ(0.3, tester.theta1());
+  EXPECT_FALSE(tester.done());
+  tester.AddObservation(true);
+  EXPECT_FALSE(tester.done());
+  tester.AddObservation(true);
+  EXPECT_TRUE(tester.done());
+  EXPECT_TRUE(tester.accept());
+
+  Sample<bool> sample;
+  sample.AddObservation(true);
+  sample.AddObservation(true);
+  sample.AddObservation(false);
+  sample.AddObservation(false);
+  tester.SetSample(sample);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_FALSE(tester.done());
+    tester.AddObservation(false);
+  }
+  EXPECT_TRUE(tester.done());
+  EXPECT_FALSE(tester.accept());
+}
+
+TEST(BayesFactorBernoulliTesterTest, RejectsWithPrior) {
+  BayesFactorBernoulliTester tester(0.5, 0.3, 0.2, 0.1, 2, 8);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_FALSE(tester.done());
+    tester.AddObservation(false);
+  }
+  EXPECT_TRUE(tester.done());
+  EXPECT_FALSE(tester.accept());
+}
+
+TEST(BayesianIntervalTesterTest, AcceptsThenRejects) {
+  BayesianIntervalTester<bool> tester(0.5, 0.3, 0.2, 1, 1);
+  EXPECT_EQ(0.5, tester.theta0());
+  EXPECT_EQ(0.3, tester.theta1());
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_FALSE(tester.done());
+    tester.AddObservation(true);
+  }
+  EXPECT_TRUE(tester.done());
+  EXPECT_TRUE(tester.accept());
+  EXPECT_EQ(0.9, tester.Estimate());
+
+  tester.SetSample(Sample<bool>());
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_FALSE(tester.done());
+    tester.AddObservation(false);
+  }
+  EXPECT_TRUE(tester.done());
+  EXPECT_FALSE(tester.accept());
+  EXPECT_EQ(0.1, tester.Estimate());
+}
+
+TEST(BayesianIntervalTesterTest, Estimation) {
+  BayesianIntervalTester<double> tester(0.55, 0.45, 0.05, 1, 1);
+  int count = 0;
+  while (!tester.done()) {
+    tester.AddObservation(count % 2);
+    ++count;
+  }
+  EXPECT_EQ(381, count);
+  EXPECT_EQ(191.0 / 383.0, tester.Estimate());
+}
+
 }  // namespace
@@ -85,6 +85,9 @@ class UniquePtrVector {
   void push_back(std::unique_ptr<T>&& element) {
     elements_.push_back(std::move(element));
   }
+  void replace(int i, std::unique_ptr<T>&& element) {
+    elements_[i] = std::move(element);
+  }
   void clear() { elements_.clear(); }
 
  private:
@@ -62,16 +62,87 @@ start=$(timestamp)
 HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.005 --threshold-algorithm=ssp src/testdata/poll5.sm <(echo 'P<0.98[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_ssp98.golden -
 expect_ok ${start}
 
+echo -n poll5_bayes96...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.005 --threshold-algorithm=bayes-factor src/testdata/poll5.sm <(echo 'P<0.96[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_bayes96.golden -
+expect_ok ${start}
+
+echo -n poll5_bayesian_estimate...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --estimation-algorithm=bayesian-interval --prior=9,1 src/testdata/poll5.sm <(echo 'P=?[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_bayesian_estimate.golden -
+expect_ok ${start}
+
+echo -n poll5_optimize_errors...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.02 --optimize-errors src/testdata/poll5.sm <(echo 'P>=0.5[ true U<=2 P>=0.5[ F<=1 (s=1 & a=0) ] ] & P<0.96[ F<=10 (s=1 & a=0) ] & P>0.5[ F<=1 s=1 ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_optimize_errors.golden -
+expect_ok ${start}
+
+echo -n poll5_plan...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.02 --plan=50 src/testdata/poll5.sm <(echo 'P>=0.5[ true U<=2 P>=0.5[ F<=1 (s=1 & a=0) ] ] & P<0.96[ F<=10 (s=1 & a=0) ]; P=?[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_plan.golden -
+expect_ok ${start}
+
 echo -n poll5_estimate...
 start=$(timestamp)
 HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 src/testdata/poll5.sm <(echo 'P=?[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_estimate.golden -
 expect_ok ${start}
 
+echo -n poll5_shared...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.005 --shared-paths src/testdata/poll5.sm <(echo 'P=?[ F<=10 (s=1 & a=0) ]; P<0.96[ F<=10 (s=1 & a=0) ]; P<0.98[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_shared.golden -
+expect_ok ${start}
+
+echo -n poll5_threads_path_stats...
+start=$(timestamp)
+output=$(HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.005 --report-statistics --thread-count=3 --group-size=4 src/testdata/poll5.sm <(echo 'P<0.96[ F<=10 (s=1 & a=0) ]') 2>/dev/null)
+observations=$(echo "${output}" | sed -n 's/.*[.:]\([0-9]*\) observations\.$/\1/p')
+[[ -n "${observations}" && "${output}" = *"Path length count: ${observations}"* ]]
+expect_ok ${start}
+
+echo -n poll5_shared_threads...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.005 --shared-paths --thread-count=2 src/testdata/poll5.sm <(echo 'P=?[ F<=10 (s=1 & a=0) ]; P<0.96[ F<=10 (s=1 & a=0) ]; P<0.98[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_shared_threads.golden -
+expect_ok ${start}
+
+echo -n poll5_concurrent_trials...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.005 --concurrent-trials --trials=3 --thread-count=2 src/testdata/poll5.sm <(echo 'P<0.96[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -e 'observations.$' -e 'accepted,' | diff src/testdata/poll5_concurrent_trials.golden -
+expect_ok ${start}
+
+echo -n poll5_first_passage...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.02 --time-bounds=1,2,5,8 src/testdata/poll5.sm <(echo 'P=?[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_first_passage.golden -
+expect_ok ${start}
+
+echo -n poll5_resume_between_properties...
+start=$(timestamp)
+checkpoint=$(mktemp)
+# A checkpoint as saved after the last trial of the first property.
+printf 'ymer-checkpoint 1\n1 0 0 0\nP>=0.5[ F<=10 s = 1 & a = 0 ]\n0\n0\n0\n0\n' > ${checkpoint}
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --checkpoint=${checkpoint} --resume src/testdata/poll5.sm <(echo 'P>=0.5[ F<=5 (s=1 & a=0) ]; P>=0.5[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_resume_between_properties.golden -
+expect_ok ${start}
+rm -f ${checkpoint}
+
 echo -n poll5_hybrid...
 start=$(timestamp)
 HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --engine=hybrid src/testdata/poll5.sm <(echo 'P=?[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_hybrid.golden -
 expect_ok ${start}
 
+echo -n poll5_hybrid_threads...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --engine=hybrid --thread-count=4 src/testdata/poll5.sm <(echo 'P=?[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v -e 'seconds.$' -e '^Parallel multiplication' | diff src/testdata/poll5_hybrid.golden -
+expect_ok ${start}
+
+echo -n poll5_sparse...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --engine=sparse --thread-count=2 src/testdata/poll5.sm <(echo 'P=?[ F<=10 (s=1 & a=0) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll5_sparse.golden -
+expect_ok ${start}
+
+echo -n tandem_sweep...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --epsilon=0.05 --sweep=c=3..5 src/testdata/tandem.sm <(echo 'P=?[ F<=26 (sc=c & sm=c) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/tandem_sweep.golden -
+expect_ok ${start}
+
 echo -n tandem7_sprt08...
 start=$(timestamp)
 HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --const=c=7 src/testdata/tandem.sm <(echo 'P<0.08[ F<=26 (sc=c & sm=c) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/tandem7_sprt08.golden -
@@ -120,6 +191,21 @@ start=$(timestamp)
 HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --memoization --delta=0.05 --const=n=4 src/testdata/robot.sm <(echo 'P>=0.86[ P>=0.5[ F<=9 c=1 ] U<=10 (x1=n & y1=n) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/robot4_sprt86.golden -
 expect_ok ${start}
 
+echo -n robot4_nested_post...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.05 --const=n=4 src/testdata/robot.sm <(echo 'P>=0.35[ true U<=10 ((x1=n & y1=n) & P>=0.5[ F<=3 c=1 ]) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/robot4_nested_post.golden -
+expect_ok ${start}
+
+echo -n robot4_nested_batch...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --nested-batch-size=50 --delta=0.05 --const=n=4 src/testdata/robot.sm <(echo 'P>=0.5[ true U<=10 ((x1=n & y1=n) & P>=0.5[ F<=3 c=1 ]) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/robot4_nested_batch.golden -
+expect_ok ${start}
+
+echo -n robot4_nested_batch_threads...
+start=$(timestamp)
+HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --nested-batch-size=50 --thread-count=2 --delta=0.05 --const=n=4 src/testdata/robot.sm <(echo 'P>=0.5[ true U<=10 ((x1=n & y1=n) & P>=0.5[ F<=3 c=1 ]) ]; P>=0.1[ true U<=10 ((x1=n & y1=n) & P>=0.5[ F<=3 c=1 ]) ]') 2>/dev/null | grep -e '^Model checking P' -e 'initial state.$' | diff src/testdata/robot4_nested_batch_threads.golden -
+expect_ok ${start}
+
 echo -n robot4_mixed74...
 HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --engine=mixed --delta=0.05 --const=n=4 src/testdata/robot.sm <(echo 'P>=0.74[ P>=0.5[ F<=9 c=1 ] U<=10 (x1=n & y1=n) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/robot4_mixed74.golden -
 expect_ok ${start}
@@ -172,6 +258,12 @@ start=$(timestamp)
 HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.05 src/testdata/poll14.sm <(echo 'P=?[ !(s=2 & a=1) U (s=1 & a=1) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll14_unbounded_estimate.golden -
 expect_ok ${start}
 
+echo -n poll14_unbounded_bayesian_unsupported...
+start=$(timestamp)
+output=$(HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --estimation-algorithm=bayesian-interval src/testdata/poll14.sm <(echo 'P>=0.5[ !(s=2 & a=1) U (s=1 & a=1) ]') 2>&1)
+[[ $? = 1 && "${output}" = *'bayesian-interval estimation does not support unbounded properties'* ]]
+expect_ok ${start}
+
 echo -n poll14_unbounded_mixed...
 start=$(timestamp)
 HEAPCHECK=normal GLOG_logtostderr=1 ${YMER} --seed=0 --delta=0.05 --engine=mixed src/testdata/poll14.sm <(echo 'P=?[ !(s=2 & a=1) U (s=1 & a=1) ]') 2>/dev/null | grep -v 'seconds.$' | diff src/testdata/poll14_unbounded_mixed.golden -
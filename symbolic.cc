@@ -25,10 +25,21 @@
 
 #include <float.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "hybrid.h"
 #include "src/compiled-property.h"
@@ -42,7 +53,8 @@ class SymbolicVerifier final : public CompiledPropertyVisitor,
                                public CompiledPathPropertyVisitor {
  public:
   explicit SymbolicVerifier(const DecisionDiagramModel* dd_model,
-                            bool top_level_property, double epsilon);
+                            bool top_level_property, double epsilon,
+                            int thread_count, double sparse_memory_limit);
 
   BDD result() const { return result_; }
 
@@ -63,17 +75,23 @@ class SymbolicVerifier final : public CompiledPropertyVisitor,
   bool estimate_;
   bool top_level_property_;
   double epsilon_;
+  int thread_count_;
+  double sparse_memory_limit_;
   double threshold_;
   bool strict_;
   BDD result_;
 };
 
 SymbolicVerifier::SymbolicVerifier(const DecisionDiagramModel* dd_model,
-                                   bool top_level_property, double epsilon)
+                                   bool top_level_property, double epsilon,
+                                   int thread_count,
+                                   double sparse_memory_limit)
     : dd_model_(dd_model),
       estimate_(false),
       top_level_property_(top_level_property),
       epsilon_(epsilon),
+      thread_count_(thread_count),
+      sparse_memory_limit_(sparse_memory_limit),
       result_(dd_model->manager().GetConstant(false)) {}
 
 void SymbolicVerifier::DoVisitCompiledNaryProperty(
@@ -170,10 +188,7 @@ static void mult_rec(const std::vector<double>& soln, double unif,
     return;
   } else if (hdd->sb) {
     // There is a sparse bit.
-    for (auto element : *hdd->sb) {
-      (*soln2)[row + element.row()] +=
-          soln[col + element.column()] * element.value() * unif;
-    }
+    hdd->sb->AddProduct(soln.data() + col, unif, soln2->data() + row);
     return;
   } else if (level == hddm->num_levels) {
     // We have reached the bottom.
@@ -195,6 +210,374 @@ static void mult_rec(const std::vector<double>& soln, double unif,
   }
 }
 
+// A block of consecutive matrix rows, with the HDD nodes that hold all
+// nonzero elements in those rows.  The nodes are all at the same level and are
+// ordered by column, so multiplying them one by one in order adds to each row
+// in the same order as mult_rec does for the full matrix.
+struct RowBlock {
+  long row_begin;
+  long row_end;
+  int level;
+  // HDD nodes with their column offsets.
+  std::vector<std::pair<HDDNode*, long>> nodes;
+};
+
+// Partitions the rows [row_begin, row_end), represented by the given ODD node,
+// into blocks by splitting on row variables down to max_level.  A block is not
+// split further once it contains a sparse bit or a terminal node.
+static void collect_row_blocks(HDDMatrix* hddm, const OddNode* odd, int level,
+                               int max_level, long row_begin, long row_end,
+                               std::vector<std::pair<HDDNode*, long>> nodes,
+                               std::vector<RowBlock>* blocks) {
+  if (row_begin == row_end) {
+    return;
+  }
+  bool split = level < max_level && !nodes.empty();
+  for (const auto& node : nodes) {
+    if (node.first->sb || level == hddm->num_levels) {
+      split = false;
+    }
+  }
+  if (!split) {
+    blocks->push_back({row_begin, row_end, level, std::move(nodes)});
+    return;
+  }
+  std::vector<std::pair<HDDNode*, long>> e_nodes;
+  std::vector<std::pair<HDDNode*, long>> t_nodes;
+  auto add_columns = [hddm](HDDNode* hdd, long col,
+                            std::vector<std::pair<HDDNode*, long>>* nodes) {
+    if (hdd == hddm->zero) {
+      return;
+    }
+    if (hdd->type.kids.e != hddm->zero) {
+      nodes->emplace_back(hdd->type.kids.e, col);
+    }
+    if (hdd->type.kids.t != hddm->zero) {
+      nodes->emplace_back(hdd->type.kids.t, col + hdd->off);
+    }
+  };
+  for (const auto& node : nodes) {
+    add_columns(node.first->type.kids.e, node.second, &e_nodes);
+    add_columns(node.first->type.kids.t, node.second, &t_nodes);
+  }
+  const long row_split = row_begin + odd->eoff;
+  collect_row_blocks(hddm, odd->e, level + 1, max_level, row_begin, row_split,
+                     std::move(e_nodes), blocks);
+  collect_row_blocks(hddm, odd->t, level + 1, max_level, row_split, row_end,
+                     std::move(t_nodes), blocks);
+}
+
+// Multiplies vectors with a rate matrix using a fixed set of threads.  The rows
+// of the matrix are partitioned into blocks, and threads take whole blocks, so
+// each thread writes to a disjoint range of the result vector.  The result
+// does not depend on the thread count.
+class RowBlockMultiplier {
+ public:
+  explicit RowBlockMultiplier(int thread_count);
+
+  virtual ~RowBlockMultiplier();
+
+  // Runs f(thread_index, block) once for each row block, distributing the
+  // blocks over the threads.
+  void RunOnBlocks(const std::function<void(int, const RowBlock&)>& f);
+
+  // Sets (*soln2)[i] to diags[i] * soln[i] + unif * (R * soln)[i] for each row
+  // i, with diags treated as zero if null.  Returns the squared Euclidean norm
+  // of *soln2 - soln.
+  double Multiply(const std::vector<double>& soln, double unif,
+                  const std::vector<double>* diags,
+                  std::vector<double>* soln2);
+
+  int thread_count() const { return threads_.size() + 1; }
+
+  size_t block_count() const { return blocks_.size(); }
+
+ protected:
+  // Row blocks, set by the constructor of the derived class.
+  std::vector<RowBlock> blocks_;
+
+ private:
+  // Adds unif * (R * soln)[i] to (*soln2)[i] for each row i of block.
+  virtual void AddProduct(const RowBlock& block,
+                          const std::vector<double>& soln, double unif,
+                          std::vector<double>* soln2) const = 0;
+
+  void Run(int thread_index);
+  void RunBlocks(int thread_index);
+
+  // Squared norm of the difference for each row block, summed in block order so
+  // that the result does not depend on which thread ran which block.
+  std::vector<double> sqnorms_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  const std::function<void(int, const RowBlock&)>* job_;
+  std::atomic<size_t> next_block_;
+  uint64_t generation_;
+  int running_count_;
+  bool shutdown_;
+};
+
+RowBlockMultiplier::RowBlockMultiplier(int thread_count)
+    : job_(nullptr),
+      next_block_(0),
+      generation_(0),
+      running_count_(0),
+      shutdown_(false) {
+  for (int i = 1; i < thread_count; ++i) {
+    threads_.emplace_back([this, i]() { Run(i); });
+  }
+}
+
+RowBlockMultiplier::~RowBlockMultiplier() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  shutdown_ = true;
+  lock.unlock();
+  start_cv_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void RowBlockMultiplier::RunOnBlocks(
+    const std::function<void(int, const RowBlock&)>& f) {
+  if (threads_.empty()) {
+    for (const RowBlock& block : blocks_) {
+      f(0, block);
+    }
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_ = &f;
+  next_block_.store(0, std::memory_order_relaxed);
+  running_count_ = threads_.size();
+  ++generation_;
+  lock.unlock();
+  start_cv_.notify_all();
+  RunBlocks(0);
+  lock.lock();
+  done_cv_.wait(lock, [this] { return running_count_ == 0; });
+  job_ = nullptr;
+}
+
+void RowBlockMultiplier::Run(int thread_index) {
+  uint64_t generation = 0;
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    start_cv_.wait(lock, [this, generation] {
+      return shutdown_ || generation_ != generation;
+    });
+    if (shutdown_) {
+      return;
+    }
+    generation = generation_;
+    lock.unlock();
+    RunBlocks(thread_index);
+    lock.lock();
+    if (--running_count_ == 0) {
+      done_cv_.notify_all();
+    }
+  }
+}
+
+void RowBlockMultiplier::RunBlocks(int thread_index) {
+  for (size_t i = next_block_.fetch_add(1, std::memory_order_relaxed);
+       i < blocks_.size();
+       i = next_block_.fetch_add(1, std::memory_order_relaxed)) {
+    (*job_)(thread_index, blocks_[i]);
+  }
+}
+
+double RowBlockMultiplier::Multiply(const std::vector<double>& soln,
+                                    double unif,
+                                    const std::vector<double>* diags,
+                                    std::vector<double>* soln2) {
+  sqnorms_.assign(blocks_.size(), 0.0);
+  RunOnBlocks([this, &soln, unif, diags, soln2](int, const RowBlock& block) {
+    for (long i = block.row_begin; i < block.row_end; ++i) {
+      (*soln2)[i] = (diags == nullptr) ? 0.0 : (*diags)[i] * soln[i];
+    }
+    AddProduct(block, soln, unif, soln2);
+    double sqnorm = 0.0;
+    for (long i = block.row_begin; i < block.row_end; ++i) {
+      double diff = (*soln2)[i] - soln[i];
+      sqnorm += diff * diff;
+    }
+    sqnorms_[&block - &blocks_[0]] = sqnorm;
+  });
+  double sqnorm = 0.0;
+  for (double s : sqnorms_) {
+    sqnorm += s;
+  }
+  return sqnorm;
+}
+
+// Multiplies vectors with a hybrid MTBDD matrix.  The row blocks are split
+// along the row variables of the top levels of the HDD.
+class HybridMultiplier : public RowBlockMultiplier {
+ public:
+  HybridMultiplier(HDDMatrix* hddm, size_t state_count, int thread_count);
+
+ private:
+  void AddProduct(const RowBlock& block, const std::vector<double>& soln,
+                  double unif, std::vector<double>* soln2) const override;
+
+  HDDMatrix* const hddm_;
+};
+
+HybridMultiplier::HybridMultiplier(HDDMatrix* hddm, size_t state_count,
+                                   int thread_count)
+    : RowBlockMultiplier(thread_count), hddm_(hddm) {
+  // Aim for several blocks per thread so that threads can balance the load.
+  int max_level = 0;
+  if (thread_count > 1) {
+    while (max_level < hddm->num_levels &&
+           (1 << max_level) < 8 * thread_count) {
+      ++max_level;
+    }
+  }
+  std::vector<std::pair<HDDNode*, long>> nodes;
+  if (hddm->top != hddm->zero) {
+    nodes.emplace_back(hddm->top, 0);
+  }
+  collect_row_blocks(hddm, hddm->odd, 0, max_level, 0, state_count,
+                     std::move(nodes), &blocks_);
+}
+
+void HybridMultiplier::AddProduct(const RowBlock& block,
+                                  const std::vector<double>& soln,
+                                  double unif,
+                                  std::vector<double>* soln2) const {
+  for (const auto& node : block.nodes) {
+    mult_rec(soln, unif, hddm_, node.first, block.level, block.row_begin,
+             node.second, soln2);
+  }
+}
+
+// Calls f(row, col, value) for each nonzero element of the HDD matrix, in the
+// same order as mult_rec visits them.
+template <typename F>
+static void for_each_element_rec(HDDMatrix* hddm, HDDNode* hdd, int level,
+                                 long row, long col, const F& f) {
+  if (hdd == hddm->zero) {
+    return;
+  } else if (hdd->sb) {
+    for (auto element : *hdd->sb) {
+      f(row + element.row(), col + element.column(), element.value());
+    }
+    return;
+  } else if (level == hddm->num_levels) {
+    f(row, col, hdd->type.val);
+    return;
+  }
+  HDDNode* e = hdd->type.kids.e;
+  if (e != hddm->zero) {
+    for_each_element_rec(hddm, e->type.kids.e, level + 1, row, col, f);
+    for_each_element_rec(hddm, e->type.kids.t, level + 1, row, col + e->off,
+                         f);
+  }
+  HDDNode* t = hdd->type.kids.t;
+  if (t != hddm->zero) {
+    for_each_element_rec(hddm, t->type.kids.e, level + 1, row + hdd->off, col,
+                         f);
+    for_each_element_rec(hddm, t->type.kids.t, level + 1, row + hdd->off,
+                         col + t->off, f);
+  }
+}
+
+// Multiplies vectors with an explicit matrix in compressed row storage format
+// with 32-bit indices, converted from a hybrid MTBDD matrix.  The row blocks
+// hold roughly equal numbers of nonzero elements.
+class SparseMultiplier : public RowBlockMultiplier {
+ public:
+  SparseMultiplier(HDDMatrix* hddm, size_t state_count, int thread_count);
+
+  // Returns the number of bytes needed for a matrix with the given number of
+  // rows and nonzero elements, or infinity if the matrix cannot be indexed
+  // with 32-bit integers.
+  static double MemoryEstimate(size_t state_count, double nonzero_count);
+
+  size_t nonzero_count() const { return values_.size(); }
+
+ private:
+  void AddProduct(const RowBlock& block, const std::vector<double>& soln,
+                  double unif, std::vector<double>* soln2) const override;
+
+  std::vector<double> values_;
+  std::vector<uint32_t> columns_;
+  std::vector<uint32_t> row_starts_;
+};
+
+SparseMultiplier::SparseMultiplier(HDDMatrix* hddm, size_t state_count,
+                                   int thread_count)
+    : RowBlockMultiplier(thread_count), row_starts_(state_count + 1, 0) {
+  for_each_element_rec(hddm, hddm->top, 0, 0, 0,
+                       [this](long row, long, double) { ++row_starts_[row]; });
+  uint32_t nonzero_count = 0;
+  for (uint32_t& row_start : row_starts_) {
+    const uint32_t row_count = row_start;
+    row_start = nonzero_count;
+    nonzero_count += row_count;
+  }
+  values_.resize(nonzero_count);
+  columns_.resize(nonzero_count);
+  std::vector<uint32_t> next(row_starts_.begin(), row_starts_.end() - 1);
+  for_each_element_rec(hddm, hddm->top, 0, 0, 0,
+                       [this, &next](long row, long col, double value) {
+                         const uint32_t i = next[row]++;
+                         values_[i] = value;
+                         columns_[i] = col;
+                       });
+  // Aim for several blocks per thread, with similar numbers of elements.
+  const size_t target_block_count =
+      (thread_count > 1) ? 8 * thread_count : 1;
+  const double elements_per_block =
+      static_cast<double>(nonzero_count) / target_block_count;
+  long row_begin = 0;
+  for (size_t i = 1; i <= target_block_count; ++i) {
+    long row_end = state_count;
+    if (i < target_block_count) {
+      const uint32_t first = i * elements_per_block;
+      row_end = std::upper_bound(row_starts_.begin(), row_starts_.end(),
+                                 first) -
+                row_starts_.begin() - 1;
+    }
+    if (row_end > row_begin) {
+      blocks_.push_back({row_begin, row_end, 0, {}});
+      row_begin = row_end;
+    }
+  }
+}
+
+double SparseMultiplier::MemoryEstimate(size_t state_count,
+                                        double nonzero_count) {
+  if (state_count >= std::numeric_limits<uint32_t>::max() ||
+      nonzero_count >= std::numeric_limits<uint32_t>::max()) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return nonzero_count * (sizeof(double) + sizeof(uint32_t)) +
+         (state_count + 1.0) * sizeof(uint32_t);
+}
+
+void SparseMultiplier::AddProduct(const RowBlock& block,
+                                  const std::vector<double>& soln,
+                                  double unif,
+                                  std::vector<double>* soln2) const {
+  const double* values = values_.data();
+  const uint32_t* columns = columns_.data();
+  const double* x = soln.data();
+  double* y = soln2->data();
+  for (long i = block.row_begin; i < block.row_end; ++i) {
+    double sum = 0.0;
+    const uint32_t end = row_starts_[i + 1];
+    for (uint32_t j = row_starts_[i]; j < end; ++j) {
+      sum += values[j] * x[columns[j]];
+    }
+    y[i] += sum * unif;
+  }
+}
+
 // Poisson tail bounds.
 static double tail_bound(int n, double lambda, int left, int right,
                          double epsilon) {
@@ -403,17 +786,63 @@ void SymbolicVerifier::DoVisitCompiledUntilProperty(
     std::cout << hddm->num_nodes << " nodes, " << hddm->num_sb
               << " sparse matrices (" << hddm->sbl << " levels)." << std::endl;
   }
+  std::unique_ptr<RowBlockMultiplier> multiplier;
+  if (sparse_memory_limit_ > 0) {
+    const double nonzero_count =
+        ddR.MintermCount(dd_model_->manager().GetVariableCount());
+    const double memory =
+        SparseMultiplier::MemoryEstimate(nstates, nonzero_count);
+    if (memory <= sparse_memory_limit_) {
+      if (top_level_property_) {
+        std::cout << "Building sparse matrix...";
+      }
+      auto sparse_multiplier =
+          std::make_unique<SparseMultiplier>(hddm, nstates, thread_count_);
+      if (top_level_property_) {
+        std::cout << sparse_multiplier->nonzero_count() << " nonzeros, "
+                  << memory / (1 << 20) << " MB." << std::endl;
+      }
+      multiplier = std::move(sparse_multiplier);
+      free_hdd_matrix(hddm);
+      hddm = nullptr;
+    } else if (top_level_property_) {
+      std::cout << "Sparse matrix needs " << memory / (1 << 20)
+                << " MB; using hybrid matrix instead." << std::endl;
+    }
+  }
+  if (multiplier == nullptr) {
+    multiplier =
+        std::make_unique<HybridMultiplier>(hddm, nstates, thread_count_);
+  }
+  if (top_level_property_ && multiplier->thread_count() > 1) {
+    std::cout << "Parallel multiplication: " << multiplier->block_count()
+              << " row blocks, " << multiplier->thread_count() << " threads."
+              << std::endl;
+  }
 
-  /* Get vector of diagonals. */
-  double* diags = hdd_negative_row_sums(hddm, nstates);
+  /*
+   * Get vector of diagonals, as the product of -R and a vector of ones.
+   */
+  std::vector<double> soln2(nstates, 1.0);
+  std::vector<double> diags(nstates);
+  multiplier->Multiply(soln2, -1.0, nullptr, &diags);
 
   /*
    * Find max diagonal element.
    */
-  double max_diag = diags[0];
-  for (size_t i = 1; i < nstates; i++) {
-    if (diags[i] < max_diag) {
-      max_diag = diags[i];
+  std::vector<double> max_diags(multiplier->thread_count(), 0.0);
+  multiplier->RunOnBlocks([&diags, &max_diags](int thread_index,
+                                              const RowBlock& block) {
+    for (long i = block.row_begin; i < block.row_end; i++) {
+      if (diags[i] < max_diags[thread_index]) {
+        max_diags[thread_index] = diags[i];
+      }
+    }
+  });
+  double max_diag = 0.0;
+  for (double d : max_diags) {
+    if (d < max_diag) {
+      max_diag = d;
     }
   }
   max_diag = -max_diag;
@@ -424,15 +853,16 @@ void SymbolicVerifier::DoVisitCompiledUntilProperty(
   /*
    * Modify diagonals.
    */
-  for (size_t i = 0; i < nstates; i++) {
-    diags[i] = unif * diags[i] + 1;
-  }
+  multiplier->RunOnBlocks([&diags, unif](int, const RowBlock& block) {
+    for (long i = block.row_begin; i < block.row_end; i++) {
+      diags[i] = unif * diags[i] + 1;
+    }
+  });
 
   /*
    * Create solution/iteration vectors.
    */
   std::vector<double> soln = dd_model_->odd().AddToVector(ADD(dd2));
-  std::vector<double> soln2(nstates);
   std::optional<int> init;
   if (top_level_property_) {
     init = dd_model_->initial_state_index();
@@ -476,25 +906,12 @@ void SymbolicVerifier::DoVisitCompiledUntilProperty(
     /*
      * Matrix vector multiplication.
      */
-    for (size_t i = 0; i < nstates; i++) {
-      soln2[i] = diags[i] * soln[i];
-    }
-    mult_rec(soln, unif, hddm, hddm->top, 0, 0, 0, &soln2);
+    double sqnorm = multiplier->Multiply(soln, unif, &diags, &soln2);
     /*
      * Check for steady state convergence.
      */
     if (!estimate_) {
-      done = true;
-      double sqnorm = 0.0;
-      double sqbound = epsilon_ * epsilon_ / 64.0;
-      for (size_t i = 0; i < nstates; i++) {
-        double diff = soln2[i] - soln[i];
-        sqnorm += diff * diff;
-        if (sqnorm > sqbound) {
-          done = false;
-          break;
-        }
-      }
+      done = sqnorm <= epsilon_ * epsilon_ / 64.0;
       if (done) {
         steady = true;
         if (init.has_value()) {
@@ -528,25 +945,12 @@ void SymbolicVerifier::DoVisitCompiledUntilProperty(
       /*
        * Matrix vector multiplication.
        */
-      for (size_t i = 0; i < nstates; i++) {
-        soln2[i] = diags[i] * soln[i];
-      }
-      mult_rec(soln, unif, hddm, hddm->top, 0, 0, 0, &soln2);
+      double sqnorm = multiplier->Multiply(soln, unif, &diags, &soln2);
       /*
        * Check for steady state convergence.
        */
       if (!estimate_) {
-        done = true;
-        double sqnorm = 0.0;
-        double sqbound = epsilon_ * epsilon_ / 64.0;
-        for (size_t i = 0; i < nstates; i++) {
-          double diff = soln2[i] - soln[i];
-          sqnorm += diff * diff;
-          if (sqnorm > sqbound) {
-            done = false;
-            break;
-          }
-        }
+        done = sqnorm <= epsilon_ * epsilon_ / 64.0;
         if (done) {
           steady = true;
           double weight = 0.0;
@@ -637,8 +1041,9 @@ void SymbolicVerifier::DoVisitCompiledUntilProperty(
   /*
    * Free memory.
    */
-  free_hdd_matrix(hddm);
-  delete diags;
+  if (hddm != nullptr) {
+    free_hdd_matrix(hddm);
+  }
   delete weights;
 
   std::function<bool(double)> satisfies_threshold;
@@ -663,8 +1068,9 @@ void SymbolicVerifier::DoVisitCompiledUntilProperty(
 
 BDD Verify(const CompiledProperty& property,
            const DecisionDiagramModel& dd_model, bool top_level_property,
-           double epsilon) {
-  SymbolicVerifier verifier(&dd_model, top_level_property, epsilon);
+           double epsilon, int thread_count, double sparse_memory_limit) {
+  SymbolicVerifier verifier(&dd_model, top_level_property, epsilon,
+                            thread_count, sparse_memory_limit);
   property.Accept(&verifier);
   return verifier.result();
 }
@@ -41,16 +41,22 @@
 #endif
 #include <getopt.h>
 #endif
+#include <fcntl.h>
+#include <unistd.h>
 #include <algorithm>
 #include <cerrno>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <map>
 #include <memory>
 #include <optional>
+#include <set>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -59,26 +65,43 @@
 static option long_options[] = {
     {"alpha", required_argument, 0, 'A'},
     {"beta", required_argument, 0, 'B'},
+    {"nested-batch-size", required_argument, 0, 'b'},
     {"thread-count", required_argument, 0, 'C'},
     {"const", required_argument, 0, 'c'},
+    {"sweep", required_argument, 0, 'd'},
     {"delta", required_argument, 0, 'D'},
     {"epsilon", required_argument, 0, 'E'},
     {"engine", required_argument, 0, 'e'},
+    {"progress-fd", required_argument, 0, 'F'},
+    {"progress-interval", required_argument, 0, 'f'},
+    {"group-size", required_argument, 0, 'g'},
     {"help", no_argument, 0, 'h'},
+    {"time-bounds", required_argument, 0, 'i'},
+    {"concurrent-trials", no_argument, 0, 'J'},
+    {"checkpoint-interval", required_argument, 0, 'K'},
+    {"checkpoint", required_argument, 0, 'k'},
     {"max-path-length", required_argument, 0, 'L'},
+    {"plan", required_argument, 0, 'l'},
     {"memoization", no_argument, 0, 'M'},
     {"matching-moments", required_argument, 0, 'm'},
     {"fixed-sample-size", required_argument, 0, 'N'},
     {"nested-error", required_argument, 0, 'n'},
+    {"optimize-errors", no_argument, 0, 'O'},
     {"termination-probability", required_argument, 0, 'p'},
+    {"shared-paths", no_argument, 0, 'P'},
     {"estimation-algorithm", required_argument, 0, 'q'},
+    {"prior", required_argument, 0, 'r'},
     {"report-statistics", no_argument, 0, 'R'},
     {"seed", required_argument, 0, 'S'},
+    {"ssp-cache", required_argument, 0, 's'},
     {"trials", required_argument, 0, 'T'},
     {"threshold-algorithm", required_argument, 0, 't'},
+    {"resume", no_argument, 0, 'u'},
     {"version", no_argument, 0, 'V'},
+    {"sparse-memory", required_argument, 0, 'W'},
     {0, 0, 0, 0}};
-static const char OPTION_STRING[] = "A:B:C:c:D:E:e:hL:Mm:N:n:p:q:RS:T:t:V";
+static const char OPTION_STRING[] =
+    "A:B:b:C:c:D:d:E:e:F:f:g:hi:JK:k:L:l:Mm:N:n:Op:Pq:r:RS:s:T:t:uVW:";
 
 namespace {
 
@@ -93,44 +116,103 @@ void display_help() {
       << "  -B b,  --beta=b\t"
       << "use bound b on false positives with sampling engine" << std::endl
       << "\t\t\t  (default is 1e-2)" << std::endl
+      << "  -b b,  --nested-batch-size=b" << std::endl
+      << "\t\t\tdefer nested checks to the end of batches of b paths,"
+      << std::endl
+      << "\t\t\t  verifying each distinct nested state once;" << std::endl
+      << "\t\t\t  paths sharing a nested state are correlated" << std::endl
       << "  -c c,  --const=c\t"
       << "overrides for model constants" << std::endl
       << "\t\t\t  (for example, --const=N=2,M=3)" << std::endl
       << "  -C c,  --thread-count=c\t"
-      << "thread count for concurrent sampling" << std::endl
+      << "thread count for concurrent sampling and for" << std::endl
+      << "\t\t\t  matrix-vector products of the hybrid engine"
+      << std::endl
       << "  -D d,  --delta=d\t"
       << "use indifference region of width 2*d with sampling" << std::endl
       << "\t\t\t  engine (default is 1e-2)" << std::endl
+      << "  -d s,  --sweep=s\t"
+      << "check the model for each value of a constant and" << std::endl
+      << "\t\t\t  print a table of results (for example," << std::endl
+      << "\t\t\t  --sweep=N=2..8,16 for N=2,3,...,8,16)" << std::endl
       << "  -E e,  --epsilon=e\t"
       << "use precision e with hybrid engine (default is 1e-6)" << std::endl
       << "  -e e,  --engine=e\t"
       << "use engine e; can be `sampling' (default), `hybrid'," << std::endl
-      << "\t\t\t  or `mixed'" << std::endl
+      << "\t\t\t  `sparse', or `mixed'" << std::endl
+      << "  -F d,  --progress-fd=d\t"
+      << "write progress of sampling engine runs to file" << std::endl
+      << "\t\t\t  descriptor d as JSON lines" << std::endl
+      << "  -f s,  --progress-interval=s" << std::endl
+      << "\t\t\twrite progress every s seconds (default is 1)"
+      << std::endl
+      << "  -g g,  --group-size=g\t"
+      << "with multiple threads, sample groups of g paths per" << std::endl
+      << "\t\t\t  result and apply the test only to whole groups" << std::endl
+      << "  -i t,  --time-bounds=t" << std::endl
+      << "\t\t\tanswer estimation properties over until properties for"
+      << std::endl
+      << "\t\t\t  the comma-separated time bounds t as well, from the"
+      << std::endl
+      << "\t\t\t  first passage times of one set of paths" << std::endl
+      << "  -J,    --concurrent-trials" << std::endl
+      << "\t\t\trun whole trials concurrently, each on one thread with"
+      << std::endl
+      << "\t\t\t  its own random number stream" << std::endl
+      << "  -K s,  --checkpoint-interval=s" << std::endl
+      << "\t\t\tsave a checkpoint every s seconds (default is 600)"
+      << std::endl
+      << "  -k f,  --checkpoint=f\t"
+      << "save checkpoints of sampling engine runs to file f" << std::endl
       << "  -L l,  --max-path-length=l" << std::endl
       << "\t\t\tlimit sample path to l states" << std::endl
+      << "  -l n,  --plan=n\t"
+      << "predict sample sizes and run times from n pilot paths" << std::endl
+      << "\t\t\t  per test instead of model checking (sampling" << std::endl
+      << "\t\t\t  engine only)" << std::endl
       << "  -M,    --memoization\t"
       << "use memoization for sampling engine" << std::endl
       << "  -m m,  --matching-moments=m" << std::endl
       << "\t\t\tmatch the first m moments of general distributions" << std::endl
       << "  -N n,  --fixed-sample-size=n" << std::endl
       << "\t\t\tuse a fixed sample size" << std::endl
+      << "  -O,    --optimize-errors" << std::endl
+      << "\t\t\tchoose nested error and split error bounds among" << std::endl
+      << "\t\t\t  operands to minimize expected sample size" << std::endl
       << "  -p p,  --termination-probability=p" << std::endl
       << "\t\t\tuse termination probability p for unbounded path properties"
       << std::endl
+      << "  -P,    --shared-paths\t"
+      << "simulate paths shared by all properties with sampling" << std::endl
+      << "\t\t\t  engine" << std::endl
       << "  -q q,  --estimation-algorithm=q" << std::endl
       << "\t\t\tuse sampling algorithm q for estimation" << std::endl
+      << "  -r a,b, --prior=a,b" << std::endl
+      << "\t\t\tuse Beta(a,b) prior with Bayesian sampling algorithms"
+      << std::endl
+      << "\t\t\t  (default is 1,1)" << std::endl
       << "  -R,    --report-statistics" << std::endl
       << "\t\t\treport additional statistics for sampling and mixed engines"
       << std::endl
       << "  -S s,  --seed=s\t"
       << "use seed s with random number generator" << std::endl
       << "\t\t\t  (sampling engine only)" << std::endl
+      << "  -s f,  --ssp-cache=f\t"
+      << "load single sampling plans from file f, and save all" << std::endl
+      << "\t\t\t  plans used to f on exit" << std::endl
       << "  -T t,  --trials=t\t"
       << "number of trials for sampling engine (default is 1)" << std::endl
       << "  -t t,  --threshold-algorithm=t" << std::endl
       << "\t\t\tuse sampling algorithm t for hypothesis testing" << std::endl
+      << "  -u,    --resume\t"
+      << "resume from the file given with --checkpoint" << std::endl
       << "  -V,    --version\t"
       << "display version information and exit" << std::endl
+      << "  -W m,  --sparse-memory=m" << std::endl
+      << "\t\t\tlet the sparse engine use up to m MB for its matrix,"
+      << std::endl
+      << "\t\t\t  and the hybrid matrix beyond that (default is 1024)"
+      << std::endl
       << "  -h,    --help\t\t"
       << "display this help and exit" << std::endl
       << "  file ...\t\t"
@@ -185,6 +267,54 @@ bool parse_const_overrides(const std::string& spec,
   return true;
 }
 
+/* Parses spec for a constant sweep, of the form name=values, where values is a
+   comma-separated list of values and integer ranges lo..hi.  Returns true on
+   success. */
+bool parse_sweep(const std::string& spec, std::string* name,
+                 std::vector<TypedValue>* values) {
+  const std::string::size_type assignment = spec.find('=');
+  if (assignment == 0 || assignment == std::string::npos) {
+    return false;
+  }
+  *name = spec.substr(0, assignment);
+  values->clear();
+  std::string::size_type begin = assignment + 1;
+  while (begin <= spec.size()) {
+    std::string::size_type comma = spec.find(',', begin);
+    if (comma == std::string::npos) {
+      comma = spec.size();
+    }
+    const std::string item = spec.substr(begin, comma - begin);
+    const std::string::size_type range = item.find("..");
+    char* endptr;
+    if (range != std::string::npos) {
+      const int lo = strtol(item.c_str(), &endptr, 10);
+      if (endptr != item.c_str() + range) {
+        return false;
+      }
+      const char* hi_str = item.c_str() + range + 2;
+      const int hi = strtol(hi_str, &endptr, 10);
+      if (endptr == hi_str || *endptr != '\0' || hi < lo) {
+        return false;
+      }
+      for (int i = lo; i <= hi; ++i) {
+        values->push_back(i);
+      }
+    } else {
+      TypedValue v = static_cast<int>(strtol(item.c_str(), &endptr, 10));
+      if (*endptr != '\0') {
+        v = strtod(item.c_str(), &endptr);
+      }
+      if (endptr == item.c_str() || *endptr != '\0') {
+        return false;
+      }
+      values->push_back(v);
+    }
+    begin = comma + 1;
+  }
+  return true;
+}
+
 CompiledExpression CompileAndOptimizeExpression(
     const Expression& expr, Type expected_type,
     const std::map<std::string, const Expression*>& formulas_by_name,
@@ -837,9 +967,81 @@ CompiledCommands CompileCommands(
 
 CompiledExpression OptimizeWithAssignment(
     const CompiledExpression& expr, const IdentifierInfo& variable, int value,
+    const std::vector<VariableBounds>& variable_bounds,
     const std::optional<DecisionDiagramManager>& dd_manager) {
-  return OptimizeIntExpression(
-      expr.WithAssignment(variable, value, dd_manager));
+  return OptimizeIntExpression(expr.WithAssignment(variable, value, dd_manager),
+                               variable_bounds);
+}
+
+std::vector<VariableBounds> GetVariableBounds(
+    const std::vector<StateVariableInfo>& variables,
+    const std::vector<int>& max_values) {
+  std::vector<VariableBounds> variable_bounds;
+  variable_bounds.reserve(variables.size());
+  for (size_t i = 0; i < variables.size(); ++i) {
+    variable_bounds.push_back({variables[i].min_value(), max_values[i]});
+  }
+  return variable_bounds;
+}
+
+bool IsFalseGuard(const CompiledExpression& guard) {
+  return guard.operations().size() == 1 &&
+         guard.operations()[0].opcode() == Opcode::ICONST &&
+         guard.operations()[0].operand2() == 0 &&
+         guard.operations()[0].ioperand1() == 0;
+}
+
+std::vector<CompiledUpdate> OptimizeUpdatesWithBounds(
+    const std::vector<CompiledUpdate>& updates,
+    const std::vector<VariableBounds>& variable_bounds) {
+  std::vector<CompiledUpdate> optimized_updates;
+  optimized_updates.reserve(updates.size());
+  for (const auto& update : updates) {
+    optimized_updates.emplace_back(
+        update.variable(),
+        OptimizeIntExpression(update.expr(), variable_bounds));
+  }
+  return optimized_updates;
+}
+
+// The maximum number of entries in a lookup table for a memoized weight or
+// probability expression.
+constexpr size_t kMaxMemoTableSize = 4096;
+
+// Optimizes the given double expression with the given variable bounds, and
+// memoizes its values if it depends on few enough variables.
+CompiledExpression OptimizeAndMemoizeDoubleExpression(
+    const CompiledExpression& expr,
+    const std::vector<VariableBounds>& variable_bounds) {
+  return OptimizeDoubleExpression(expr, variable_bounds)
+      .WithMemoization(variable_bounds, kMaxMemoTableSize);
+}
+
+CompiledMarkovCommand OptimizeCommandWithBounds(
+    const CompiledMarkovCommand& command,
+    const std::vector<VariableBounds>& variable_bounds) {
+  std::vector<CompiledMarkovOutcome> outcomes;
+  outcomes.reserve(command.outcomes().size());
+  for (const auto& outcome : command.outcomes()) {
+    outcomes.emplace_back(OptimizeAndMemoizeDoubleExpression(
+                              outcome.probability(), variable_bounds),
+                          OptimizeUpdatesWithBounds(outcome.updates(),
+                                                    variable_bounds));
+  }
+  return CompiledMarkovCommand(
+      command.module(), OptimizeIntExpression(command.guard(), variable_bounds),
+      OptimizeAndMemoizeDoubleExpression(command.weight(), variable_bounds),
+      outcomes);
+}
+
+CompiledGsmpCommand OptimizeCommandWithBounds(
+    const CompiledGsmpCommand& command,
+    const std::vector<VariableBounds>& variable_bounds) {
+  return CompiledGsmpCommand(
+      command.module(), OptimizeIntExpression(command.guard(), variable_bounds),
+      command.delay(),
+      OptimizeUpdatesWithBounds(command.updates(), variable_bounds),
+      command.first_index());
 }
 
 CompiledModel CompileModel(
@@ -858,11 +1060,43 @@ CompiledModel CompileModel(
   const auto& compiled_commands = CompileCommands(
       model, formulas_by_name, identifiers_by_name, dd_manager, errors);
 
+  // Use the variable bounds to simplify the commands.  Single Markov commands
+  // whose guards cannot be satisfied in any state are dropped.  Other commands
+  // are indexed, so they are simplified but kept.
+  const std::vector<VariableBounds> variable_bounds =
+      GetVariableBounds(variables, max_values);
+  std::vector<CompiledMarkovCommand> live_single_markov_commands;
+  for (const auto& command : compiled_commands.single_markov_commands) {
+    CompiledMarkovCommand optimized_command =
+        OptimizeCommandWithBounds(command, variable_bounds);
+    if (!IsFalseGuard(optimized_command.guard())) {
+      live_single_markov_commands.push_back(std::move(optimized_command));
+    }
+  }
+  VLOG(2) << "Dead single Markov commands: "
+          << compiled_commands.single_markov_commands.size() -
+                 live_single_markov_commands.size();
+  std::vector<std::vector<std::vector<CompiledMarkovCommand>>>
+      factored_markov_commands = compiled_commands.factored_markov_commands;
+  for (auto& module_commands : factored_markov_commands) {
+    for (auto& commands : module_commands) {
+      for (auto& command : commands) {
+        command = OptimizeCommandWithBounds(command, variable_bounds);
+      }
+    }
+  }
+  std::vector<CompiledGsmpCommand> single_gsmp_commands;
+  single_gsmp_commands.reserve(compiled_commands.single_gsmp_commands.size());
+  for (const auto& command : compiled_commands.single_gsmp_commands) {
+    single_gsmp_commands.push_back(
+        OptimizeCommandWithBounds(command, variable_bounds));
+  }
+
   int pivot_variable = -1;
   std::vector<std::vector<CompiledMarkovCommand>>
       pivoted_single_markov_commands;
   std::vector<CompiledMarkovCommand> single_markov_commands(
-      compiled_commands.single_markov_commands);
+      live_single_markov_commands);
   size_t min_command_count = single_markov_commands.size();
   for (const auto& v : model.variables()) {
     auto i = identifiers_by_name.find(v.name());
@@ -873,16 +1107,13 @@ CompiledModel CompileModel(
     std::vector<std::vector<CompiledMarkovCommand>> pivoted_commands(
         max_value - min_value + 1);
     std::vector<CompiledMarkovCommand> other_commands;
-    for (const auto& command : compiled_commands.single_markov_commands) {
+    for (const auto& command : live_single_markov_commands) {
       std::optional<std::pair<int, CompiledExpression>> pivot_element;
       bool unique = true;
       for (int value = min_value; value <= max_value; ++value) {
         CompiledExpression guard = OptimizeWithAssignment(
-            command.guard(), variable, value, dd_manager);
-        if (guard.operations().size() != 1 ||
-            guard.operations()[0].opcode() != Opcode::ICONST ||
-            guard.operations()[0].operand2() != 0 ||
-            guard.operations()[0].ioperand1() != 0) {
+            command.guard(), variable, value, variable_bounds, dd_manager);
+        if (!IsFalseGuard(guard)) {
           if (pivot_element.has_value()) {
             unique = false;
           } else {
@@ -906,7 +1137,7 @@ CompiledModel CompileModel(
     if (command_count < min_command_count) {
       VLOG(2) << "Command fraction for pivot on " << v.name() << ": "
               << static_cast<double>(command_count) /
-                     compiled_commands.single_markov_commands.size();
+                     live_single_markov_commands.size();
       min_command_count = command_count;
       pivot_variable = variable.variable_index();
       pivoted_single_markov_commands = std::move(pivoted_commands);
@@ -919,10 +1150,8 @@ CompiledModel CompileModel(
         pivot_variable, pivoted_single_markov_commands);
   }
   compiled_model.set_single_markov_commands(single_markov_commands);
-  compiled_model.set_factored_markov_commands(
-      compiled_commands.factored_markov_commands);
-  compiled_model.set_single_gsmp_commands(
-      compiled_commands.single_gsmp_commands);
+  compiled_model.set_factored_markov_commands(factored_markov_commands);
+  compiled_model.set_single_gsmp_commands(single_gsmp_commands);
 
   return compiled_model;
 }
@@ -1044,21 +1273,35 @@ std::vector<bool> CheckUnsupported(
               "sampling engine does not support nested probabilistic "
               "properties for GSMPs");
         }
+        if (inspector.has_unbounded() &&
+            params.estimation_algorithm ==
+                EstimationAlgorithm::BAYESIAN_INTERVAL) {
+          // Unbounded properties use weighted observations, which are not
+          // Bernoulli trials.
+          errors->push_back(
+              "bayesian-interval estimation does not support unbounded "
+              "properties with sampling engine");
+        }
         break;
       case ModelCheckingEngine::HYBRID:
+      case ModelCheckingEngine::SPARSE: {
+        const std::string engine =
+            (params.engine == ModelCheckingEngine::HYBRID) ? "hybrid"
+                                                           : "sparse";
         if (model_type == CompiledModelType::DTMC) {
           // TODO(hlsyounes): Implement support.
-          errors->push_back("hybrid engine does not support DTMCs");
+          errors->push_back(engine + " engine does not support DTMCs");
         } else if (model_type == CompiledModelType::GSMP) {
           // TODO(hlsyounes): Implement support with phase type distributions.
-          errors->push_back("hybrid engine does not support GSMPs");
+          errors->push_back(engine + " engine does not support GSMPs");
         }
         if (inspector.has_unbounded()) {
           // TODO(hlsyounes): Implement support.
-          errors->push_back(
-              "hybrid engine does not support unbounded properties");
+          errors->push_back(engine +
+                            " engine does not support unbounded properties");
         }
         break;
+      }
       case ModelCheckingEngine::MIXED:
         if (inspector.has_nested() && model_type == CompiledModelType::GSMP) {
           // Not a feasible combination.
@@ -1091,6 +1334,10 @@ ThresholdAlgorithm ParseThresholdAlgorithm(const std::string& name) {
     return ThresholdAlgorithm::SPRT;
   } else if (strcasecmp(name.c_str(), "chow-robbins") == 0) {
     return ThresholdAlgorithm::CHOW_ROBBINS;
+  } else if (strcasecmp(name.c_str(), "bayes-factor") == 0) {
+    return ThresholdAlgorithm::BAYES_FACTOR;
+  } else if (strcasecmp(name.c_str(), "bayesian-interval") == 0) {
+    return ThresholdAlgorithm::BAYESIAN_INTERVAL;
   }
   throw std::invalid_argument(
       StrCat("unsupported threshold algorithm `", name, "'"));
@@ -1099,11 +1346,42 @@ ThresholdAlgorithm ParseThresholdAlgorithm(const std::string& name) {
 EstimationAlgorithm ParseEstimationAlgorithm(const std::string& name) {
   if (strcasecmp(name.c_str(), "chow-robbins") == 0) {
     return EstimationAlgorithm::CHOW_ROBBINS;
+  } else if (strcasecmp(name.c_str(), "bayesian-interval") == 0) {
+    return EstimationAlgorithm::BAYESIAN_INTERVAL;
   }
   throw std::invalid_argument(
       StrCat("unsupported estimation algorithm `", name, "'"));
 }
 
+void ParsePrior(const std::string& spec, ModelCheckingParams* params) {
+  char* end;
+  params->prior_a = strtod(spec.c_str(), &end);
+  if (*end == ',') {
+    params->prior_b = strtod(end + 1, &end);
+    if (*end == '\0' && params->prior_a > 0 && params->prior_b > 0) {
+      return;
+    }
+  }
+  throw std::invalid_argument(StrCat("bad prior `", spec, "'"));
+}
+
+std::vector<double> ParseTimeBounds(const std::string& spec) {
+  std::vector<double> time_bounds;
+  const char* begin = spec.c_str();
+  while (true) {
+    char* end;
+    const double t = strtod(begin, &end);
+    if (end == begin || t < 0 || (*end != ',' && *end != '\0')) {
+      throw std::invalid_argument(StrCat("bad time bounds `", spec, "'"));
+    }
+    time_bounds.push_back(t);
+    if (*end == '\0') {
+      return time_bounds;
+    }
+    begin = end + 1;
+  }
+}
+
 template <typename T>
 void PrintSample(const Sample<T>& sample, const std::string& label,
                  const std::string& optional_unit = "") {
@@ -1118,6 +1396,10 @@ void PrintSample(const Sample<T>& sample, const std::string& label,
     if (sample.populate_distribution()) {
       std::cout << label << " distribution:" << std::endl;
       for (const auto& entry : sample.distribution()) {
+        if (entry.first == Sample<T>::kNonFiniteBucket) {
+          std::cout << "  non-finite: " << entry.second << std::endl;
+          continue;
+        }
         const int p = entry.first;
         const int low = (p > 0) ? (1 << (p - 1)) : 0;
         const int high = 1 << p;
@@ -1135,7 +1417,1167 @@ void PrintModelCheckingStats(const ModelCheckingStats& stats) {
   PrintSample(stats.path_length_accept, "Path length [accepted]");
   PrintSample(stats.path_length_reject, "Path length [rejected]");
   PrintSample(stats.path_length_terminate, "Path length [terminated]");
+  PrintSample(stats.wasted_paths, "Wasted paths");
   PrintSample(stats.sample_cache_size, "Sample cache size");
+  PrintSample(stats.sample_cache_hits, "Sample cache hits");
+  PrintSample(stats.sample_cache_misses, "Sample cache misses");
+}
+
+// Prints the given plans, with predicted times that assume a linear speedup
+// with the number of threads.
+void PrintSamplingPlans(const std::vector<SamplingPlan>& plans,
+                        int pilot_path_count, int thread_count) {
+  double total_seconds = 0.0;
+  for (const SamplingPlan& plan : plans) {
+    const double seconds = plan.expected_sample_size * plan.mean_path_length *
+                           plan.seconds_per_state / thread_count;
+    std::cout << "Pr[" << plan.path_property->string()
+              << "]: expected sample size " << ceil(plan.expected_sample_size)
+              << std::endl
+              << "  Mean path length: " << plan.mean_path_length << " ("
+              << pilot_path_count << " pilot paths)" << std::endl
+              << "  Time per path state: " << plan.seconds_per_state
+              << " seconds." << std::endl
+              << "  Predicted time: " << seconds << " seconds." << std::endl;
+    total_seconds += seconds;
+  }
+  std::cout << "Predicted time with " << thread_count
+            << ((thread_count == 1) ? " thread: " : " threads: ")
+            << total_seconds << " seconds." << std::endl;
+}
+
+// Prints the estimates of the given distribution for each of the given time
+// bounds that does not exceed the bound of its path property, and for that
+// bound.
+void PrintFirstPassageDistribution(
+    const FirstPassageDistribution& distribution,
+    const std::vector<double>& time_bounds) {
+  const double max_time = distribution.path_property->max_time();
+  std::vector<double> bounds;
+  for (double t : time_bounds) {
+    if (t < max_time) {
+      bounds.push_back(t);
+    }
+  }
+  bounds.push_back(max_time);
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+  std::cout << distribution.sample_size << " observations." << std::endl
+            << "Pr[" << distribution.path_property->string()
+            << "] by time bound:" << std::endl;
+  for (double t : bounds) {
+    const double p = distribution.Cdf(t);
+    std::cout << "  t<=" << t << ": " << p << " ("
+              << std::max(0.0, p - distribution.band_width) << ','
+              << std::min(1.0, p + distribution.band_width) << ")"
+              << std::endl;
+  }
+}
+
+// Returns the entry of the sweep table for a property with the given results:
+// the mean estimate for estimation properties, if known, and otherwise the
+// verdict or the number of accepting trials.
+std::string SweepResult(bool is_estimation, size_t accepts, size_t trials,
+                        const ModelCheckingStats& stats) {
+  if (is_estimation) {
+    return (stats.estimate.count() > 0) ? StrCat(stats.estimate.mean()) : "-";
+  } else if (trials > 1) {
+    return StrCat(accepts, "/", trials);
+  } else {
+    return (accepts > 0) ? "true" : "false";
+  }
+}
+
+// Prints the results of a sweep as a table with a row for each value of the
+// swept constant and a column for each property, separated by tabs.
+void PrintSweepTable(const std::string& name,
+                     const std::vector<TypedValue>& values,
+                     const UniquePtrVector<const Expression>& properties,
+                     const std::vector<std::vector<std::string>>& table) {
+  std::cout << std::endl << "Sweep results:" << std::endl << name;
+  for (const Expression& property : properties) {
+    std::cout << '\t' << property;
+  }
+  std::cout << std::endl;
+  for (size_t i = 0; i < values.size(); ++i) {
+    std::cout << values[i];
+    for (const std::string& result : table[i]) {
+      std::cout << '\t' << result;
+    }
+    std::cout << std::endl;
+  }
+}
+
+// The progress of a sampling run, saved in checkpoints so that a preempted run
+// can resume where it stopped.
+struct Checkpoint {
+  // Index and text of the property being verified.
+  size_t property_index = 0;
+  std::string property;
+  // Index of the current trial, and number of trials accepted before it.
+  size_t trial = 0;
+  size_t accepts = 0;
+  // Number of checkpoints saved before this one.  Used to reseed the engines
+  // on resume when their states are not saved.
+  int generation = 0;
+  // Sampler states, only saved when sampling is single-threaded.  Worker
+  // threads use their engines while checkpoints are saved.
+  std::vector<std::string> sampler_states;
+  // Statistics for the property being verified, one sample per line.
+  std::vector<std::string> stats;
+  VerifierState verifier_state;
+};
+
+template <typename T>
+std::string SampleToLine(const Sample<T>& sample) {
+  std::ostringstream out;
+  sample.Save(&out);
+  std::string line = out.str();
+  line.pop_back();
+  return line;
+}
+
+template <typename T>
+bool SampleFromLine(const std::string& line, Sample<T>* sample) {
+  std::istringstream in(line);
+  return sample->Load(&in);
+}
+
+std::vector<std::string> SaveStats(const ModelCheckingStats& stats) {
+  return {SampleToLine(stats.time),
+          SampleToLine(stats.sample_size),
+          SampleToLine(stats.sample_cache_size),
+          SampleToLine(stats.sample_cache_hits),
+          SampleToLine(stats.sample_cache_misses),
+          SampleToLine(stats.path_length),
+          SampleToLine(stats.path_length_accept),
+          SampleToLine(stats.path_length_reject),
+          SampleToLine(stats.path_length_terminate),
+          SampleToLine(stats.wasted_paths),
+          SampleToLine(stats.estimate)};
+}
+
+bool LoadStats(const std::vector<std::string>& lines,
+               ModelCheckingStats* stats) {
+  return lines.size() == 11 && SampleFromLine(lines[0], &stats->time) &&
+         SampleFromLine(lines[1], &stats->sample_size) &&
+         SampleFromLine(lines[2], &stats->sample_cache_size) &&
+         SampleFromLine(lines[3], &stats->sample_cache_hits) &&
+         SampleFromLine(lines[4], &stats->sample_cache_misses) &&
+         SampleFromLine(lines[5], &stats->path_length) &&
+         SampleFromLine(lines[6], &stats->path_length_accept) &&
+         SampleFromLine(lines[7], &stats->path_length_reject) &&
+         SampleFromLine(lines[8], &stats->path_length_terminate) &&
+         SampleFromLine(lines[9], &stats->wasted_paths) &&
+         SampleFromLine(lines[10], &stats->estimate);
+}
+
+void WriteLines(const std::vector<std::string>& lines, std::ostream* out) {
+  *out << lines.size() << '\n';
+  for (const std::string& line : lines) {
+    *out << line << '\n';
+  }
+}
+
+bool ReadLines(std::istream* in, std::vector<std::string>* lines) {
+  std::string line;
+  if (!std::getline(*in, line)) {
+    return false;
+  }
+  char* end;
+  const unsigned long count = strtoul(line.c_str(), &end, 10);
+  if (line.empty() || *end != '\0') {
+    return false;
+  }
+  lines->clear();
+  for (unsigned long i = 0; i < count; ++i) {
+    if (!std::getline(*in, line)) {
+      return false;
+    }
+    lines->push_back(line);
+  }
+  return true;
+}
+
+const char kCheckpointHeader[] = "ymer-checkpoint 1";
+
+void WriteCheckpoint(const Checkpoint& checkpoint, std::ostream* out) {
+  *out << kCheckpointHeader << '\n'
+       << checkpoint.property_index << ' ' << checkpoint.trial << ' '
+       << checkpoint.accepts << ' ' << checkpoint.generation << '\n'
+       << checkpoint.property << '\n';
+  WriteLines(checkpoint.sampler_states, out);
+  WriteLines(checkpoint.stats, out);
+  WriteLines(checkpoint.verifier_state.test_samples, out);
+  WriteLines(checkpoint.verifier_state.sample_cache, out);
+}
+
+// Reads a checkpoint written by WriteCheckpoint.  Returns false if the input is
+// malformed.
+bool ReadCheckpoint(std::istream* in, Checkpoint* checkpoint) {
+  std::string line;
+  if (!std::getline(*in, line) || line != kCheckpointHeader ||
+      !std::getline(*in, line)) {
+    return false;
+  }
+  std::istringstream fields(line);
+  if (!(fields >> checkpoint->property_index >> checkpoint->trial >>
+        checkpoint->accepts >> checkpoint->generation) ||
+      !(fields >> std::ws).eof() ||
+      !std::getline(*in, checkpoint->property)) {
+    return false;
+  }
+  return ReadLines(in, &checkpoint->sampler_states) &&
+         ReadLines(in, &checkpoint->stats) &&
+         ReadLines(in, &checkpoint->verifier_state.test_samples) &&
+         ReadLines(in, &checkpoint->verifier_state.sample_cache) &&
+         (*in >> std::ws).eof();
+}
+
+// Saves checkpoints of a sampling run to a file at regular intervals.  Each
+// checkpoint is written to a temporary file that then replaces the file, so
+// that a preempted run always leaves a complete checkpoint.
+class FileCheckpointer : public VerifyCheckpointer {
+ public:
+  FileCheckpointer(
+      const std::string& filename, double interval,
+      const std::vector<CompiledDistributionSampler<std::mt19937_64>>*
+          samplers)
+      : filename_(filename), interval_(interval), samplers_(samplers) {}
+
+  // Sets the progress that is saved with the next checkpoint.  The given
+  // statistics, if not nullptr, must outlive the next checkpoint.
+  void SetProgress(size_t property_index, const std::string& property,
+                   size_t trial, size_t accepts,
+                   const ModelCheckingStats* stats) {
+    progress_.property_index = property_index;
+    progress_.property = property;
+    progress_.trial = trial;
+    progress_.accepts = accepts;
+    stats_ = stats;
+  }
+
+  void set_generation(int generation) { progress_.generation = generation; }
+
+  bool Due() override { return timer_.GetElapsedSeconds() >= interval_; }
+
+  void Save(const VerifierState& state) override {
+    progress_.verifier_state = state;
+    progress_.sampler_states.clear();
+    if (samplers_->size() == 1) {
+      std::ostringstream out;
+      samplers_->front().SaveState(&out);
+      std::string line = out.str();
+      line.pop_back();
+      progress_.sampler_states.push_back(line);
+    }
+    progress_.stats.clear();
+    if (stats_ != nullptr) {
+      progress_.stats = SaveStats(*stats_);
+    }
+    const std::string tmp_filename = StrCat(filename_, ".tmp");
+    {
+      std::ofstream out(tmp_filename);
+      WriteCheckpoint(progress_, &out);
+      if (!out) {
+        throw std::runtime_error(
+            StrCat("failed to write checkpoint to ", tmp_filename));
+      }
+    }
+    if (rename(tmp_filename.c_str(), filename_.c_str()) != 0) {
+      throw std::runtime_error(StrCat("failed to replace ", filename_, ": ",
+                                      strerror(errno)));
+    }
+    ++progress_.generation;
+    timer_ = Timer<>();
+  }
+
+ private:
+  const std::string filename_;
+  const double interval_;
+  const std::vector<CompiledDistributionSampler<std::mt19937_64>>* const
+      samplers_;
+  const ModelCheckingStats* stats_ = nullptr;
+  Checkpoint progress_;
+  Timer<> timer_;
+};
+
+// Returns x as a JSON number, or null if x is not finite.
+std::string JsonNumber(double x) {
+  return std::isfinite(x) ? StrCat(x) : "null";
+}
+
+// Writes snapshots of sampling runs to a file descriptor as JSON lines, at
+// regular intervals.
+class FdProgressListener : public VerifyProgressListener {
+ public:
+  FdProgressListener(int fd, double interval) : fd_(fd), interval_(interval) {}
+
+  // Sets the property and trial that the following snapshots belong to.
+  void SetTrial(size_t property_index, size_t trial) {
+    property_index_ = property_index;
+    trial_ = trial;
+  }
+
+  bool Due() override { return timer_.GetElapsedSeconds() >= interval_; }
+
+  void Report(const VerifyProgress& progress) override {
+    std::ostringstream out;
+    out << "{\"property\":" << property_index_ << ",\"trial\":" << trial_
+        << ",\"samples\":" << progress.observation_count
+        << ",\"estimate\":" << JsonNumber(progress.estimate)
+        << ",\"lower\":" << JsonNumber(progress.lower_bound)
+        << ",\"upper\":" << JsonNumber(progress.upper_bound)
+        << ",\"llr\":" << JsonNumber(progress.log_likelihood_ratio)
+        << ",\"seconds\":" << JsonNumber(progress.elapsed_seconds)
+        << ",\"paths_per_second\":"
+        << JsonNumber(progress.observation_count / progress.elapsed_seconds)
+        << ",\"thread_utilization\":[";
+    for (size_t i = 0; i < progress.thread_utilization.size(); ++i) {
+      if (i > 0) {
+        out << ',';
+      }
+      out << JsonNumber(progress.thread_utilization[i]);
+    }
+    out << "],\"done\":" << (progress.done ? "true" : "false") << "}\n";
+    const std::string line = out.str();
+    for (size_t written = 0; written < line.size();) {
+      const ssize_t n =
+          write(fd_, line.data() + written, line.size() - written);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::runtime_error(
+            StrCat("failed to write progress: ", strerror(errno)));
+      }
+      written += n;
+    }
+    timer_ = Timer<>();
+  }
+
+ private:
+  const int fd_;
+  const double interval_;
+  size_t property_index_ = 0;
+  size_t trial_ = 0;
+  Timer<> timer_;
+};
+
+// Collects the names of the identifiers that expressions read, directly or
+// through formulas and labels.
+class IdentifierCollector final : public ExpressionVisitor,
+                                  public PathPropertyVisitor,
+                                  public DistributionVisitor {
+ public:
+  IdentifierCollector(
+      const std::map<std::string, const Expression*>* formulas_by_name,
+      const std::map<std::string, const Expression*>* labels_by_name,
+      std::set<std::string>* identifiers);
+
+ private:
+  void DoVisitLiteral(const Literal& expr) override;
+  void DoVisitIdentifier(const Identifier& expr) override;
+  void DoVisitLabel(const Label& expr) override;
+  void DoVisitFunctionCall(const FunctionCall& expr) override;
+  void DoVisitUnaryOperation(const UnaryOperation& expr) override;
+  void DoVisitBinaryOperation(const BinaryOperation& expr) override;
+  void DoVisitConditional(const Conditional& expr) override;
+  void DoVisitProbabilityThresholdOperation(
+      const ProbabilityThresholdOperation& expr) override;
+  void DoVisitProbabilityEstimationOperation(
+      const ProbabilityEstimationOperation& expr) override;
+  void DoVisitUntilProperty(const UntilProperty& path_property) override;
+  void DoVisitEventuallyProperty(
+      const EventuallyProperty& path_property) override;
+  void DoVisitMemoryless(const Memoryless& dist) override;
+  void DoVisitWeibull(const Weibull& dist) override;
+  void DoVisitLognormal(const Lognormal& dist) override;
+  void DoVisitUniform(const Uniform& dist) override;
+
+  const std::map<std::string, const Expression*>* formulas_by_name_;
+  const std::map<std::string, const Expression*>* labels_by_name_;
+  std::set<std::string> visited_labels_;
+  std::set<std::string>* identifiers_;
+};
+
+IdentifierCollector::IdentifierCollector(
+    const std::map<std::string, const Expression*>* formulas_by_name,
+    const std::map<std::string, const Expression*>* labels_by_name,
+    std::set<std::string>* identifiers)
+    : formulas_by_name_(formulas_by_name),
+      labels_by_name_(labels_by_name),
+      identifiers_(identifiers) {}
+
+void IdentifierCollector::DoVisitLiteral(const Literal& expr) {}
+
+void IdentifierCollector::DoVisitIdentifier(const Identifier& expr) {
+  if (identifiers_->insert(expr.name()).second) {
+    auto f = formulas_by_name_->find(expr.name());
+    if (f != formulas_by_name_->end()) {
+      f->second->Accept(this);
+    }
+  }
+}
+
+void IdentifierCollector::DoVisitLabel(const Label& expr) {
+  if (visited_labels_.insert(expr.name()).second) {
+    auto l = labels_by_name_->find(expr.name());
+    if (l != labels_by_name_->end()) {
+      l->second->Accept(this);
+    }
+  }
+}
+
+void IdentifierCollector::DoVisitFunctionCall(const FunctionCall& expr) {
+  for (const Expression& argument : expr.arguments()) {
+    argument.Accept(this);
+  }
+}
+
+void IdentifierCollector::DoVisitUnaryOperation(const UnaryOperation& expr) {
+  expr.operand().Accept(this);
+}
+
+void IdentifierCollector::DoVisitBinaryOperation(
+    const BinaryOperation& expr) {
+  expr.operand1().Accept(this);
+  expr.operand2().Accept(this);
+}
+
+void IdentifierCollector::DoVisitConditional(const Conditional& expr) {
+  expr.condition().Accept(this);
+  expr.if_branch().Accept(this);
+  expr.else_branch().Accept(this);
+}
+
+void IdentifierCollector::DoVisitProbabilityThresholdOperation(
+    const ProbabilityThresholdOperation& expr) {
+  expr.path_property().Accept(this);
+}
+
+void IdentifierCollector::DoVisitProbabilityEstimationOperation(
+    const ProbabilityEstimationOperation& expr) {
+  expr.path_property().Accept(this);
+}
+
+void IdentifierCollector::DoVisitUntilProperty(
+    const UntilProperty& path_property) {
+  path_property.pre_expr().Accept(this);
+  path_property.post_expr().Accept(this);
+}
+
+void IdentifierCollector::DoVisitEventuallyProperty(
+    const EventuallyProperty& path_property) {
+  path_property.expr().Accept(this);
+}
+
+void IdentifierCollector::DoVisitMemoryless(const Memoryless& dist) {
+  dist.weight().Accept(this);
+}
+
+void IdentifierCollector::DoVisitWeibull(const Weibull& dist) {
+  dist.scale().Accept(this);
+  dist.shape().Accept(this);
+}
+
+void IdentifierCollector::DoVisitLognormal(const Lognormal& dist) {
+  dist.scale().Accept(this);
+  dist.shape().Accept(this);
+}
+
+void IdentifierCollector::DoVisitUniform(const Uniform& dist) {
+  dist.low().Accept(this);
+  dist.high().Accept(this);
+}
+
+// Returns the names of the identifiers that are only in one of the given maps,
+// or that have a different type, value, or state variable encoding in the
+// two.
+std::set<std::string> GetChangedIdentifiers(
+    const std::map<std::string, IdentifierInfo>& old_identifiers,
+    const std::map<std::string, IdentifierInfo>& new_identifiers) {
+  std::set<std::string> changed;
+  for (const auto& entry : new_identifiers) {
+    auto i = old_identifiers.find(entry.first);
+    if (i == old_identifiers.end() ||
+        i->second.type() != entry.second.type() ||
+        i->second.variable_index() != entry.second.variable_index() ||
+        i->second.low_bit() != entry.second.low_bit() ||
+        i->second.high_bit() != entry.second.high_bit() ||
+        !(i->second.constant_value() == entry.second.constant_value())) {
+      changed.insert(entry.first);
+    }
+  }
+  for (const auto& entry : old_identifiers) {
+    if (new_identifiers.find(entry.first) == new_identifiers.end()) {
+      changed.insert(entry.first);
+    }
+  }
+  return changed;
+}
+
+// Returns true if any of the given identifiers is in changed.
+bool ReadsAny(const std::set<std::string>& identifiers,
+              const std::set<std::string>& changed) {
+  for (const std::string& name : changed) {
+    if (identifiers.find(name) != identifiers.end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Compiles the model and properties for each point of a sweep.  The compiled
+// model and each compiled property are kept from the previous point unless
+// they read an identifier, directly or through formulas and labels, whose
+// value or state variable encoding has changed.
+class SweepCompiler {
+ public:
+  SweepCompiler(const Model& model,
+                const UniquePtrVector<const Expression>& properties,
+                const ModelCheckingParams& params);
+
+  // Compiles the model and properties with the given constant overrides.
+  // Returns false and adds to errors on failure.
+  bool Compile(const std::map<std::string, TypedValue>& constant_overrides,
+               std::vector<std::string>* errors);
+
+  const std::map<std::string, IdentifierInfo>& identifiers_by_name() const {
+    return identifiers_by_name_;
+  }
+
+  DecisionDiagramManager* dd_manager() { return &dd_manager_.value(); }
+
+  const CompiledModel& model() const { return compiled_model_.value(); }
+
+  const UniquePtrVector<const CompiledProperty>& properties() const {
+    return compiled_properties_;
+  }
+
+  const std::vector<bool>& is_estimation() const { return is_estimation_; }
+
+  std::pair<int, int> reg_counts() const { return reg_counts_; }
+
+ private:
+  const Model& model_;
+  const UniquePtrVector<const Expression>& properties_;
+  const ModelCheckingParams& params_;
+  const std::map<std::string, const Expression*> formulas_by_name_;
+  const std::map<std::string, const Expression*> labels_by_name_;
+  // Identifiers read by the model and by each property.
+  std::set<std::string> model_identifiers_;
+  std::vector<std::set<std::string>> property_identifiers_;
+  std::map<std::string, IdentifierInfo> identifiers_by_name_;
+  // The DD manager is kept across sweep points with the same number of
+  // variables, so that they share its variable ordering and caches.
+  std::optional<DecisionDiagramManager> dd_manager_;
+  std::optional<CompiledModel> compiled_model_;
+  UniquePtrVector<const CompiledProperty> compiled_properties_;
+  std::vector<bool> is_estimation_;
+  std::pair<int, int> reg_counts_;
+};
+
+SweepCompiler::SweepCompiler(
+    const Model& model, const UniquePtrVector<const Expression>& properties,
+    const ModelCheckingParams& params)
+    : model_(model),
+      properties_(properties),
+      params_(params),
+      formulas_by_name_(GetExpressionsByName(model.formulas())),
+      labels_by_name_(GetExpressionsByName(model.labels())) {
+  IdentifierCollector model_collector(&formulas_by_name_, &labels_by_name_,
+                                      &model_identifiers_);
+  for (const ParsedVariable& variable : model.variables()) {
+    variable.min().Accept(&model_collector);
+    variable.max().Accept(&model_collector);
+    variable.init().Accept(&model_collector);
+  }
+  if (model.init() != nullptr) {
+    model.init()->Accept(&model_collector);
+  }
+  for (const ParsedModule& module : model.modules()) {
+    for (const Command& command : module.commands()) {
+      command.guard().Accept(&model_collector);
+      for (const Outcome& outcome : command.outcomes()) {
+        outcome.delay().Accept(&model_collector);
+        for (const Update& update : outcome.updates()) {
+          update.expr().Accept(&model_collector);
+        }
+      }
+    }
+  }
+  property_identifiers_.resize(properties.size());
+  for (size_t i = 0; i < properties.size(); ++i) {
+    IdentifierCollector property_collector(
+        &formulas_by_name_, &labels_by_name_, &property_identifiers_[i]);
+    properties[i].Accept(&property_collector);
+  }
+}
+
+bool SweepCompiler::Compile(
+    const std::map<std::string, TypedValue>& constant_overrides,
+    std::vector<std::string>* errors) {
+  std::map<std::string, IdentifierInfo> identifiers_by_name =
+      GetConstantIdentifiersByName(model_.constants(), formulas_by_name_,
+                                   constant_overrides, errors);
+  if (!errors->empty()) {
+    return false;
+  }
+  auto compile_variables_result = CompileVariables(
+      model_.variables(), formulas_by_name_, &identifiers_by_name, errors);
+  // Everything is compiled at the first point, and when a new DD manager
+  // invalidates the decision diagrams of the compiled expressions.
+  bool compile_all = !compiled_model_.has_value();
+  if ((params_.engine == ModelCheckingEngine::HYBRID ||
+       params_.engine == ModelCheckingEngine::SPARSE ||
+       params_.engine == ModelCheckingEngine::MIXED) &&
+      (!dd_manager_.has_value() ||
+       dd_manager_.value().GetVariableCount() !=
+           2 * compile_variables_result.total_bit_count)) {
+    dd_manager_ =
+        DecisionDiagramManager(2 * compile_variables_result.total_bit_count);
+    compile_all = true;
+  }
+  const std::set<std::string> changed =
+      GetChangedIdentifiers(identifiers_by_name_, identifiers_by_name);
+  identifiers_by_name_ = std::move(identifiers_by_name);
+  const bool compile_model =
+      compile_all || ReadsAny(model_identifiers_, changed);
+  if (compile_model) {
+    std::optional<CompiledExpression> init_expr;
+    if (model_.init() != nullptr) {
+      if (compile_variables_result.has_explicit_init) {
+        errors->push_back(
+            "global init not allowed in model with explicit variable inits");
+      }
+      init_expr = CompileAndOptimizeExpression(
+          *model_.init(), Type::BOOL, formulas_by_name_, identifiers_by_name_,
+          dd_manager_, errors);
+      if (params_.engine != ModelCheckingEngine::HYBRID &&
+          params_.engine != ModelCheckingEngine::SPARSE) {
+        // TODO(hyounes): Set value from init expr.  Report error if init expr
+        // does not identify a single state.
+      }
+    }
+    compiled_model_.emplace(
+        CompileModel(model_, compile_variables_result.variables,
+                     compile_variables_result.init_values, init_expr,
+                     compile_variables_result.max_values, formulas_by_name_,
+                     identifiers_by_name_, dd_manager_, errors));
+  }
+  size_t compiled_property_count = 0;
+  for (size_t i = 0; i < properties_.size(); ++i) {
+    const bool compiled = i < compiled_properties_.size();
+    if (compiled && !compile_all &&
+        !ReadsAny(property_identifiers_[i], changed)) {
+      continue;
+    }
+    auto compiled_property = CompileAndOptimizeProperty(
+        properties_[i], formulas_by_name_, labels_by_name_,
+        identifiers_by_name_, dd_manager_, errors);
+    if (compiled) {
+      compiled_properties_.replace(i, std::move(compiled_property));
+    } else {
+      compiled_properties_.push_back(std::move(compiled_property));
+    }
+    ++compiled_property_count;
+  }
+  VLOG(1) << "Compiled " << (compile_model ? "the model and " : "")
+          << compiled_property_count << " of " << properties_.size()
+          << " properties.";
+  reg_counts_ = compiled_model_->GetRegisterCounts();
+  for (const CompiledProperty& property : compiled_properties_) {
+    auto property_reg_counts = GetPropertyRegisterCounts(property);
+    reg_counts_.first = std::max(reg_counts_.first, property_reg_counts.first);
+    reg_counts_.second =
+        std::max(reg_counts_.second, property_reg_counts.second);
+  }
+  is_estimation_ = CheckUnsupported(params_, compiled_model_->type(),
+                                    compiled_properties_, errors);
+  return errors->empty();
+}
+
+// Evaluators, samplers, and a pool of worker threads for the sampling
+// engines, created once and reused at every sweep point.
+class SamplingWorkers {
+ public:
+  explicit SamplingWorkers(int thread_count);
+
+  SamplingThreadPool* pool() { return pool_.get(); }
+
+  std::vector<std::mt19937_64>* engines() { return &engines_; }
+
+  std::vector<CompiledDistributionSampler<std::mt19937_64>>* samplers() {
+    return &samplers_;
+  }
+
+  // Prepares the workers for sampling paths of the given model, with at least
+  // the given numbers of integer and double registers.  The engines are
+  // seeded as in a run without a sweep, so each sweep point gets the results
+  // of a standalone run with the same constants.
+  void Reset(const CompiledModel* model, std::pair<int, int> reg_counts,
+             size_t seed);
+
+ private:
+  std::vector<CompiledExpressionEvaluator> evaluators_;
+  std::vector<std::mt19937_64> engines_;
+  std::vector<CompiledDistributionSampler<std::mt19937_64>> samplers_;
+  std::pair<int, int> reg_counts_;
+  std::unique_ptr<SamplingThreadPool> pool_;
+};
+
+SamplingWorkers::SamplingWorkers(int thread_count)
+    : evaluators_(thread_count, CompiledExpressionEvaluator(0, 0)),
+      engines_(thread_count),
+      reg_counts_(0, 0) {
+  samplers_.reserve(thread_count);
+  for (std::mt19937_64& engine : engines_) {
+    samplers_.emplace_back(&engine);
+  }
+  pool_.reset(new SamplingThreadPool(nullptr, &evaluators_, &samplers_));
+}
+
+void SamplingWorkers::Reset(const CompiledModel* model,
+                            std::pair<int, int> reg_counts, size_t seed) {
+  if (reg_counts.first > reg_counts_.first ||
+      reg_counts.second > reg_counts_.second) {
+    reg_counts_.first = std::max(reg_counts_.first, reg_counts.first);
+    reg_counts_.second = std::max(reg_counts_.second, reg_counts.second);
+    for (CompiledExpressionEvaluator& evaluator : evaluators_) {
+      evaluator =
+          CompiledExpressionEvaluator(reg_counts_.first, reg_counts_.second);
+    }
+  }
+  std::seed_seq seed_generator{seed};
+  std::vector<std::uint32_t> seeds(engines_.size());
+  seed_generator.generate(seeds.begin(), seeds.end());
+  for (size_t i = 0; i < engines_.size(); ++i) {
+    engines_[i].seed(seeds[i]);
+    samplers_[i] = CompiledDistributionSampler<std::mt19937_64>(&engines_[i]);
+  }
+  pool_->SetModel(model);
+}
+
+// Command line settings for verifying the properties at each sweep point.
+struct VerifySettings {
+  size_t moments;
+  size_t seed;
+  size_t trials;
+  int thread_count;
+  double sparse_memory;
+  bool report_statistics;
+  int pilot_path_count;
+  std::string checkpoint_file;
+  double checkpoint_interval;
+  std::optional<Checkpoint> resume_checkpoint;
+  bool concurrent_trials;
+  std::vector<double> time_bounds;
+  int progress_fd;
+  double progress_interval;
+};
+
+// Verifies the given properties with the sampling engine at a single sweep
+// point.  Adds the results to sweep_row if it is not nullptr.
+void VerifyWithSampling(const ModelCheckingParams& params,
+                        const VerifySettings& settings,
+                        const UniquePtrVector<const Expression>& properties,
+                        const SweepCompiler& compiled,
+                        SamplingWorkers* workers,
+                        std::vector<std::string>* sweep_row) {
+  std::cout << "Sampling engine: alpha=" << params.alpha
+            << ", beta=" << params.beta << ", delta=" << params.delta
+            << ", p_term=" << params.termination_probability
+            << ", seed=" << settings.seed << std::endl;
+  Timer<> model_timer;
+  workers->Reset(&compiled.model(), compiled.reg_counts(), settings.seed);
+  const State init_state(compiled.model());
+  std::cout << "Model built in " << model_timer.GetElapsedSeconds()
+            << " seconds." << std::endl;
+  std::cout << "Variables: " << init_state.values().size() << std::endl;
+  std::cout << "Events:    " << compiled.model().EventCount() << std::endl;
+  std::optional<FileCheckpointer> checkpointer;
+  if (!settings.checkpoint_file.empty()) {
+    checkpointer.emplace(settings.checkpoint_file, settings.checkpoint_interval,
+                         workers->samplers());
+  }
+  std::optional<FdProgressListener> progress;
+  if (settings.progress_fd >= 0) {
+    progress.emplace(settings.progress_fd, settings.progress_interval);
+  }
+  if (settings.resume_checkpoint.has_value()) {
+    const Checkpoint& checkpoint = settings.resume_checkpoint.value();
+    std::vector<CompiledDistributionSampler<std::mt19937_64>>& samplers =
+        *workers->samplers();
+    if (checkpoint.sampler_states.size() == samplers.size()) {
+      for (size_t i = 0; i < samplers.size(); ++i) {
+        std::istringstream in(checkpoint.sampler_states[i]);
+        if (!samplers[i].LoadState(&in)) {
+          throw std::invalid_argument(
+              StrCat("malformed sampler state in ", settings.checkpoint_file));
+        }
+      }
+    } else {
+      // The checkpoint has no sampler states for this thread count, so
+      // continue with fresh random number streams.
+      std::seed_seq resume_seed_generator{
+          settings.seed, static_cast<size_t>(checkpoint.generation) + 1};
+      std::vector<std::uint32_t> seeds(settings.thread_count);
+      resume_seed_generator.generate(seeds.begin(), seeds.end());
+      for (int i = 0; i < settings.thread_count; ++i) {
+        (*workers->engines())[i].seed(seeds[i]);
+      }
+    }
+    checkpointer->set_generation(checkpoint.generation + 1);
+    std::cout << "Resuming from checkpoint at property "
+              << checkpoint.property_index + 1 << ", trial "
+              << checkpoint.trial + 1 << "." << std::endl;
+  }
+  // Properties verified on shared paths, indexed by property.
+  std::vector<int> shared_indices(properties.size(), -1);
+  std::vector<const CompiledProperty*> shared_properties;
+  if (params.shared_paths && settings.pilot_path_count == 0) {
+    for (size_t i = 0; i < compiled.properties().size(); ++i) {
+      if (SupportsSharedPaths(compiled.properties()[i])) {
+        shared_indices[i] = shared_properties.size();
+        shared_properties.push_back(&compiled.properties()[i]);
+      }
+    }
+  }
+  std::vector<ModelCheckingStats> shared_stats(
+      shared_properties.size(), ModelCheckingStats(settings.report_statistics));
+  std::vector<std::vector<SharedPathResult>> shared_results;
+  if (!shared_properties.empty()) {
+    std::cout << std::endl
+              << "Sampling shared paths for " << shared_properties.size()
+              << " properties ..." << std::endl;
+    for (size_t i = 0; i < settings.trials; ++i) {
+      shared_results.push_back(
+          VerifyOnSharedPaths(shared_properties, compiled.model(), params,
+                              init_state, workers->pool(), &shared_stats));
+    }
+  }
+  for (auto fi = properties.begin(); fi != properties.end(); ++fi) {
+    const size_t current_property = fi - properties.begin();
+    if (settings.resume_checkpoint.has_value() &&
+        current_property < settings.resume_checkpoint->property_index) {
+      continue;
+    }
+    std::cout << std::endl
+              << ((settings.pilot_path_count > 0) ? "Planning "
+                                                  : "Model checking ")
+              << *fi << " ..." << std::endl;
+    const CompiledProperty& property = compiled.properties()[current_property];
+    if (settings.pilot_path_count > 0) {
+      PrintSamplingPlans(
+          PlanVerification(property, compiled.model(), params, init_state,
+                           settings.pilot_path_count, workers->pool()),
+          settings.pilot_path_count, settings.thread_count);
+      continue;
+    }
+    size_t accepts = 0;
+    size_t first_trial = 0;
+    ModelCheckingStats stats(settings.report_statistics);
+    const VerifierState* resume_state = nullptr;
+    const std::string property_text =
+        checkpointer.has_value() ? StrCat(*fi) : "";
+    if (settings.resume_checkpoint.has_value() &&
+        current_property == settings.resume_checkpoint->property_index) {
+      const Checkpoint& checkpoint = settings.resume_checkpoint.value();
+      if (checkpoint.property != property_text) {
+        throw std::invalid_argument(
+            StrCat("checkpoint in ", settings.checkpoint_file,
+                   " is for a different property: ",
+                   checkpoint.property));
+      }
+      if (!checkpoint.stats.empty() &&
+          !LoadStats(checkpoint.stats, &stats)) {
+        throw std::invalid_argument(
+            StrCat("malformed statistics in ", settings.checkpoint_file));
+      }
+      accepts = checkpoint.accepts;
+      first_trial = checkpoint.trial;
+      resume_state = &checkpoint.verifier_state;
+    }
+    const int shared_index = shared_indices[current_property];
+    if (shared_index >= 0) {
+      for (const auto& results : shared_results) {
+        const SharedPathResult& result = results[shared_index];
+        std::cout << result.sample_size
+                  << " observations on shared paths." << std::endl;
+        if (compiled.is_estimation()[current_property]) {
+          std::cout << "Pr[" << result.path_property->string()
+                    << "] = " << result.mean << " ("
+                    << std::max(0.0, result.mean - params.delta) << ','
+                    << std::min(1.0, result.mean + params.delta) << ")"
+                    << std::endl;
+        }
+        if (compiled.is_estimation()[current_property]) {
+          shared_stats[shared_index].estimate.AddObservation(
+              result.mean);
+        }
+        if (result.accept) {
+          ++accepts;
+        }
+      }
+      stats = shared_stats[shared_index];
+    }
+    const bool first_passage =
+        !settings.time_bounds.empty() && SupportsFirstPassageTimes(property);
+    for (size_t i = 0; first_passage && i < settings.trials; ++i) {
+      std::cout << "Sampling first passage times...";
+      Timer<> property_timer;
+      const FirstPassageDistribution distribution =
+          EstimateFirstPassageTimes(property, compiled.model(), params,
+                                    init_state, workers->pool(), &stats);
+      stats.time.AddObservation(property_timer.GetElapsedSeconds());
+      stats.estimate.AddObservation(
+          distribution.Cdf(distribution.path_property->max_time()));
+      PrintFirstPassageDistribution(distribution, settings.time_bounds);
+    }
+    if (settings.concurrent_trials) {
+      VerifyTrials(property, compiled.model(), params, init_state,
+                   workers->pool(), settings.seed, settings.trials,
+                   settings.report_statistics,
+                   [&accepts, &stats](const TrialResult& result) {
+                     std::cout << result.output;
+                     if (result.accept) {
+                       ++accepts;
+                     }
+                     stats.MergeFrom(result.stats);
+                   });
+    }
+    for (size_t i = first_trial;
+         shared_index < 0 && !settings.concurrent_trials && !first_passage &&
+         i < settings.trials;
+         ++i) {
+      if (checkpointer.has_value()) {
+        checkpointer->SetProgress(current_property, property_text, i,
+                                  accepts, &stats);
+      }
+      if (progress.has_value()) {
+        progress->SetTrial(current_property, i);
+      }
+      Timer<> property_timer;
+      if (Verify(property, compiled.model(), nullptr, params, init_state,
+                 workers->pool(), &stats, resume_state,
+                 checkpointer.has_value() ? &checkpointer.value()
+                                          : nullptr,
+                 progress.has_value() ? &progress.value() : nullptr)) {
+        ++accepts;
+      }
+      resume_state = nullptr;
+      stats.time.AddObservation(property_timer.GetElapsedSeconds());
+      if (checkpointer.has_value()) {
+        if (i + 1 < settings.trials) {
+          checkpointer->SetProgress(current_property, property_text,
+                                    i + 1, accepts, &stats);
+        } else {
+          // Record the next property, so that a checkpoint taken
+          // between properties resumes with that property.
+          const std::string next_property_text =
+              (current_property + 1 < properties.size())
+                  ? StrCat(properties[current_property + 1])
+                  : "";
+          checkpointer->SetProgress(current_property + 1,
+                                    next_property_text, 0, 0, nullptr);
+        }
+        if (checkpointer->Due()) {
+          checkpointer->Save(VerifierState());
+        }
+      }
+    }
+    if (settings.report_statistics) {
+      PrintModelCheckingStats(stats);
+    } else {
+      std::cout << "Model checking completed in " << stats.time.mean()
+                << " seconds." << std::endl;
+    }
+    if (!compiled.is_estimation()[current_property]) {
+      if (settings.trials > 1) {
+        std::cout << accepts << " accepted, " << (settings.trials - accepts)
+                  << " rejected" << std::endl;
+      } else if (accepts > 0) {
+        std::cout << "Property is true in the initial state."
+                  << std::endl;
+      } else {
+        std::cout << "Property is false in the initial state."
+                  << std::endl;
+      }
+    }
+    if (sweep_row != nullptr) {
+      sweep_row->push_back(
+          SweepResult(compiled.is_estimation()[current_property], accepts,
+                      settings.trials, stats));
+    }
+  }
+  if (checkpointer.has_value()) {
+    // The run is complete, so there is nothing left to resume.
+    std::remove(settings.checkpoint_file.c_str());
+  }
+}
+
+// Verifies the given properties with the hybrid or sparse engine at a single
+// sweep point.  Adds the results to sweep_row if it is not nullptr.
+void VerifyWithDecisionDiagrams(
+    const ModelCheckingParams& params, const VerifySettings& settings,
+    const UniquePtrVector<const Expression>& properties,
+    SweepCompiler* compiled, std::vector<std::string>* sweep_row) {
+  if (params.engine == ModelCheckingEngine::HYBRID) {
+    std::cout << "Hybrid engine: epsilon=" << params.epsilon << std::endl;
+  } else {
+    std::cout << "Sparse engine: epsilon=" << params.epsilon
+              << ", memory=" << settings.sparse_memory << " MB" << std::endl;
+  }
+  Timer<> model_timer;
+  DecisionDiagramModel dd_model =
+      DecisionDiagramModel::Make(compiled->dd_manager(), compiled->model(),
+                                 settings.moments,
+                                 compiled->identifiers_by_name());
+  std::cout << "Model built in " << model_timer.GetElapsedSeconds()
+            << " seconds." << std::endl;
+  std::cout << "States:      "
+            << dd_model.reachable_states().MintermCount(
+                   compiled->dd_manager()->GetVariableCount() / 2)
+            << std::endl
+            << "Transitions: "
+            << dd_model.rate_matrix().MintermCount(
+                   compiled->dd_manager()->GetVariableCount())
+            << std::endl
+            << "Rate matrix: "
+            << dd_model.rate_matrix().ShortDebugString(
+                   compiled->dd_manager()->GetVariableCount())
+            << std::endl
+            << "ODD:         " << dd_model.odd().node_count() << " nodes"
+            << std::endl;
+  for (auto fi = properties.begin(); fi != properties.end(); ++fi) {
+    std::cout << std::endl << "Model checking " << *fi << " ..."
+              << std::endl;
+    const auto current_property = fi - properties.begin();
+    const CompiledProperty& property = compiled->properties()[current_property];
+    bool accepted = false;
+    double accept_count = 0;
+    ModelCheckingStats stats(settings.report_statistics);
+    for (size_t i = 0; i < settings.trials; ++i) {
+      Timer<> property_timer;
+      BDD ddf = Verify(
+          property, dd_model, true, params.epsilon, settings.thread_count,
+          (params.engine == ModelCheckingEngine::SPARSE)
+              ? settings.sparse_memory * (1 << 20)
+              : 0);
+      BDD sol = ddf && dd_model.initial_states();
+      stats.time.AddObservation(property_timer.GetElapsedSeconds());
+      accepted = !sol.is_same(compiled->dd_manager()->GetConstant(false));
+      accept_count =
+          sol.MintermCount(compiled->dd_manager()->GetVariableCount() / 2);
+    }
+    std::cout << "Model checking completed in " << stats.time.mean()
+              << " seconds." << std::endl;
+    if (!compiled->is_estimation()[current_property]) {
+      const auto init_count = dd_model.initial_states().MintermCount(
+          compiled->dd_manager()->GetVariableCount() / 2);
+      if (accepted) {
+        if (init_count == 1) {
+          std::cout << "Property is true in the initial state."
+                    << std::endl;
+        } else if (init_count == accept_count) {
+          std::cout << "Property is true in all initial states."
+                    << std::endl;
+        } else {
+          std::cout << "Property is true in " << accept_count << " of "
+                    << init_count << " initial states." << std::endl;
+        }
+      } else if (init_count == 1) {
+        std::cout << "Property is false in the initial state."
+                  << std::endl;
+      } else {
+        std::cout << "Property is false in all initial states."
+                  << std::endl;
+      }
+    }
+    if (sweep_row != nullptr) {
+      sweep_row->push_back(
+          SweepResult(compiled->is_estimation()[current_property],
+                      accepted ? settings.trials : 0, settings.trials, stats));
+    }
+  }
+}
+
+// Verifies the given properties with the mixed engine at a single sweep
+// point.  Adds the results to sweep_row if it is not nullptr.
+void VerifyWithMixedEngine(const ModelCheckingParams& params,
+                           const VerifySettings& settings,
+                           const UniquePtrVector<const Expression>& properties,
+                           SweepCompiler* compiled, SamplingWorkers* workers,
+                           std::vector<std::string>* sweep_row) {
+  std::cout << "Mixed engine: alpha=" << params.alpha
+            << ", beta=" << params.beta << ", delta=" << params.delta
+            << ", epsilon=" << params.epsilon << ", seed=" << settings.seed
+            << std::endl;
+  Timer<> model_timer;
+  DecisionDiagramModel dd_model =
+      DecisionDiagramModel::Make(compiled->dd_manager(), compiled->model(),
+                                 settings.moments,
+                                 compiled->identifiers_by_name());
+  workers->Reset(&compiled->model(), compiled->reg_counts(), settings.seed);
+  const State init_state(compiled->model());
+  std::cout << "Model built in " << model_timer.GetElapsedSeconds()
+            << " seconds." << std::endl;
+  std::cout << "Variables: " << init_state.values().size() << std::endl;
+  std::cout << "Events:    " << compiled->model().EventCount() << std::endl;
+  std::cout << "States:      "
+            << dd_model.reachable_states().MintermCount(
+                   compiled->dd_manager()->GetVariableCount() / 2)
+            << std::endl
+            << "Transitions: "
+            << dd_model.rate_matrix().MintermCount(
+                   compiled->dd_manager()->GetVariableCount())
+            << std::endl
+            << "Rate matrix: "
+            << dd_model.rate_matrix().ShortDebugString(
+                   compiled->dd_manager()->GetVariableCount())
+            << std::endl
+            << "ODD:         " << dd_model.odd().node_count() << " nodes"
+            << std::endl;
+  for (auto fi = properties.begin(); fi != properties.end(); ++fi) {
+    std::cout << std::endl << "Model checking " << *fi << " ..."
+              << std::endl;
+    const auto current_property = fi - properties.begin();
+    const CompiledProperty& property = compiled->properties()[current_property];
+    size_t accepts = 0;
+    ModelCheckingStats stats(settings.report_statistics);
+    for (size_t i = 0; i < settings.trials; ++i) {
+      Timer<> property_timer;
+      if (Verify(property, compiled->model(), &dd_model, params, init_state,
+                 workers->pool(), &stats, nullptr, nullptr, nullptr)) {
+        ++accepts;
+      }
+      stats.time.AddObservation(property_timer.GetElapsedSeconds());
+    }
+    if (settings.report_statistics) {
+      PrintModelCheckingStats(stats);
+    } else {
+      std::cout << "Model checking completed in " << stats.time.mean()
+                << " seconds." << std::endl;
+    }
+    if (!compiled->is_estimation()[current_property]) {
+      if (settings.trials > 1) {
+        std::cout << accepts << " accepted, " << (settings.trials - accepts)
+                  << " rejected" << std::endl;
+      } else if (accepts > 0) {
+        std::cout << "Property is true in the initial state."
+                  << std::endl;
+      } else {
+        std::cout << "Property is false in the initial state."
+                  << std::endl;
+      }
+    }
+    if (sweep_row != nullptr) {
+      sweep_row->push_back(
+          SweepResult(compiled->is_estimation()[current_property], accepts,
+                      settings.trials, stats));
+    }
+  }
 }
 
 }  // namespace
@@ -1156,7 +2598,13 @@ int main(int argc, char* argv[]) {
   params.fixed_sample_size = 0;
   params.max_path_length = std::numeric_limits<int>::max();
   params.nested_error = -1;
+  params.optimize_errors = false;
   params.memoization = false;
+  params.shared_paths = false;
+  params.nested_batch_size = 0;
+  params.group_size = 1;
+  params.prior_a = 1;
+  params.prior_b = 1;
   /* Number of moments to match. */
   size_t moments = 3;
   /* Set default seed. */
@@ -1165,8 +2613,27 @@ int main(int argc, char* argv[]) {
   size_t trials = 1;
   /* Constant overrides. */
   std::map<std::string, TypedValue> const_overrides;
+  /* Swept constant and its values. */
+  std::string sweep_name;
+  std::vector<TypedValue> sweep_values;
   int thread_count = 1;
+  /* Memory budget in MB for the matrix of the sparse engine. */
+  double sparse_memory = 1024;
   bool report_statistics = false;
+  /* File with precomputed single sampling plans. */
+  std::string ssp_cache;
+  /* Number of pilot paths per test for planning, or 0 to model check. */
+  int pilot_path_count = 0;
+  /* File for checkpoints, and the number of seconds between them. */
+  std::string checkpoint_file;
+  double checkpoint_interval = 600;
+  bool resume = false;
+  bool concurrent_trials = false;
+  /* Extra time bounds for first passage time estimation. */
+  std::vector<double> time_bounds;
+  /* File descriptor for progress, or -1, and the seconds between snapshots. */
+  int progress_fd = -1;
+  double progress_interval = 1;
 
   ModelAndProperties parse_result;
   std::vector<std::string> errors;
@@ -1202,11 +2669,22 @@ int main(int argc, char* argv[]) {
             throw std::invalid_argument("beta >= 0.5");
           }
           break;
+        case 'b':
+          params.nested_batch_size = atoi(optarg);
+          if (params.nested_batch_size < 0) {
+            throw std::invalid_argument("nested-batch-size < 0");
+          }
+          break;
         case 'c':
           if (!parse_const_overrides(optarg, &const_overrides)) {
             throw std::invalid_argument("bad --const specification");
           }
           break;
+        case 'd':
+          if (!parse_sweep(optarg, &sweep_name, &sweep_values)) {
+            throw std::invalid_argument("bad --sweep specification");
+          }
+          break;
         case 'C':
           thread_count = atoi(optarg);
           if (thread_count < 1) {
@@ -1234,6 +2712,8 @@ int main(int argc, char* argv[]) {
             params.engine = ModelCheckingEngine::SAMPLING;
           } else if (strcasecmp(optarg, "hybrid") == 0) {
             params.engine = ModelCheckingEngine::HYBRID;
+          } else if (strcasecmp(optarg, "sparse") == 0) {
+            params.engine = ModelCheckingEngine::SPARSE;
           } else if (strcasecmp(optarg, "mixed") == 0) {
             params.engine = ModelCheckingEngine::MIXED;
           } else {
@@ -1241,9 +2721,49 @@ int main(int argc, char* argv[]) {
                                         std::string(optarg) + "'");
           }
           break;
+        case 'F':
+          progress_fd = atoi(optarg);
+          if (progress_fd < 0 || fcntl(progress_fd, F_GETFD) == -1) {
+            throw std::invalid_argument(
+                StrCat("bad progress file descriptor ", optarg));
+          }
+          break;
+        case 'f':
+          progress_interval = atof(optarg);
+          if (progress_interval < 0) {
+            throw std::invalid_argument("negative progress interval");
+          }
+          break;
+        case 'g':
+          params.group_size = atoi(optarg);
+          if (params.group_size < 1) {
+            throw std::invalid_argument("group-size < 1");
+          }
+          break;
+        case 'i':
+          time_bounds = ParseTimeBounds(optarg);
+          break;
+        case 'J':
+          concurrent_trials = true;
+          break;
+        case 'K':
+          checkpoint_interval = atof(optarg);
+          if (checkpoint_interval < 0) {
+            throw std::invalid_argument("negative checkpoint interval");
+          }
+          break;
+        case 'k':
+          checkpoint_file = optarg;
+          break;
         case 'L':
           params.max_path_length = atoi(optarg);
           break;
+        case 'l':
+          pilot_path_count = atoi(optarg);
+          if (pilot_path_count < 1) {
+            throw std::invalid_argument("must use at least one pilot path");
+          }
+          break;
         case 'M':
           params.memoization = true;
           break;
@@ -1263,18 +2783,30 @@ int main(int argc, char* argv[]) {
         case 'n':
           params.nested_error = atof(optarg);
           break;
+        case 'O':
+          params.optimize_errors = true;
+          break;
         case 'p':
           params.termination_probability = atof(optarg);
           break;
+        case 'P':
+          params.shared_paths = true;
+          break;
         case 'q':
           params.estimation_algorithm = ParseEstimationAlgorithm(optarg);
           break;
+        case 'r':
+          ParsePrior(optarg, &params);
+          break;
         case 'R':
           report_statistics = true;
           break;
         case 'S':
           seed = atoi(optarg);
           break;
+        case 's':
+          ssp_cache = optarg;
+          break;
         case 'T':
           trials = atoi(optarg);
           report_statistics = true;
@@ -1282,9 +2814,18 @@ int main(int argc, char* argv[]) {
         case 't':
           params.threshold_algorithm = ParseThresholdAlgorithm(optarg);
           break;
+        case 'u':
+          resume = true;
+          break;
         case 'V':
           display_version();
           return 0;
+        case 'W':
+          sparse_memory = atof(optarg);
+          if (sparse_memory < 0) {
+            throw std::invalid_argument("negative sparse memory");
+          }
+          break;
         case 'h':
           display_help();
           return 0;
@@ -1298,6 +2839,68 @@ int main(int argc, char* argv[]) {
     if (params.nested_error > 0) {
       CHECK_LT(params.nested_error, MaxNestedError(params.delta));
     }
+    if (pilot_path_count > 0 &&
+        params.engine != ModelCheckingEngine::SAMPLING) {
+      throw std::invalid_argument("planning requires the sampling engine");
+    }
+    std::optional<Checkpoint> resume_checkpoint;
+    if (!checkpoint_file.empty()) {
+      if (params.engine != ModelCheckingEngine::SAMPLING ||
+          params.shared_paths || pilot_path_count > 0) {
+        throw std::invalid_argument(
+            "checkpoints require the sampling engine without shared paths "
+            "or planning");
+      }
+      if (resume) {
+        std::ifstream in(checkpoint_file);
+        if (!in.is_open()) {
+          throw std::invalid_argument(
+              StrCat("cannot open checkpoint ", checkpoint_file));
+        }
+        resume_checkpoint.emplace();
+        if (!ReadCheckpoint(&in, &resume_checkpoint.value())) {
+          throw std::invalid_argument(
+              StrCat("malformed checkpoint in ", checkpoint_file));
+        }
+      }
+    } else if (resume) {
+      throw std::invalid_argument("--resume requires --checkpoint");
+    }
+    if (progress_fd >= 0 && (params.engine != ModelCheckingEngine::SAMPLING ||
+                             params.shared_paths || pilot_path_count > 0)) {
+      throw std::invalid_argument(
+          "progress requires the sampling engine without shared paths or "
+          "planning");
+    }
+    if (concurrent_trials &&
+        (params.engine != ModelCheckingEngine::SAMPLING ||
+         params.shared_paths || pilot_path_count > 0 ||
+         !checkpoint_file.empty() || progress_fd >= 0)) {
+      throw std::invalid_argument(
+          "concurrent trials require the sampling engine without shared "
+          "paths, planning, checkpoints, or progress");
+    }
+    if (!sweep_values.empty() &&
+        (pilot_path_count > 0 || !checkpoint_file.empty() ||
+         progress_fd >= 0)) {
+      throw std::invalid_argument(
+          "sweeps cannot be combined with planning, checkpoints, or progress");
+    }
+    if (!time_bounds.empty() &&
+        (params.engine != ModelCheckingEngine::SAMPLING ||
+         params.shared_paths || pilot_path_count > 0 ||
+         !checkpoint_file.empty() || progress_fd >= 0 || concurrent_trials)) {
+      throw std::invalid_argument(
+          "time bounds require the sampling engine without shared paths, "
+          "planning, checkpoints, progress, or concurrent trials");
+    }
+    if (!ssp_cache.empty()) {
+      std::ifstream in(ssp_cache);
+      if (in.is_open() && !SingleSamplingPlan::LoadPlans(&in)) {
+        throw std::invalid_argument(
+            StrCat("malformed single sampling plans in ", ssp_cache));
+      }
+    }
 
     /*
      * Read files.
@@ -1328,270 +2931,70 @@ int main(int argc, char* argv[]) {
     }
     const Model& model = parse_result.model.value();
     VLOG(2) << model;
-    const std::map<std::string, const Expression*> formulas_by_name =
-        GetExpressionsByName(model.formulas());
-    const std::map<std::string, const Expression*> labels_by_name =
-        GetExpressionsByName(model.labels());
-    std::map<std::string, IdentifierInfo> identifiers_by_name =
-        GetConstantIdentifiersByName(model.constants(), formulas_by_name,
-                                     const_overrides, &errors);
-    if (!errors.empty()) {
-      for (const std::string& error : errors) {
-        std::cerr << PACKAGE << ":" << error << std::endl;
-      }
-      return 1;
-    }
-    auto compile_variables_result = CompileVariables(
-        model.variables(), formulas_by_name, &identifiers_by_name, &errors);
-    std::optional<DecisionDiagramManager> dd_manager;
-    if (params.engine == ModelCheckingEngine::HYBRID ||
+    VerifySettings settings;
+    settings.moments = moments;
+    settings.seed = seed;
+    settings.trials = trials;
+    settings.thread_count = thread_count;
+    settings.sparse_memory = sparse_memory;
+    settings.report_statistics = report_statistics;
+    settings.pilot_path_count = pilot_path_count;
+    settings.checkpoint_file = checkpoint_file;
+    settings.checkpoint_interval = checkpoint_interval;
+    settings.resume_checkpoint = resume_checkpoint;
+    settings.concurrent_trials = concurrent_trials;
+    settings.time_bounds = time_bounds;
+    settings.progress_fd = progress_fd;
+    settings.progress_interval = progress_interval;
+    SweepCompiler compiled(model, parse_result.properties, params);
+    std::optional<SamplingWorkers> workers;
+    if (params.engine == ModelCheckingEngine::SAMPLING ||
         params.engine == ModelCheckingEngine::MIXED) {
-      dd_manager =
-          DecisionDiagramManager(2 * compile_variables_result.total_bit_count);
+      workers.emplace(thread_count);
     }
-    std::optional<CompiledExpression> init_expr;
-    if (model.init() != nullptr) {
-      if (compile_variables_result.has_explicit_init) {
-        errors.push_back(
-            "global init not allowed in model with explicit variable inits");
+    // Results of each property at each sweep point.
+    std::vector<std::vector<std::string>> sweep_table;
+    const size_t point_count = std::max<size_t>(1, sweep_values.size());
+    for (size_t point = 0; point < point_count; ++point) {
+      std::map<std::string, TypedValue> point_overrides = const_overrides;
+      std::vector<std::string>* sweep_row = nullptr;
+      if (!sweep_values.empty()) {
+        point_overrides.erase(sweep_name);
+        point_overrides.emplace(sweep_name, sweep_values[point]);
+        std::cout << ((point > 0) ? "\n" : "") << "Sweep point " << sweep_name
+                  << "=" << sweep_values[point] << std::endl;
+        sweep_table.emplace_back();
+        sweep_row = &sweep_table.back();
       }
-      init_expr = CompileAndOptimizeExpression(
-          *model.init(), Type::BOOL, formulas_by_name, identifiers_by_name,
-          dd_manager, &errors);
-      if (params.engine != ModelCheckingEngine::HYBRID) {
-        // TODO(hyounes): Set value from init expr.  Report error if init expr
-        // does not identify a single state.
-      }
-    }
-    const CompiledModel compiled_model =
-        CompileModel(model, compile_variables_result.variables,
-                     compile_variables_result.init_values, init_expr,
-                     compile_variables_result.max_values, formulas_by_name,
-                     identifiers_by_name, dd_manager, &errors);
-    std::pair<int, int> reg_counts = compiled_model.GetRegisterCounts();
-    UniquePtrVector<const CompiledProperty> compiled_properties;
-    for (const Expression& property : parse_result.properties) {
-      compiled_properties.push_back(
-          CompileAndOptimizeProperty(property, formulas_by_name, labels_by_name,
-                                     identifiers_by_name, dd_manager, &errors));
-      auto property_reg_counts =
-          GetPropertyRegisterCounts(compiled_properties.back());
-      reg_counts.first = std::max(reg_counts.first, property_reg_counts.first);
-      reg_counts.second =
-          std::max(reg_counts.second, property_reg_counts.second);
-    }
-    const auto is_estimation = CheckUnsupported(params, compiled_model.type(),
-                                                compiled_properties, &errors);
-    if (!errors.empty()) {
-      for (const std::string& error : errors) {
-        std::cerr << PACKAGE << ":" << error << std::endl;
-      }
-      return 1;
-    }
-
-    std::cout.setf(std::ios::unitbuf);
-
-    if (params.engine == ModelCheckingEngine::SAMPLING) {
-      std::cout << "Sampling engine: alpha=" << params.alpha
-                << ", beta=" << params.beta << ", delta=" << params.delta
-                << ", p_term=" << params.termination_probability
-                << ", seed=" << seed << std::endl;
-      Timer<> model_timer;
-      std::vector<CompiledExpressionEvaluator> evaluators;
-      evaluators.reserve(thread_count);
-      std::seed_seq seed_generator{seed};
-      std::vector<std::uint32_t> seeds(thread_count);
-      seed_generator.generate(seeds.begin(), seeds.end());
-      std::vector<std::mt19937_64> engines;
-      engines.reserve(thread_count);
-      std::vector<CompiledDistributionSampler<std::mt19937_64>> samplers;
-      samplers.reserve(thread_count);
-      for (int i = 0; i < thread_count; ++i) {
-        evaluators.emplace_back(reg_counts.first, reg_counts.second);
-        engines.emplace_back();
-        engines.back().seed(seeds[i]);
-        samplers.emplace_back(&engines.back());
-      }
-      const State init_state(compiled_model);
-      std::cout << "Model built in " << model_timer.GetElapsedSeconds()
-                << " seconds." << std::endl;
-      std::cout << "Variables: " << init_state.values().size() << std::endl;
-      std::cout << "Events:    " << compiled_model.EventCount() << std::endl;
-      for (auto fi = parse_result.properties.begin();
-           fi != parse_result.properties.end(); ++fi) {
-        std::cout << std::endl << "Model checking " << *fi << " ..."
-                  << std::endl;
-        const auto current_property = fi - parse_result.properties.begin();
-        const CompiledProperty& property =
-            compiled_properties[current_property];
-        size_t accepts = 0;
-        ModelCheckingStats stats(report_statistics);
-        for (size_t i = 0; i < trials; ++i) {
-          Timer<> property_timer;
-          if (Verify(property, compiled_model, nullptr, params, init_state,
-                     &evaluators, &samplers, &stats)) {
-            ++accepts;
-          }
-          stats.time.AddObservation(property_timer.GetElapsedSeconds());
+      if (!compiled.Compile(point_overrides, &errors)) {
+        for (const std::string& error : errors) {
+          std::cerr << PACKAGE << ":" << error << std::endl;
         }
-        if (report_statistics) {
-          PrintModelCheckingStats(stats);
-        } else {
-          std::cout << "Model checking completed in " << stats.time.mean()
-                    << " seconds." << std::endl;
-        }
-        if (!is_estimation[current_property]) {
-          if (trials > 1) {
-            std::cout << accepts << " accepted, " << (trials - accepts)
-                      << " rejected" << std::endl;
-          } else if (accepts > 0) {
-            std::cout << "Property is true in the initial state." << std::endl;
-          } else {
-            std::cout << "Property is false in the initial state." << std::endl;
-          }
-        }
-      }
-    } else if (params.engine == ModelCheckingEngine::HYBRID) {
-      std::cout << "Hybrid engine: epsilon=" << params.epsilon << std::endl;
-      Timer<> model_timer;
-      DecisionDiagramModel dd_model = DecisionDiagramModel::Make(
-          &dd_manager.value(), compiled_model, moments, identifiers_by_name);
-      std::cout << "Model built in " << model_timer.GetElapsedSeconds()
-                << " seconds." << std::endl;
-      std::cout << "States:      "
-                << dd_model.reachable_states().MintermCount(
-                       dd_manager.value().GetVariableCount() / 2)
-                << std::endl
-                << "Transitions: "
-                << dd_model.rate_matrix().MintermCount(
-                       dd_manager.value().GetVariableCount())
-                << std::endl
-                << "Rate matrix: "
-                << dd_model.rate_matrix().ShortDebugString(
-                       dd_manager.value().GetVariableCount())
-                << std::endl
-                << "ODD:         " << dd_model.odd().node_count() << " nodes"
-                << std::endl;
-      for (auto fi = parse_result.properties.begin();
-           fi != parse_result.properties.end(); ++fi) {
-        std::cout << std::endl << "Model checking " << *fi << " ..."
-                  << std::endl;
-        const auto current_property = fi - parse_result.properties.begin();
-        const CompiledProperty& property =
-            compiled_properties[current_property];
-        bool accepted = false;
-        double accept_count = 0;
-        ModelCheckingStats stats(report_statistics);
-        for (size_t i = 0; i < trials; ++i) {
-          Timer<> property_timer;
-          BDD ddf = Verify(property, dd_model, true, params.epsilon);
-          BDD sol = ddf && dd_model.initial_states();
-          stats.time.AddObservation(property_timer.GetElapsedSeconds());
-          accepted = !sol.is_same(dd_manager.value().GetConstant(false));
-          accept_count =
-              sol.MintermCount(dd_manager.value().GetVariableCount() / 2);
-        }
-        std::cout << "Model checking completed in " << stats.time.mean()
-                  << " seconds." << std::endl;
-        if (!is_estimation[current_property]) {
-          const auto init_count = dd_model.initial_states().MintermCount(
-              dd_manager.value().GetVariableCount() / 2);
-          if (accepted) {
-            if (init_count == 1) {
-              std::cout << "Property is true in the initial state."
-                        << std::endl;
-            } else if (init_count == accept_count) {
-              std::cout << "Property is true in all initial states."
-                        << std::endl;
-            } else {
-              std::cout << "Property is true in " << accept_count << " of "
-                        << init_count << " initial states." << std::endl;
-            }
-          } else if (init_count == 1) {
-            std::cout << "Property is false in the initial state." << std::endl;
-          } else {
-            std::cout << "Property is false in all initial states."
-                      << std::endl;
-          }
-        }
-      }
-    } else if (params.engine == ModelCheckingEngine::MIXED) {
-      std::cout << "Mixed engine: alpha=" << params.alpha
-                << ", beta=" << params.beta << ", delta=" << params.delta
-                << ", epsilon=" << params.epsilon << ", seed=" << seed
-                << std::endl;
-      Timer<> model_timer;
-      DecisionDiagramModel dd_model = DecisionDiagramModel::Make(
-          &dd_manager.value(), compiled_model, moments, identifiers_by_name);
-      std::vector<CompiledExpressionEvaluator> evaluators;
-      evaluators.reserve(thread_count);
-      std::seed_seq seed_generator{seed};
-      std::vector<std::uint32_t> seeds(thread_count);
-      seed_generator.generate(seeds.begin(), seeds.end());
-      std::vector<std::mt19937_64> engines;
-      engines.reserve(thread_count);
-      std::vector<CompiledDistributionSampler<std::mt19937_64>> samplers;
-      samplers.reserve(thread_count);
-      for (int i = 0; i < thread_count; ++i) {
-        evaluators.emplace_back(reg_counts.first, reg_counts.second);
-        engines.emplace_back();
-        engines.back().seed(seeds[i]);
-        samplers.emplace_back(&engines.back());
+        return 1;
       }
-      const State init_state(compiled_model);
-      std::cout << "Model built in " << model_timer.GetElapsedSeconds()
-                << " seconds." << std::endl;
-      std::cout << "Variables: " << init_state.values().size() << std::endl;
-      std::cout << "Events:    " << compiled_model.EventCount() << std::endl;
-      std::cout << "States:      "
-                << dd_model.reachable_states().MintermCount(
-                       dd_manager.value().GetVariableCount() / 2)
-                << std::endl
-                << "Transitions: "
-                << dd_model.rate_matrix().MintermCount(
-                       dd_manager.value().GetVariableCount())
-                << std::endl
-                << "Rate matrix: "
-                << dd_model.rate_matrix().ShortDebugString(
-                       dd_manager.value().GetVariableCount())
-                << std::endl
-                << "ODD:         " << dd_model.odd().node_count() << " nodes"
-                << std::endl;
-      for (auto fi = parse_result.properties.begin();
-           fi != parse_result.properties.end(); ++fi) {
-        std::cout << std::endl << "Model checking " << *fi << " ..."
-                  << std::endl;
-        const auto current_property = fi - parse_result.properties.begin();
-        const CompiledProperty& property =
-            compiled_properties[current_property];
-        size_t accepts = 0;
-        ModelCheckingStats stats(report_statistics);
-        for (size_t i = 0; i < trials; ++i) {
-          Timer<> property_timer;
-          if (Verify(property, compiled_model, &dd_model, params, init_state,
-                     &evaluators, &samplers, &stats)) {
-            ++accepts;
-          }
-          stats.time.AddObservation(property_timer.GetElapsedSeconds());
-        }
-        if (report_statistics) {
-          PrintModelCheckingStats(stats);
-        } else {
-          std::cout << "Model checking completed in " << stats.time.mean()
-                    << " seconds." << std::endl;
-        }
-        if (!is_estimation[current_property]) {
-          if (trials > 1) {
-            std::cout << accepts << " accepted, " << (trials - accepts)
-                      << " rejected" << std::endl;
-          } else if (accepts > 0) {
-            std::cout << "Property is true in the initial state." << std::endl;
-          } else {
-            std::cout << "Property is false in the initial state." << std::endl;
-          }
-        }
+
+      std::cout.setf(std::ios::unitbuf);
+
+      if (params.engine == ModelCheckingEngine::SAMPLING) {
+        VerifyWithSampling(params, settings, parse_result.properties, compiled,
+                           &workers.value(), sweep_row);
+      } else if (params.engine == ModelCheckingEngine::HYBRID ||
+                 params.engine == ModelCheckingEngine::SPARSE) {
+        VerifyWithDecisionDiagrams(params, settings, parse_result.properties,
+                                   &compiled, sweep_row);
+      } else if (params.engine == ModelCheckingEngine::MIXED) {
+        VerifyWithMixedEngine(params, settings, parse_result.properties,
+                              &compiled, &workers.value(), sweep_row);
       }
     }
+    if (!sweep_values.empty()) {
+      PrintSweepTable(sweep_name, sweep_values, parse_result.properties,
+                      sweep_table);
+    }
+    if (!ssp_cache.empty()) {
+      std::ofstream out(ssp_cache);
+      SingleSamplingPlan::SavePlans(&out);
+    }
   } catch (const std::exception& e) {
     std::cerr << std::endl << PACKAGE ":" << e.what() << std::endl;
     return 1;